@@ -0,0 +1,135 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "harness.hpp"
+
+#include "bytecode.hpp"
+#include "jit.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using std::cerr;
+using std::endl;
+using std::string;
+
+// A ring of eight objects walked by one loop, so the same attribute sites
+// see every class in the ring: one class keeps the caches monomorphic, two
+// and four fill them, and eight spill past CACHE_ENTRIES into lookups
+struct Variant {
+    const char *name;
+    int classes;
+};
+
+static const Variant VARIANTS[] = {
+    {"mono", 1},
+    {"poly2", 2},
+    {"poly4", 4},
+    {"mega", 8},
+};
+
+static const int RING = 8;
+static const int ACCESSES = 3; // per trip round the loop
+static const long SIZE = 2000000;
+
+string source(const Variant &variant, long size);
+
+int main(int argc, char **argv) {
+    HarnessFlags flags = getFlags(argc, argv);
+    if (flags.error) {
+        cerr << flags.errorMsg << endl;
+        return EXIT_FAILURE;
+    }
+    if (!Jit::supported()) {
+        cerr << "No JIT on this machine, the jit columns are the interpreter"
+             << endl;
+    }
+    long size = long(SIZE * flags.scale);
+    if (size < 1) {
+        size = 1;
+    }
+    bool failed = false;
+    printf("%-8s %8s %12s %12s %12s %12s\n", "program", "classes",
+           "vm ms", "vm ns/get", "jit ms", "jit ns/get");
+    for (const Variant &variant: VARIANTS) {
+        Program program;
+        if (!compile(variant.name, source(variant, size),
+                     OPT_LEVELS::O2_LEVEL, program)) {
+            return EXIT_FAILURE;
+        }
+        RunOptions options;
+        string interpreted;
+        string jitted;
+        double a = run(program, options, flags.repeat, interpreted);
+        options.jit = JIT_MODES::ON_JIT;
+        double b = run(program, options, flags.repeat, jitted);
+        double accesses = double(size) * ACCESSES;
+        printf("%-8s %8d %12.2f %12.2f %12.2f %12.2f\n", variant.name,
+               variant.classes, a * 1e3, a * 1e9 / accesses, b * 1e3,
+               b * 1e9 / accesses);
+        if (!agree(variant.name, "the JIT", jitted, interpreted)) {
+            failed = true;
+        }
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// Structs S0..S{classes - 1} with the same fields, RING objects linked
+// through next and a loop that reads and writes x on each in turn
+string source(const Variant &variant, long size) {
+    std::ostringstream out;
+    for (int c = 0; c < variant.classes; c++) {
+        out << "struct S" << c << " {\n    x = 0\n    next\n}\n";
+    }
+    out << "fun ring() {\n";
+    for (int i = 0; i < RING; i++) {
+        out << "    o" << i << " = S" << i % variant.classes << "(" << i
+            << ")\n";
+    }
+    for (int i = 0; i < RING; i++) {
+        out << "    o" << i << ".next = o" << (i + 1) % RING << "\n";
+    }
+    out << "    return o0\n"
+           "}\n"
+           "fun walk(o, n) {\n"
+           "    s = 0\n"
+           "    i = 0\n"
+           "    while i < n {\n"
+           "        s += o.x\n"
+           "        o.x = s % 1000\n"
+           "        o = o.next\n"
+           "        i += 1\n"
+           "    }\n"
+           "    return s\n"
+           "}\n"
+           "print(walk(ring(), "
+        << size << "))\n";
+    return out.str();
+}
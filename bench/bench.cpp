@@ -0,0 +1,572 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "corpus.hpp"
+#include "incremental.hpp"
+#include "lexer.hpp"
+#include "output.hpp"
+#include "sources.hpp"
+#include "stats.hpp"
+#include "tokenbuffer.hpp"
+#include "tokenfile.hpp"
+#include "tokens.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+using std::chrono::duration;
+using std::chrono::steady_clock;
+
+static volatile size_t checksum; // keeps reads from being optimised out
+
+struct BenchFlags {
+    size_t size = 4 << 20;
+    int repeat = 5;
+    BACKENDS backend = BACKENDS::DFA;
+    double minMBps = 0;
+    string baseline; // MB/s per workload, recorded by the first run
+    double maxSlowdown = 0.5;
+    double maxAllocsPerToken = -1;
+    int edits = 1000;
+    string sample = TOOTY_SAMPLE;
+    bool error = false;
+    string errorMsg = "";
+};
+
+struct Result {
+    size_t tokens = 0;
+    size_t allocations = 0;
+    double seconds = 0;
+};
+
+BenchFlags getFlags(int argc, char **argv);
+bool readBaseline(const string &path, std::map<string, double> &mbps);
+bool writeBaseline(const string &path, const std::map<string, double> &mbps);
+Result run(const Workload &workload, const BenchFlags &flags);
+Result runEdits(const Workload &workload, const BenchFlags &flags,
+                bool &matches);
+Result runTokenFile(const Workload &workload, const BenchFlags &flags,
+                    double &writeSeconds, size_t &bytes, bool &matches);
+void runScan(const Workload &workload, const BenchFlags &flags,
+             double &arraySeconds, double &columnSeconds, size_t &tokens,
+             bool &matches);
+void runOutput(const Workload &workload, const BenchFlags &flags,
+               double &streamSeconds, double &batchedSeconds, size_t &bytes,
+               bool &matches);
+
+int main(int argc, char **argv) {
+    BenchFlags flags = getFlags(argc, argv);
+    if (flags.error) {
+        cerr << flags.errorMsg << endl;
+        return EXIT_FAILURE;
+    }
+    STATS.enable(false); // for the allocation counts
+    string sample;
+    if (!flags.sample.empty()) {
+        SourceBuffer buffer{flags.sample};
+        if (!buffer.isOpen()) {
+            cerr << "Could not open the file - '" << flags.sample << "'"
+                 << endl;
+            return EXIT_FAILURE;
+        }
+        sample = string{buffer.view()};
+    }
+    bool failed = false;
+    std::map<string, double> baseline;
+    std::map<string, double> measured;
+    bool recording =
+        !flags.baseline.empty() && !readBaseline(flags.baseline, baseline);
+    printf("%-12s %10s %10s %10s %12s %12s\n", "workload", "bytes", "tokens",
+           "MB/s", "Mtokens/s", "allocs/token");
+    vector<Workload> workloads = corpus(flags.size, sample);
+    for (const Workload &workload: workloads) {
+        Result result = run(workload, flags);
+        double mbps = workload.source.size() / result.seconds / 1e6;
+        measured[workload.name] = mbps;
+        double tokensPerSecond = result.tokens / result.seconds / 1e6;
+        double allocsPerToken =
+            double(result.allocations) / (result.tokens ? result.tokens : 1);
+        printf("%-12s %10zu %10zu %10.2f %12.2f %12.4f\n",
+               workload.name.c_str(), workload.source.size(), result.tokens,
+               mbps, tokensPerSecond, allocsPerToken);
+        if (mbps < flags.minMBps) {
+            cerr << workload.name << ": " << mbps << " MB/s is below the "
+                 << flags.minMBps << " MB/s threshold" << endl;
+            failed = true;
+        }
+        auto recorded = baseline.find(workload.name);
+        if (recorded != baseline.end()
+            && mbps < recorded->second * (1 - flags.maxSlowdown)) {
+            cerr << workload.name << ": " << mbps << " MB/s is more than "
+                 << flags.maxSlowdown * 100 << "% below the "
+                 << recorded->second << " MB/s recorded in "
+                 << flags.baseline << endl;
+            failed = true;
+        }
+        if (flags.maxAllocsPerToken >= 0
+            && allocsPerToken > flags.maxAllocsPerToken) {
+            cerr << workload.name << ": " << allocsPerToken
+                 << " allocations per token is above the "
+                 << flags.maxAllocsPerToken << " threshold" << endl;
+            failed = true;
+        }
+    }
+    if (recording) {
+        if (!writeBaseline(flags.baseline, measured)) {
+            cerr << "Could not write the baseline - '" << flags.baseline
+                 << "'" << endl;
+            failed = true;
+        }
+        else {
+            printf("recorded the baseline in %s\n", flags.baseline.c_str());
+        }
+    }
+    if (flags.edits > 0) {
+        printf("\n%-12s %10s %10s %12s\n", "workload", "edits", "us/edit",
+               "tokens/edit");
+    }
+    for (const Workload &workload: workloads) {
+        if (flags.edits <= 0) {
+            break;
+        }
+        bool matches = true;
+        Result result = runEdits(workload, flags, matches);
+        printf("%-12s %10d %10.2f %12.1f\n", workload.name.c_str(),
+               flags.edits, result.seconds / flags.edits * 1e6,
+               double(result.tokens) / flags.edits);
+        if (!matches) {
+            cerr << workload.name << ": edited tokens differ from a full lex"
+                 << endl;
+            failed = true;
+        }
+    }
+    printf("\n%-12s %10s %10s %10s %12s\n", "workload", "text bytes",
+           "bin bytes", "write ms", "Mtokens/s");
+    for (const Workload &workload: workloads) {
+        double writeSeconds = 0;
+        size_t bytes = 0;
+        bool matches = true;
+        Result result =
+            runTokenFile(workload, flags, writeSeconds, bytes, matches);
+        printf("%-12s %10zu %10zu %10.2f %12.2f\n", workload.name.c_str(),
+               result.allocations, bytes, writeSeconds * 1e3,
+               result.tokens / result.seconds / 1e6);
+        if (!matches) {
+            cerr << workload.name << ": tokens read back from "
+                 << "--emit-tokens=bin differ from the lexed ones" << endl;
+            failed = true;
+        }
+    }
+    printf("\n%-12s %12s %12s %12s %12s\n", "workload", "Token ns",
+           "columns ns", "Token B", "columns B");
+    for (const Workload &workload: workloads) {
+        double arraySeconds = 0;
+        double columnSeconds = 0;
+        size_t tokens = 0;
+        bool matches = true;
+        runScan(workload, flags, arraySeconds, columnSeconds, tokens,
+                matches);
+        size_t count = tokens ? tokens : 1;
+        printf("%-12s %12.3f %12.3f %12zu %12zu\n", workload.name.c_str(),
+               arraySeconds / count * 1e9, columnSeconds / count * 1e9,
+               sizeof(Token), sizeof(TOKENS) + 2 * sizeof(uint32_t));
+        if (!matches) {
+            cerr << workload.name << ": scanning a TokenBuffer gives "
+                 << "another result than scanning the Tokens" << endl;
+            failed = true;
+        }
+    }
+    printf("\n%-12s %12s %12s %12s %10s\n", "workload", "dump bytes",
+           "iostream ms", "batched ms", "speedup");
+    for (const Workload &workload: workloads) {
+        double streamSeconds = 0;
+        double batchedSeconds = 0;
+        size_t bytes = 0;
+        bool matches = true;
+        runOutput(workload, flags, streamSeconds, batchedSeconds, bytes,
+                  matches);
+        printf("%-12s %12zu %12.2f %12.2f %9.2fx\n", workload.name.c_str(),
+               bytes, streamSeconds * 1e3, batchedSeconds * 1e3,
+               streamSeconds / batchedSeconds);
+        if (!matches) {
+            cerr << workload.name << ": the batched dump differs from the "
+                 << "iostream one" << endl;
+            failed = true;
+        }
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// Types and deletes single characters at random places, like an editor
+// would, then checks the tokens kept up to date against a full lex
+Result runEdits(const Workload &workload, const BenchFlags &flags,
+                bool &matches) {
+    static const char TYPED[] = "x1 \n";
+    std::mt19937 random{20211};
+    IncrementalLexer lexer{workload.name, workload.source, flags.backend};
+    // index the newlines now, so the edits have an index to patch
+    vector<Token> before = lexer.tokens();
+    if (!before.empty()) {
+        before.back().line();
+    }
+    Result result;
+    for (int i = 0; i < flags.edits; i++) {
+        size_t size = lexer.text().size();
+        size_t offset = size ? random() % size : 0;
+        Edit edit{offset, 0, std::string_view{}};
+        if (i % 2 && size) {
+            edit.removed = 1;
+        }
+        else {
+            edit.inserted = std::string_view{TYPED + random() % 4, 1};
+        }
+        auto start = steady_clock::now();
+        lexer.apply(edit);
+        result.seconds += duration<double>(steady_clock::now() - start).count();
+        result.tokens += lexer.relexed();
+    }
+    string text = lexer.text();
+    Lexer full{workload.name + " (full)", text, flags.backend};
+    vector<Token> expected = full.tokenize();
+    vector<Token> tokens = lexer.tokens();
+    matches = expected.size() == tokens.size();
+    for (size_t i = 0; matches && i < tokens.size(); i++) {
+        matches = expected[i].pos == tokens[i].pos
+                  && expected[i].type == tokens[i].type
+                  && expected[i].length == tokens[i].length
+                  && expected[i].line() == tokens[i].line()
+                  && expected[i].lpos() == tokens[i].lpos();
+    }
+    return result;
+}
+
+// Dumps the tokens to a file the way tooty does, once through an ofstream
+// and toString() and once through an OutputBuffer, best of repeat runs each
+void runOutput(const Workload &workload, const BenchFlags &flags,
+               double &streamSeconds, double &batchedSeconds, size_t &bytes,
+               bool &matches) {
+    Lexer lexer{workload.name, workload.source, flags.backend};
+    vector<Token> tokens = lexer.tokenize();
+    std::filesystem::path path = std::filesystem::temp_directory_path();
+    path /= "tooty_bench_" + std::to_string(getpid());
+    string streamed = path.string() + ".iostream";
+    string batched = path.string() + ".batched";
+    for (int i = 0; i < flags.repeat; i++) {
+        auto start = steady_clock::now();
+        {
+            std::ofstream out{streamed, std::ios::trunc};
+            out << tokens.size() << "\n";
+            for (size_t j = 0; j < tokens.size(); j++) {
+                out << j << ": " << tokens[j].toString() << "\n";
+            }
+        }
+        double seconds = duration<double>(steady_clock::now() - start).count();
+        streamSeconds = i == 0 ? seconds : std::min(streamSeconds, seconds);
+        start = steady_clock::now();
+        int fd = open(batched.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        {
+            OutputBuffer buffer{fd};
+            std::ostream out{&buffer};
+            out << tokens.size() << "\n";
+            for (size_t j = 0; j < tokens.size(); j++) {
+                buffer.token(j, tokens[j]);
+            }
+            matches = fd >= 0 && out.flush() && !buffer.failed();
+        }
+        close(fd);
+        seconds = duration<double>(steady_clock::now() - start).count();
+        batchedSeconds = i == 0 ? seconds : std::min(batchedSeconds, seconds);
+    }
+    SourceBuffer expected{streamed};
+    SourceBuffer got{batched};
+    bytes = expected.size();
+    matches = matches && expected.view() == got.view();
+    std::filesystem::remove(streamed);
+    std::filesystem::remove(batched);
+}
+
+// What a parser-like pass finds: how deep brackets nest, how many names
+// are called and how many bytes of numbers there are
+struct Scan {
+    size_t depth = 0;
+    size_t deepest = 0;
+    size_t calls = 0;
+    size_t numbers = 0;
+    bool operator==(const Scan &other) const {
+        return this->deepest == other.deepest && this->calls == other.calls
+               && this->numbers == other.numbers;
+    }
+    void bracket(TOKENS kind) {
+        switch (kind) {
+            case TOKENS::LPAR:
+            case TOKENS::LSQB:
+            case TOKENS::LBRACE:
+                this->deepest = std::max(this->deepest, ++this->depth);
+                break;
+            case TOKENS::RPAR:
+            case TOKENS::RSQB:
+            case TOKENS::RBRACE:
+                this->depth -= this->depth > 0;
+                break;
+            default:
+                break;
+        }
+    }
+};
+
+Scan scanTokens(const vector<Token> &tokens) {
+    Scan scan;
+    for (size_t i = 0; i < tokens.size(); i++) {
+        TOKENS kind = tokens[i].type;
+        scan.bracket(kind);
+        if (kind == TOKENS::IDENT && i + 1 < tokens.size()
+            && tokens[i + 1].type == TOKENS::LPAR) {
+            scan.calls++;
+        }
+        else if (kind == TOKENS::NUMBER) {
+            scan.numbers += tokens[i].length;
+        }
+    }
+    return scan;
+}
+
+Scan scanColumns(const TokenBuffer &tokens) {
+    Scan scan;
+    for (TokenView view{tokens}; !view.done(); view.advance()) {
+        TOKENS kind = view.peek();
+        scan.bracket(kind);
+        if (kind == TOKENS::IDENT && view.peek(1) == TOKENS::LPAR) {
+            scan.calls++;
+        }
+        else if (kind == TOKENS::NUMBER) {
+            scan.numbers += tokens.length(view.index());
+        }
+    }
+    return scan;
+}
+
+// Times the same pass over a vector<Token> and over a TokenBuffer holding
+// the same tokens, best of repeat runs each
+void runScan(const Workload &workload, const BenchFlags &flags,
+             double &arraySeconds, double &columnSeconds, size_t &tokens,
+             bool &matches) {
+    vector<Token> array;
+    TokenBuffer columns{workload.source};
+    {
+        Lexer lexer{workload.name, workload.source, flags.backend};
+        array = lexer.tokenize();
+    }
+    {
+        Lexer lexer{workload.name, workload.source, flags.backend};
+        lexer.tokenize(columns);
+    }
+    tokens = array.size();
+    matches = columns.size() == array.size();
+    for (int i = 0; i < flags.repeat; i++) {
+        auto start = steady_clock::now();
+        Scan fromArray = scanTokens(array);
+        double seconds = duration<double>(steady_clock::now() - start).count();
+        arraySeconds = i == 0 ? seconds : std::min(arraySeconds, seconds);
+        start = steady_clock::now();
+        Scan fromColumns = scanColumns(columns);
+        seconds = duration<double>(steady_clock::now() - start).count();
+        columnSeconds = i == 0 ? seconds : std::min(columnSeconds, seconds);
+        matches = matches && fromArray == fromColumns;
+    }
+    for (size_t i = 0; matches && i < array.size(); i++) {
+        matches = columns.start(i) == array[i].pos - 1
+                  && columns.text(i) == array[i].value()
+                  && columns.line(i) == array[i].line()
+                  && columns.column(i) == array[i].lpos();
+    }
+}
+
+// Writes the tokens in the binary format and times a reader going over
+// every column of the mapped file. allocations holds the size of the text
+// dump for comparison.
+Result runTokenFile(const Workload &workload, const BenchFlags &flags,
+                    double &writeSeconds, size_t &bytes, bool &matches) {
+    Lexer lexer{workload.name, workload.source, flags.backend};
+    vector<Token> tokens = lexer.tokenize();
+    Result best;
+    for (const Token &token: tokens) {
+        best.allocations += token.toString().size() + 1;
+    }
+    std::filesystem::path path = std::filesystem::temp_directory_path();
+    path /= "tooty_bench_" + std::to_string(getpid()) + ".ttk";
+    auto start = steady_clock::now();
+    {
+        std::ofstream out{path, std::ios::binary | std::ios::trunc};
+        matches = writeTokens(out, workload.name, workload.source, tokens);
+    }
+    writeSeconds = duration<double>(steady_clock::now() - start).count();
+    for (int i = 0; matches && i < flags.repeat; i++) {
+        start = steady_clock::now();
+        TokenFile file{path.string()};
+        size_t sum = 0;
+        size_t count = 0;
+        for (const TokenColumns &columns: file.segments()) {
+            for (uint32_t j = 0; j < columns.size; j++) {
+                sum += columns.kind(j) + columns.lines[j] + columns.lposes[j]
+                       + columns.value(j).size();
+            }
+            count += columns.size;
+        }
+        double seconds = duration<double>(steady_clock::now() - start).count();
+        if (i == 0 || seconds < best.seconds) {
+            best.seconds = seconds;
+            best.tokens = count;
+        }
+        checksum = sum;
+        matches = file.segments().size() == 1 && count == tokens.size();
+        for (size_t j = 0; matches && j < tokens.size(); j++) {
+            const TokenColumns &columns = file.segments().front();
+            matches = columns.kind(j) == tokens[j].type
+                      && columns.offsets[j] == tokens[j].pos - 1
+                      && columns.lines[j] == tokens[j].line()
+                      && columns.lposes[j] == tokens[j].lpos()
+                      && columns.value(j) == tokens[j].value();
+        }
+    }
+    bytes = std::filesystem::file_size(path);
+    std::filesystem::remove(path);
+    return best;
+}
+
+Result run(const Workload &workload, const BenchFlags &flags) {
+    Result best;
+    for (int i = 0; i < flags.repeat; i++) {
+        Lexer lexer{workload.name, workload.source, flags.backend};
+        size_t before = STATS.allocationCount();
+        auto start = steady_clock::now();
+        vector<Token> tokens = lexer.tokenize();
+        double seconds = duration<double>(steady_clock::now() - start).count();
+        size_t allocated = STATS.allocationCount() - before;
+        if (!lexer.diagnostics.empty()) {
+            cerr << workload.name << ": "
+                 << lexer.diagnostics.all().front().toString() << endl;
+        }
+        if (i == 0 || seconds < best.seconds) {
+            best.seconds = seconds;
+            best.tokens = tokens.size();
+            best.allocations = allocated;
+        }
+    }
+    return best;
+}
+
+BenchFlags getFlags(int argc, char **argv) {
+    BenchFlags flags;
+    for (int i = 1; i < argc; i++) {
+        string arg{argv[i]};
+        size_t eq = arg.find('=');
+        string name = arg.substr(0, eq);
+        string value = eq == string::npos ? "" : arg.substr(eq + 1);
+        try {
+            if (name == "--size") {
+                flags.size = std::stoul(value);
+            }
+            else if (name == "--repeat") {
+                flags.repeat = std::stoi(value);
+            }
+            else if (name == "--min-mbps") {
+                flags.minMBps = std::stod(value);
+            }
+            else if (name == "--baseline") {
+                flags.baseline = value;
+            }
+            else if (name == "--max-slowdown") {
+                flags.maxSlowdown = std::stod(value);
+            }
+            else if (name == "--max-allocs-per-token") {
+                flags.maxAllocsPerToken = std::stod(value);
+            }
+            else if (name == "--edits") {
+                flags.edits = std::stoi(value);
+            }
+            else if (name == "--sample") {
+                flags.sample = value;
+            }
+            else if (arg == "--lexer=regex") {
+                flags.backend = BACKENDS::REGEX;
+            }
+            else if (arg == "--lexer=dfa") {
+                flags.backend = BACKENDS::DFA;
+            }
+            else {
+                flags.error = true;
+                flags.errorMsg = "Unknown flag: " + arg;
+            }
+        }
+        catch (const std::exception &) {
+            flags.error = true;
+            flags.errorMsg = "Invalid value: " + arg;
+        }
+    }
+    if (flags.repeat < 1) {
+        flags.repeat = 1;
+    }
+    return flags;
+}
+
+// Lines of a workload name and its MB/s, false if there is no such file
+bool readBaseline(const string &path, std::map<string, double> &mbps) {
+    std::ifstream in{path};
+    if (!in) {
+        return false;
+    }
+    string name;
+    double value;
+    while (in >> name >> value) {
+        mbps[name] = value;
+    }
+    return true;
+}
+
+bool writeBaseline(const string &path, const std::map<string, double> &mbps) {
+    std::ofstream out{path};
+    for (const auto &entry: mbps) {
+        out << entry.first << " " << entry.second << "\n";
+    }
+    return bool(out);
+}
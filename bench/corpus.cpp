@@ -0,0 +1,169 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "corpus.hpp"
+
+#include "lexer.hpp"
+#include "tokens.hpp"
+
+#include <cstddef>
+#include <random>
+#include <string>
+#include <vector>
+
+using std::mt19937;
+using std::string;
+using std::uniform_int_distribution;
+using std::vector;
+
+static const unsigned SEED = 20211;
+
+static string identifier(mt19937 &random) {
+    static const string first =
+        "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_";
+    static const string rest = first + "0123456789";
+    uniform_int_distribution<size_t> length{1, 16};
+    uniform_int_distribution<size_t> pickFirst{0, first.size() - 1};
+    uniform_int_distribution<size_t> pickRest{0, rest.size() - 1};
+    string ident{first[pickFirst(random)]};
+    for (size_t n = length(random); n > 1; n--) {
+        ident += rest[pickRest(random)];
+    }
+    return ident;
+}
+
+string identifierHeavy(size_t size) {
+    mt19937 random{SEED};
+    uniform_int_distribution<int> separator{0, 9};
+    string source;
+    while (source.size() < size) {
+        source += identifier(random);
+        source += separator(random) ? ' ' : '\n';
+    }
+    return source;
+}
+
+string operatorHeavy(size_t size) {
+    mt19937 random{SEED};
+    vector<std::string_view> operators;
+    for (const Symbol &symbol: SYMBOLS) {
+        if (symbol.text.find_first_of("()[]{}") == std::string_view::npos) {
+            operators.push_back(symbol.text);
+        }
+    }
+    uniform_int_distribution<size_t> pick{0, operators.size() - 1};
+    uniform_int_distribution<int> separator{0, 15};
+    string source;
+    while (source.size() < size) {
+        source += operators[pick(random)];
+        source += separator(random) ? ' ' : '\n';
+    }
+    return source;
+}
+
+string commentHeavy(size_t size) {
+    mt19937 random{SEED};
+    uniform_int_distribution<int> kind{0, 2};
+    uniform_int_distribution<size_t> words{1, 40};
+    string source;
+    while (source.size() < size) {
+        string text;
+        for (size_t n = words(random); n > 0; n--) {
+            text += identifier(random) + ' ';
+        }
+        switch (kind(random)) {
+            case 0:
+                source += "# " + text + "\n";
+                break;
+            case 1:
+                source += "/* " + text + "\n   " + text + "*/\n";
+                break;
+            default:
+                source += identifier(random) + " = 1 # " + text + "\n";
+                break;
+        }
+    }
+    return source;
+}
+
+string deeplyBracketed(size_t size) {
+    mt19937 random{SEED};
+    uniform_int_distribution<int> depth{1, MAXLEVEL};
+    static const string opening = "([{";
+    static const string closing = ")]}";
+    string source;
+    while (source.size() < size) {
+        string stack;
+        for (int n = depth(random); n > 0; n--) {
+            size_t kind = random() % 3;
+            source += opening[kind];
+            stack += closing[kind];
+        }
+        source += identifier(random);
+        source.append(stack.rbegin(), stack.rend());
+        source += '\n';
+    }
+    return source;
+}
+
+string longStrings(size_t size) {
+    mt19937 random{SEED};
+    uniform_int_distribution<size_t> length{64, 4096};
+    uniform_int_distribution<int> byte{' ', '~'};
+    string source;
+    while (source.size() < size) {
+        source += identifier(random) + " = \"";
+        for (size_t n = length(random); n > 0; n--) {
+            char c = byte(random);
+            source += c == '"' ? '\'' : c;
+        }
+        source += "\"\n";
+    }
+    return source;
+}
+
+string repeated(const string &sample, size_t size) {
+    string source;
+    while (source.size() < size) {
+        source += sample;
+        source += '\n';
+    }
+    return source;
+}
+
+vector<Workload> corpus(size_t size, const string &sample) {
+    vector<Workload> workloads;
+    workloads.push_back(Workload{"identifiers", identifierHeavy(size)});
+    workloads.push_back(Workload{"operators", operatorHeavy(size)});
+    workloads.push_back(Workload{"comments", commentHeavy(size)});
+    workloads.push_back(Workload{"brackets", deeplyBracketed(size)});
+    workloads.push_back(Workload{"strings", longStrings(size)});
+    if (!sample.empty()) {
+        workloads.push_back(Workload{"sample", repeated(sample, size)});
+    }
+    return workloads;
+}
@@ -0,0 +1,50 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+struct Workload {
+    std::string name;
+    std::string source;
+};
+
+// Synthetic .tooty sources of roughly the given size in bytes, each one
+// stressing a different part of the lexer. The same seed always gives the
+// same corpus.
+std::string identifierHeavy(size_t);
+std::string operatorHeavy(size_t);
+std::string commentHeavy(size_t);
+std::string deeplyBracketed(size_t);
+std::string longStrings(size_t);
+std::string repeated(const std::string &, size_t);
+
+// All of the above, with the sample file repeated up to size as well
+std::vector<Workload> corpus(size_t, const std::string &sample);
@@ -0,0 +1,192 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "harness.hpp"
+
+#include "bytecode.hpp"
+#include "jit.hpp"
+#include "vm.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using std::cerr;
+using std::endl;
+using std::string;
+using std::vector;
+
+// Small programs that spend their time in different instructions: a tight
+// loop of arithmetic, calls and returns, bit twiddling with branches, and
+// constant expressions with a debug branch for the optimizer to remove
+
+static const Sample SAMPLES[] = {
+    {"loop",
+     "fun loop(n) {\n"
+     "    i = 0\n"
+     "    s = 0\n"
+     "    while i < n {\n"
+     "        s += i * 3 % 7\n"
+     "        i += 1\n"
+     "    }\n"
+     "    return s\n"
+     "}\n"
+     "print(loop({N}))\n",
+     3000000},
+    {"fib",
+     "fun fib(n) {\n"
+     "    if n < 2 {\n"
+     "        return n\n"
+     "    }\n"
+     "    return fib(n - 1) + fib(n - 2)\n"
+     "}\n"
+     "print(fib({N}))\n",
+     27},
+    {"bits",
+     "fun bits(n) {\n"
+     "    i = 0\n"
+     "    h = 1\n"
+     "    while i < n {\n"
+     "        h = (h << 5 ^ h >> 3 ^ i) & 16777215\n"
+     "        h += i ** 2 // 3\n"
+     "        if h % 2 === 0 {\n"
+     "            h -= 1\n"
+     "        }\n"
+     "        i += 1\n"
+     "    }\n"
+     "    return h\n"
+     "}\n"
+     "print(bits({N}))\n",
+     1000000},
+    {"consts",
+     "fun consts(n) {\n"
+     "    i = 0\n"
+     "    s = 0\n"
+     "    while i < n {\n"
+     "        s += (1 << 4) * 3 - 2 ** 3 + i % (60 // 4)\n"
+     "        if 1 > 2 {\n"
+     "            print(\"debug\", s)\n"
+     "        }\n"
+     "        i += 1\n"
+     "    }\n"
+     "    return s\n"
+     "}\n"
+     "print(consts({N}))\n",
+     1000000},
+};
+
+static const OPT_LEVELS LEVELS[] = {OPT_LEVELS::O0_LEVEL,
+                                    OPT_LEVELS::O1_LEVEL,
+                                    OPT_LEVELS::O2_LEVEL};
+
+int main(int argc, char **argv) {
+    HarnessFlags flags = getFlags(argc, argv);
+    if (flags.error) {
+        cerr << flags.errorMsg << endl;
+        return EXIT_FAILURE;
+    }
+    if (!threadedDispatch()) {
+        cerr << "Built without computed goto, both columns use the switch"
+             << endl;
+    }
+    if (!Jit::supported()) {
+        cerr << "No JIT on this machine, the jit column is the interpreter"
+             << endl;
+    }
+    bool failed = false;
+    vector<long> sizes;
+    for (const Sample &entry: SAMPLES) {
+        long size = entry.size;
+        if (string(entry.name) != "fib") { // fib grows exponentially
+            size = long(size * flags.scale);
+        }
+        else if (flags.scale < 1) {
+            size = 20;
+        }
+        sizes.push_back(size);
+    }
+    printf("%-8s %12s %12s %8s %12s %8s\n", "program", "switch ms",
+           "threaded ms", "speedup", "jit ms", "speedup");
+    for (size_t s = 0; s < sizes.size(); s++) {
+        const Sample &entry = SAMPLES[s];
+        Program program;
+        if (!compile(entry.name, expand(entry, sizes[s]),
+                     OPT_LEVELS::O2_LEVEL, program)) {
+            return EXIT_FAILURE;
+        }
+        RunOptions options;
+        string switched;
+        string threaded;
+        string jitted;
+        options.dispatch = DISPATCH_MODES::SWITCH_DISPATCH;
+        double a = run(program, options, flags.repeat, switched);
+        options.dispatch = DISPATCH_MODES::THREADED_DISPATCH;
+        double b = run(program, options, flags.repeat, threaded);
+        options.jit = JIT_MODES::ON_JIT;
+        double c = run(program, options, flags.repeat, jitted);
+        printf("%-8s %12.2f %12.2f %7.2fx %12.2f %7.2fx\n", entry.name,
+               a * 1e3, b * 1e3, a / b, c * 1e3, b / c);
+        if (!agree(entry.name, "threaded dispatch", threaded, switched)
+            || !agree(entry.name, "the JIT", jitted, switched)) {
+            failed = true;
+        }
+    }
+    // Instructions run and time taken at each level, in millions
+    printf("\n%-8s %10s %10s %10s %10s %10s %8s\n", "program", "O0 M ins",
+           "O1 M ins", "O2 M ins", "O0 ms", "O2 ms", "speedup");
+    for (size_t s = 0; s < sizes.size(); s++) {
+        const Sample &entry = SAMPLES[s];
+        double counts[3];
+        double times[3];
+        string outputs[3];
+        for (int l = 0; l < 3; l++) {
+            Program program;
+            if (!compile(entry.name, expand(entry, sizes[s]), LEVELS[l],
+                         program)) {
+                return EXIT_FAILURE;
+            }
+            std::ostringstream out;
+            VM vm{program, out};
+            vm.run(DISPATCH_MODES::COUNTING_DISPATCH);
+            counts[l] = vm.executed / 1e6;
+            times[l] = run(program, RunOptions{}, flags.repeat, outputs[l]);
+            string level = "-O" + std::to_string(l);
+            if (!agree(entry.name, level + " counting", out.str(),
+                       outputs[l])
+                || !agree(entry.name, level, outputs[l], outputs[0])) {
+                failed = true;
+            }
+        }
+        printf("%-8s %10.2f %10.2f %10.2f %10.2f %10.2f %7.2fx\n",
+               entry.name, counts[0], counts[1], counts[2], times[0] * 1e3,
+               times[2] * 1e3, times[0] / times[2]);
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
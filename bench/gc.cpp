@@ -0,0 +1,151 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "harness.hpp"
+
+#include "bytecode.hpp"
+#include "heap.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using std::cerr;
+using std::endl;
+using std::string;
+
+// Allocation-heavy programs: objects that die young, strings joined in a
+// loop, and a list that lives long while its nodes keep being given new
+// strings, which is what the write barrier is for
+
+static const Sample SAMPLES[] = {
+    {"objects",
+     "class Point {\n"
+     "    fun Point(this, x, y):\n"
+     "        this.x = x\n"
+     "        this.y = y\n"
+     "}\n"
+     "fun objects(n) {\n"
+     "    i = 0\n"
+     "    s = 0\n"
+     "    while i < n {\n"
+     "        p = Point(i, i % 7)\n"
+     "        s += p.x * p.y\n"
+     "        i += 1\n"
+     "    }\n"
+     "    return s\n"
+     "}\n"
+     "print(objects({N}))\n",
+     2000000},
+    {"strings",
+     "fun strings(n) {\n"
+     "    i = 0\n"
+     "    s = \"\"\n"
+     "    while i < n {\n"
+     "        s = \"ab\" + \"cd\"\n"
+     "        s = s + s\n"
+     "        i += 1\n"
+     "    }\n"
+     "    return s\n"
+     "}\n"
+     "print(strings({N}))\n",
+     2000000},
+    {"list",
+     "class Node {\n"
+     "    fun Node(this, next):\n"
+     "        this.next = next\n"
+     "        this.value = \"\"\n"
+     "}\n"
+     "fun list(n) {\n"
+     "    head = None\n"
+     "    i = 0\n"
+     "    while i < 20000 {\n"
+     "        head = Node(head)\n"
+     "        i += 1\n"
+     "    }\n"
+     "    i = 0\n"
+     "    node = head\n"
+     "    while i < n {\n"
+     "        node.value = \"v\" + \"w\"\n"
+     "        node = node.next\n"
+     "        if node == None {\n"
+     "            node = head\n"
+     "        }\n"
+     "        i += 1\n"
+     "    }\n"
+     "    return head.value\n"
+     "}\n"
+     "print(list({N}))\n",
+     2000000},
+};
+
+static const size_t NURSERIES[] = {64, 1024, 8192}; // KB
+
+int main(int argc, char **argv) {
+    HarnessFlags flags = getFlags(argc, argv);
+    if (flags.error) {
+        cerr << flags.errorMsg << endl;
+        return EXIT_FAILURE;
+    }
+    bool failed = false;
+    printf("%-8s %10s %10s %8s %8s %12s %12s\n", "program", "nursery KB",
+           "ms", "minors", "majors", "max pause ms", "promoted KB");
+    for (const Sample &entry: SAMPLES) {
+        long size = long(entry.size * flags.scale);
+        Program program;
+        if (!compile(entry.name, expand(entry, size), OPT_LEVELS::O2_LEVEL,
+                     program)) {
+            return EXIT_FAILURE;
+        }
+        string first;
+        for (size_t nursery: NURSERIES) {
+            RunOptions options;
+            options.heap.nursery = nursery << 10;
+            string output;
+            GcStats stats;
+            double seconds = run(program, options, flags.repeat, output,
+                                 &stats);
+            printf("%-8s %10zu %10.2f %8llu %8llu %12.3f %12llu\n",
+                   entry.name, nursery, seconds * 1e3,
+                   (unsigned long long)stats.minors,
+                   (unsigned long long)stats.majors,
+                   std::max(stats.minorMax, stats.majorMax) * 1e3,
+                   (unsigned long long)stats.promoted >> 10);
+            if (first.empty()) {
+                first = output;
+            }
+            else if (!agree(entry.name,
+                            "a " + std::to_string(nursery) + " KB nursery",
+                            output, first)) {
+                failed = true;
+            }
+        }
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
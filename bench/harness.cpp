@@ -0,0 +1,124 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "harness.hpp"
+
+#include "ast.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "tokens.hpp"
+
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using std::cerr;
+using std::endl;
+using std::string;
+using std::chrono::duration;
+using std::chrono::steady_clock;
+
+HarnessFlags getFlags(int argc, char **argv) {
+    HarnessFlags flags;
+    for (int i = 1; i < argc; i++) {
+        string arg{argv[i]};
+        size_t eq = arg.find('=');
+        string name = arg.substr(0, eq);
+        string value = eq == string::npos ? "" : arg.substr(eq + 1);
+        try {
+            if (name == "--scale") {
+                flags.scale = std::stod(value);
+            }
+            else if (name == "--repeat") {
+                flags.repeat = std::stoi(value);
+            }
+            else {
+                flags.error = true;
+                flags.errorMsg = "Unknown flag: " + arg;
+            }
+        }
+        catch (const std::exception &) {
+            flags.error = true;
+            flags.errorMsg = "Invalid value: " + arg;
+        }
+    }
+    if (flags.repeat < 1) {
+        flags.repeat = 1;
+    }
+    return flags;
+}
+
+string expand(const Sample &entry, long size) {
+    string source = entry.source;
+    source.replace(source.find("{N}"), 3, std::to_string(size));
+    return source;
+}
+
+bool compile(const string &name, const string &source, OPT_LEVELS level,
+             Program &program) {
+    Lexer lexer{name, source};
+    Parser parser{lexer.tokenize()};
+    Ast ast = parser.parse();
+    Compiler compiler{ast, level};
+    program = compiler.compile(name);
+    if (!compiler.diagnostics.empty() || !parser.diagnostics.empty()) {
+        cerr << name << ": does not compile" << endl;
+        return false;
+    }
+    return true;
+}
+
+double run(const Program &program, const RunOptions &options, int repeat,
+           string &output, GcStats *stats) {
+    double best = 0;
+    for (int i = 0; i < repeat; i++) {
+        std::ostringstream out;
+        VM vm{program, out, options.heap};
+        auto start = steady_clock::now();
+        vm.run(options.dispatch, options.jit);
+        double seconds = duration<double>(steady_clock::now() - start).count();
+        if (i == 0 || seconds < best) {
+            best = seconds;
+        }
+        output = out.str();
+        if (stats) {
+            *stats = vm.heap.stats;
+        }
+    }
+    return best;
+}
+
+bool agree(const string &program, const string &mode, const string &output,
+           const string &expected) {
+    if (output == expected) {
+        return true;
+    }
+    cerr << program << ": " << mode << " prints " << output << " instead of "
+         << expected << endl;
+    return false;
+}
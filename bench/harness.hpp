@@ -0,0 +1,77 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include "bytecode.hpp"
+#include "compiler.hpp"
+#include "heap.hpp"
+#include "jit.hpp"
+#include "vm.hpp"
+
+#include <string>
+
+// What tooty_dispatch, tooty_attributes and tooty_gc share: flags, timing
+// a compiled program and checking that its modes agree
+
+// --scale=F multiplies the size of every program and --repeat=N takes the
+// best of N runs
+struct HarnessFlags {
+    double scale = 1;
+    int repeat = 3;
+    bool error = false;
+    std::string errorMsg = "";
+};
+
+HarnessFlags getFlags(int argc, char **argv);
+
+struct Sample {
+    const char *name;
+    const char *source; // {N} is replaced by the size
+    long size;
+};
+
+std::string expand(const Sample &, long size);
+
+// False, with why on stderr, when the source does not compile
+bool compile(const std::string &name, const std::string &source,
+             OPT_LEVELS, Program &);
+
+// How a program is run
+struct RunOptions {
+    DISPATCH_MODES dispatch = DISPATCH_MODES::THREADED_DISPATCH;
+    JIT_MODES jit = JIT_MODES::OFF_JIT;
+    HeapOptions heap;
+};
+
+// The best of repeat runs, in seconds. Output is what the last run printed
+// and stats, if given, its collections.
+double run(const Program &, const RunOptions &, int repeat,
+           std::string &output, GcStats *stats = nullptr);
+
+// False, with both outputs on stderr, when a mode prints something else
+bool agree(const std::string &program, const std::string &mode,
+           const std::string &output, const std::string &expected);
@@ -0,0 +1,335 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "exceptions.hpp"
+#include "lexer.hpp"
+#include "simd.hpp"
+#include "sources.hpp"
+#include "tokenbuffer.hpp"
+#include "tokens.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using std::cerr;
+using std::endl;
+using std::string;
+using std::string_view;
+using std::vector;
+
+// Every backend checked against REGEX, the reference; a new backend only
+// needs adding here
+static const BACKENDS FAST[] = {BACKENDS::DFA};
+
+// Each input is lexed at every level the CPU supports, unless --simd=LEVEL
+// picks one
+static vector<SIMD_LEVELS> levels = {SIMD_LEVELS::SCALAR, SIMD_LEVELS::SSE2,
+                                     SIMD_LEVELS::AVX2};
+
+// What lexing an input came to, kept as plain values so that two runs can
+// be compared after their SOURCES entries are released
+struct Outcome {
+    vector<Token> tokens;
+    vector<string> diagnostics;
+    string error; // what() of a fatal InvalidSyntax
+    bool operator==(const Outcome &other) const {
+        if (this->diagnostics != other.diagnostics
+            || this->error != other.error) {
+            return false;
+        }
+        if (!this->error.empty()) { // tokenize() drops the tokens it had
+            return true;
+        }
+        if (this->tokens.size() != other.tokens.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < this->tokens.size(); i++) {
+            const Token &a = this->tokens[i], &b = other.tokens[i];
+            if (a.pos != b.pos || a.type != b.type || a.length != b.length) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+// Diagnostics are placed while their window is still indexed
+static void drain(Outcome &outcome, Lexer &lexer) {
+    for (const Diagnostic &diagnostic: lexer.diagnostics.all()) {
+        outcome.diagnostics.push_back(diagnostic.toString());
+    }
+    lexer.diagnostics.truncate(0);
+}
+
+static void finish(Outcome &outcome, Lexer &lexer) {
+    drain(outcome, lexer);
+    SOURCES.release(lexer.fileId()); // or a long fuzzing run keeps them all
+}
+
+static Outcome lexAll(string_view text, BACKENDS backend) {
+    Outcome outcome;
+    Lexer lexer{"fuzz.tooty", text, backend};
+    try {
+        outcome.tokens = lexer.tokenize();
+    }
+    catch (InvalidSyntax const &exc) {
+        outcome.error = exc.what();
+    }
+    finish(outcome, lexer);
+    return outcome;
+}
+
+// The same tokens pushed into a TokenBuffer and read back
+static Outcome lexColumns(string_view text, BACKENDS backend) {
+    Outcome outcome;
+    Lexer lexer{"fuzz.tooty", text, backend};
+    TokenBuffer columns{text};
+    try {
+        lexer.tokenize(columns);
+    }
+    catch (InvalidSyntax const &exc) {
+        outcome.error = exc.what();
+    }
+    for (size_t i = 0; i < columns.size(); i++) {
+        outcome.tokens.push_back(Token{0, columns.start(i) + 1,
+                                       columns.kind(i), columns.length(i)});
+    }
+    finish(outcome, lexer);
+    return outcome;
+}
+
+// Fed a few bytes at a time like TokenStream, keeping only the unlexed
+// tail in the window
+static Outcome lexChunks(string_view text, BACKENDS backend, size_t chunk) {
+    Outcome outcome;
+    Lexer lexer{"fuzz.tooty", string_view{}, backend};
+    size_t base = 0;
+    size_t used = 0;
+    bool last = false;
+    lexer.feed(string_view{}, 0, false);
+    try {
+        Token token;
+        while (true) {
+            if (lexer.nextToken(token)) {
+                outcome.tokens.push_back(token);
+                continue;
+            }
+            if (!lexer.starved() || last) {
+                break;
+            }
+            base = lexer.consumed();
+            used = std::min(text.size(), used + chunk);
+            last = used == text.size();
+            drain(outcome, lexer);
+            lexer.feed(text.substr(base, used - base), base, last);
+        }
+    }
+    catch (InvalidSyntax const &exc) {
+        outcome.error = exc.what();
+    }
+    finish(outcome, lexer);
+    return outcome;
+}
+
+static void check(const Outcome &expected, const Outcome &got,
+                  const char *what, BACKENDS backend) {
+    if (expected == got) {
+        return;
+    }
+    cerr << "tooty_fuzz_lexer: " << what << " with backend " << int{backend}
+         << " at " << simdLevelName(simdLevel())
+         << " differs from the scalar regex lexer (" << got.tokens.size()
+         << " vs "
+         << expected.tokens.size() << " tokens, error '" << got.error
+         << "' vs '" << expected.error << "')" << endl;
+    abort();
+}
+
+// Takes --simd=scalar, --simd=sse2 or --simd=avx2, which libFuzzer passes
+// through as it ignores flags starting with --
+extern "C" int LLVMFuzzerInitialize(int *argc, char ***argv) {
+    for (int i = 1; i < *argc; i++) {
+        const char *arg = (*argv)[i];
+        if (std::strncmp(arg, "--simd=", 7) != 0) {
+            continue;
+        }
+        string name{arg + 7};
+        if (name == "scalar") {
+            levels = {SIMD_LEVELS::SCALAR};
+        }
+        else if (name == "sse2") {
+            levels = {SIMD_LEVELS::SSE2};
+        }
+        else if (name == "avx2") {
+            levels = {SIMD_LEVELS::AVX2};
+        }
+        else {
+            cerr << "tooty_fuzz_lexer: unknown SIMD level '" << name << "'"
+                 << endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    string text{reinterpret_cast<const char *>(data), size};
+    setSimdLevel(SIMD_LEVELS::SCALAR);
+    Outcome reference = lexAll(text, BACKENDS::REGEX);
+    // a chunk size taken from the input, so the fuzzer varies it too. Each
+    // refill lexes the token it stopped in again, so big inputs get bigger
+    // chunks to keep that from going quadratic.
+    size_t chunk = std::max<size_t>(size ? data[0] % 16 + 1 : 1, size / 64);
+    for (SIMD_LEVELS level: levels) {
+        setSimdLevel(level);
+        if (simdLevel() != level) { // not supported here
+            continue;
+        }
+        check(reference, lexChunks(text, BACKENDS::REGEX, chunk),
+              "streaming", BACKENDS::REGEX);
+        for (BACKENDS backend: FAST) {
+            check(reference, lexAll(text, backend), "lexing", backend);
+            check(reference, lexColumns(text, backend), "a TokenBuffer",
+                  backend);
+            check(reference, lexChunks(text, backend, chunk), "streaming",
+                  backend);
+        }
+    }
+    return 0;
+}
+
+#ifndef TOOTY_LIBFUZZER
+// Without libFuzzer this runs each file given, every file in each
+// directory given, or stdin as AFL does it. --mutations=N also runs N
+// random byte edits of every input, for a quick check without a fuzzer,
+// and --simd=LEVEL checks only that level.
+static void runInput(const string &text, int mutations, std::mt19937 &random) {
+    LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t *>(text.data()),
+                           text.size());
+    static const char BYTES[] = "\n \t\"'#/*(){}[]:=+-<>!.0afZ_\\\r@";
+    for (int i = 0; i < mutations; i++) {
+        string mutated = text;
+        for (int edits = random() % 4 + 1; edits > 0; edits--) {
+            size_t at = mutated.empty() ? 0 : random() % mutated.size();
+            char c = random() % 4 ? BYTES[random() % (sizeof BYTES - 1)]
+                                  : char(random());
+            switch (random() % 3) {
+                case 0:
+                    mutated.insert(mutated.begin() + at, c);
+                    break;
+                case 1:
+                    if (!mutated.empty()) {
+                        mutated.erase(at, 1);
+                    }
+                    break;
+                default:
+                    if (!mutated.empty()) {
+                        mutated[at] = c;
+                    }
+                    break;
+            }
+        }
+        LLVMFuzzerTestOneInput(
+            reinterpret_cast<const uint8_t *>(mutated.data()),
+            mutated.size());
+    }
+}
+
+static bool readFile(const std::filesystem::path &path, string &text) {
+    std::ifstream in{path, std::ios::binary};
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    text = buffer.str();
+    return bool(in);
+}
+
+int main(int argc, char **argv) {
+    LLVMFuzzerInitialize(&argc, &argv);
+    int mutations = 0;
+    vector<std::filesystem::path> inputs;
+    for (int i = 1; i < argc; i++) {
+        string arg{argv[i]};
+        if (arg.rfind("--mutations=", 0) == 0) {
+            mutations = std::atoi(arg.c_str() + 12);
+            continue;
+        }
+        if (arg.rfind("--simd=", 0) == 0) {
+            continue;
+        }
+        if (std::filesystem::is_directory(arg)) {
+            for (const auto &entry:
+                 std::filesystem::recursive_directory_iterator(arg)) {
+                if (entry.is_regular_file()) {
+                    inputs.push_back(entry.path());
+                }
+            }
+            continue;
+        }
+        inputs.push_back(arg);
+    }
+    std::mt19937 random{20211};
+    if (inputs.empty()) {
+        string text{std::istreambuf_iterator<char>(std::cin),
+                    std::istreambuf_iterator<char>()};
+        runInput(text, mutations, random);
+        return EXIT_SUCCESS;
+    }
+    std::sort(inputs.begin(), inputs.end()); // the same order every run
+    for (const std::filesystem::path &input: inputs) {
+        string text;
+        if (!readFile(input, text)) {
+            cerr << "Could not open the file - '" << input.string() << "'"
+                 << endl;
+            return EXIT_FAILURE;
+        }
+        runInput(text, mutations, random);
+    }
+    printf("%zu inputs, %d mutations each, all backends agree at",
+           inputs.size(), mutations);
+    for (SIMD_LEVELS level: levels) {
+        setSimdLevel(level);
+        if (simdLevel() == level) {
+            printf(" %s", simdLevelName(level));
+        }
+    }
+    printf("\n");
+    return EXIT_SUCCESS;
+}
+#endif
@@ -37,20 +37,15 @@ class InvalidSyntax: public std::exception {
     const std::string line;
     const std::string file;
     const std::string message;
+    const std::string full;
     explicit InvalidSyntax(const std::string file, const int line,
                            const int lpos, std::string message)
-        : file(file), line(std::to_string(line)), lpos(std::to_string(lpos)),
-          message(message){};
+        : lpos(std::to_string(lpos)), line(std::to_string(line)), file(file),
+          message(message),
+          full(this->file + ":" + this->line + ":" + this->lpos + ": "
+               + this->message){};
     virtual const char *what() const throw() {
-        std::string m;
-        m += this->file;
-        m += ":";
-        m += this->line;
-        m += ":";
-        m += this->lpos;
-        m += ": ";
-        m += this->message;
-        return m.c_str();
+        return this->full.c_str();
     }
 };
 
@@ -74,3 +69,28 @@ class UnmatchedBracket: public InvalidSyntax {
                               const int pos, std::string message)
         : InvalidSyntax(file, line, pos, message){};
 };
+
+class SourceTooBig: public InvalidSyntax {
+  public:
+    explicit SourceTooBig(const std::string file, const int line,
+                          const int pos, std::string message)
+        : InvalidSyntax(file, line, pos, message){};
+};
+
+class RuntimeError: public std::exception {
+  public:
+    const std::string lpos;
+    const std::string line;
+    const std::string file;
+    const std::string message;
+    const std::string full;
+    explicit RuntimeError(const std::string file, const int line,
+                          const int lpos, std::string message)
+        : lpos(std::to_string(lpos)), line(std::to_string(line)), file(file),
+          message(message),
+          full(this->file + ":" + this->line + ":" + this->lpos + ": "
+               + this->message){};
+    virtual const char *what() const throw() {
+        return this->full.c_str();
+    }
+};
@@ -26,41 +26,109 @@ SOFTWARE.
 */
 
 #include "VERSION.hpp"
+#include "bytecode.hpp"
+#include "cache.hpp"
+#include "compiler.hpp"
+#include "diagnostics.hpp"
 #include "exceptions.hpp"
+#include "heap.hpp"
+#include "jit.hpp"
 #include "lexer.hpp"
+#include "output.hpp"
+#include "parser.hpp"
+#include "pool.hpp"
+#include "simd.hpp"
+#include "sources.hpp"
+#include "stats.hpp"
+#include "stream.hpp"
+#include "tokenfile.hpp"
 #include "tokens.hpp"
+#include "vm.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
 #include <cstring>
 #include <exception>
 #include <fstream>
 #include <iostream>
 #include <list>
-#include <sstream>
+#include <memory>
+#include <mutex>
 #include <stdio.h>
 #include <string>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 using std::cerr;
+using std::condition_variable;
 using std::cout;
 using std::endl;
 using std::exception;
-using std::ifstream;
+using std::lock_guard;
 using std::list;
-using std::ostringstream;
+using std::mutex;
 using std::string;
 using std::strstr;
+using std::unique_lock;
 using std::vector;
+using std::chrono::duration;
+using std::chrono::steady_clock;
+
+// -j takes at most this many jobs per core, more only adds threads that wait
+const unsigned JOBS_PER_CORE = 4;
 
 struct Flags {
     string path;
     vector<string> files;
     bool version = false;
     bool help = false;
+    BACKENDS backend = BACKENDS::DFA;
+    bool memory = false;
+    bool stream = false;
+    bool ast = false;
+    bool binary = false; // --emit-tokens=bin
+    bool batched = true; // --output=iostream writes through cout instead
+    bool run = false;
+    bool bytecode = false;
+    bool cache = true;
+    OPT_LEVELS level = OPT_LEVELS::O2_LEVEL;
+    bool stats = false;
+    string trace; // file for --trace, empty if not tracing
+    DISPATCH_MODES dispatch = DISPATCH_MODES::THREADED_DISPATCH;
+    JIT_MODES jit = JIT_MODES::OFF_JIT;
+    HeapOptions heap;
+    bool gcStats = false;
+    unsigned jobs = 1;
+    bool jobsSet = false;
     bool error = false;
     string errorMsg = "";
 };
 
+struct LexResult {
+    std::unique_ptr<SourceBuffer> source; // null if the file can't be opened
+    vector<Token> tokens;
+    string status; // line printed to stdout when lexing stopped early
+    string error;
+    vector<Diagnostic> diagnostics;
+    string ast; // the syntax tree, if asked for
+};
+
 Flags getFlags(int argc, char **argv);
+LexResult lexFile(const string &file, BACKENDS backend, bool parse);
+bool streamFile(const string &file, BACKENDS backend, std::ostream &out);
+bool runFile(const string &file, const Flags &flags);
+void memoryReport(std::ostream &out, const vector<Token> &tokens);
+void writeToken(std::ostream &out, size_t index, const Token &token);
+int finish(const Flags &flags, int status);
+
+// stdout for the token dumps and trees, unless --output=iostream
+static OutputBuffer batched{STDOUT_FILENO};
+static std::ostream dump{&batched};
 
 int main(int argc, char **argv) {
     Flags flags = getFlags(argc, argv);
@@ -73,45 +141,207 @@ int main(int argc, char **argv) {
         cout << "Tooty-lang v" << VERSION_MAJOR << "." << VERSION_MINOR << "."
              << VERSION_MICRO << "\n\n"
              << "Usage: tooty [options] [file] [options]\n"
+             << "       tooty run [options] file\n"
+             << "       (use - as the file to read from stdin)\n"
              << "\n"
              << "Options:\n"
              << "\n"
              << "-v, --version : displays the version (major.minor.micro)\n"
-             << "-h, --help    : displays this help message and exits" << endl;
+             << "-h, --help    : displays this help message and exits\n"
+             << "--lexer=dfa   : lexer backend to use, regex or dfa (default)\n"
+             << "--simd=avx2   : caps the byte scanning kernels at scalar, "
+                "sse2 or avx2\n"
+             << "--memory      : reports the memory used per token\n"
+             << "--stream      : lexes each file in chunks as it is read, "
+                "in constant memory\n"
+             << "--ast         : prints the syntax tree instead of the tokens\n"
+             << "--emit-tokens=text : how tokens are written to stdout, text "
+                "(default) or bin\n"
+             << "--output=batched : writes stdout in large blocks, or "
+                "through iostream\n"
+             << "--dispatch=threaded : how run dispatches bytecode, switch "
+                "or threaded (default)\n"
+             << "--jit=off     : with run, compiles hot funs to x86-64, "
+                "off (default), on or\n"
+             << "                always\n"
+             << "--nursery=KB  : with run, the young generation of the "
+                "heap, 1024 by default\n"
+             << "                and from 64 to 1048576\n"
+             << "--heap=MB     : with run, the most the old generation may "
+                "hold, 256 by\n"
+             << "                default and 2048 at most\n"
+             << "--gc-stats    : with run, reports garbage collection "
+                "pauses to stderr\n"
+             << "--bytecode    : with run, prints the bytecode instead of "
+                "running it\n"
+             << "-O0, -O1, -O2 : with run, optimizes nothing, folds "
+                "constants and dead\n"
+             << "                branches, or also fuses instructions "
+                "(default)\n"
+             << "--no-cache    : with run, compiles the file even if "
+             << CACHEDIR << " has it\n"
+             << "--stats       : reports time per phase, throughput, "
+                "allocations and token\n"
+             << "                kinds to stderr\n"
+             << "--trace=FILE  : writes a Chrome trace of the phases of "
+                "each file to FILE\n"
+             << "-j N, --jobs=N: lexes N files at once (0 for one per core), "
+                "at most 4 per\n"
+             << "                core" << endl;
         return 0;
     }
-    if (flags.files.size() != 0) {
-        for (int i = 0; i < flags.files.size(); i++) {
-            string file = flags.files[i];
-            cout << "Tooty-lang: " << file << ": " << endl;
-            ostringstream ss = ostringstream{};
-            ifstream input_file(file);
-            if (!input_file.is_open()) {
-                cerr << "Could not open the file - '" << file << "'" << endl;
-                exit(EXIT_FAILURE);
-            }
-            ss << input_file.rdbuf();
-            Lexer lexer{file, ss.str()};
-            vector<Token> tokens;
-            try {
-                tokens = lexer.tokenize();
-            }
-            catch (UnknownToken const &exc) {
-                cout << "Unknown token" << endl;
-                cerr << "Exception caught " << exc.what() << endl;
+    if (flags.error) {
+        cerr << flags.errorMsg << endl;
+        exit(EXIT_FAILURE);
+    }
+    if (flags.stats || !flags.trace.empty()) {
+        STATS.enable(!flags.trace.empty());
+    }
+    std::ostream &out = flags.batched ? dump : cout;
+    if (flags.batched) { // so errors still come after the output before them
+        cerr.tie(&dump);
+    }
+    if (flags.run) {
+        if (flags.files.size() != 1) {
+            cerr << "run takes exactly one file" << endl;
+            exit(EXIT_FAILURE);
+        }
+        bool ran = runFile(flags.files[0], flags);
+        exit(finish(flags, ran ? EXIT_SUCCESS : EXIT_FAILURE));
+    }
+    if (flags.files.size() != 0 && flags.stream) {
+        for (const string &file: flags.files) {
+            if (!streamFile(file, flags.backend, out)) {
+                exit(finish(flags, EXIT_FAILURE));
             }
-            catch (exception const &exc) {
-                cout << "Unknown exception" << endl;
-                cerr << "Exception caught " << exc.what() << endl;
+        }
+        exit(finish(flags, EXIT_SUCCESS));
+    }
+    if (flags.files.size() != 0) {
+        vector<LexResult> results(flags.files.size());
+        vector<bool> ready(flags.files.size(), false);
+        // A file named twice is lexed once and printed twice. Two lexes
+        // would share its SOURCES entry, and the second would point it at
+        // its own buffer while the first result is still being printed.
+        vector<size_t> first(flags.files.size());
+        vector<size_t> last(flags.files.size());
+        std::unordered_map<string, size_t> seen;
+        for (size_t i = 0; i < flags.files.size(); i++) {
+            first[i] = seen.emplace(flags.files[i], i).first->second;
+            last[first[i]] = i;
+        }
+        mutex lock;
+        condition_variable done;
+        size_t bytes = 0;
+        bool failed = false;
+        auto start = steady_clock::now();
+        {
+            ThreadPool pool{flags.jobs};
+            for (size_t i = 0; i < flags.files.size(); i++) {
+                if (first[i] != i) {
+                    continue;
+                }
+                pool.submit([&, i] {
+                    LexResult result =
+                        lexFile(flags.files[i], flags.backend, flags.ast);
+                    lock_guard<mutex> guard{lock};
+                    results[i] = std::move(result);
+                    ready[i] = true;
+                    done.notify_all();
+                });
             }
-            cout << tokens.size() << endl;
-            for (int i = 0; i < tokens.size(); i++) {
-                cout << i << ": " << tokens[i].toString() << "\n";
+            // print in command line order, whichever worker finishes first
+            for (size_t i = 0; i < flags.files.size(); i++) {
+                size_t k = first[i];
+                {
+                    unique_lock<mutex> guard{lock};
+                    done.wait(guard, [&] {
+                        return bool{ready[k]};
+                    });
+                }
+                LexResult owned; // freed after the last time it is printed
+                if (last[k] == i) {
+                    owned = std::move(results[k]);
+                }
+                LexResult &result = last[k] == i ? owned : results[k];
+                string file = flags.files[i];
+                PhaseTimer timer{EMIT_PHASE, file};
+                if (!flags.binary) {
+                    out << "Tooty-lang: " << file << ": \n";
+                }
+                if (!result.source) {
+                    cerr << "Could not open the file - '" << file << "'"
+                         << endl;
+                    failed = true;
+                    break;
+                }
+                bytes += result.source->size();
+                for (const Diagnostic &diagnostic: result.diagnostics) {
+                    cerr << diagnostic.toString() << endl;
+                }
+                if (!result.status.empty()) {
+                    (flags.binary ? cerr : out) << result.status << "\n";
+                    cerr << "Exception caught " << result.error << endl;
+                }
+                vector<Token> &tokens = result.tokens;
+                if (flags.binary) {
+                    if (!writeTokens(out, file, result.source->view(),
+                                     tokens)) {
+                        cerr << "Could not write the tokens" << endl;
+                        failed = true;
+                        break;
+                    }
+                    continue;
+                }
+                if (flags.ast) {
+                    out << result.ast;
+                    continue;
+                }
+                out << tokens.size() << "\n";
+                for (size_t i = 0; i < tokens.size(); i++) {
+                    writeToken(out, i, tokens[i]);
+                }
+                if (flags.memory) {
+                    memoryReport(out, tokens);
+                }
             }
         }
-        exit(EXIT_SUCCESS);
+        if (failed) { // only once the pool has stopped touching results
+            exit(finish(flags, EXIT_FAILURE));
+        }
+        if (flags.jobsSet) {
+            double seconds =
+                duration<double>(steady_clock::now() - start).count();
+            cerr << "Tooty-lang: " << flags.files.size() << " files with "
+                 << flags.jobs << " jobs in " << seconds << "s ("
+                 << flags.files.size() / seconds << " files/s, "
+                 << bytes / seconds / 1e6 << " MB/s)" << endl;
+        }
+        exit(finish(flags, EXIT_SUCCESS));
     }
-    exit(EXIT_SUCCESS);
+    exit(finish(flags, EXIT_SUCCESS));
+}
+
+// Writes what --stats and --trace asked for once everything has run
+int finish(const Flags &flags, int status) {
+    dump.flush();
+    cout.flush();
+    cerr.tie(&cout); // dump is destroyed before the standard streams
+    if (batched.failed()) {
+        status = EXIT_FAILURE;
+    }
+    if (flags.stats) {
+        STATS.report(cerr);
+    }
+    if (!flags.trace.empty()) {
+        std::ofstream out{flags.trace};
+        if (!out || !STATS.writeTrace(out)) {
+            cerr << "Could not write the trace - '" << flags.trace << "'"
+                 << endl;
+            return EXIT_FAILURE;
+        }
+    }
+    return status;
 }
 
 Flags getFlags(int argc, char **argv) {
@@ -130,8 +360,20 @@ Flags getFlags(int argc, char **argv) {
                 args.push_back(arg.substr(2, string::npos));
             }
             else if (arg.size() > 1) { // -abc
-                for (char c: arg) {
-                    args.push_back(string{c});
+                for (size_t j = 1; j < arg.size(); j++) {
+                    if (arg[j] == 'O') { // -O0, -O1 or -O2
+                        args.push_back(arg.substr(j, string::npos));
+                        break;
+                    }
+                    if (arg[j] == 'j') { // -j N or -jN
+                        string n = arg.substr(j + 1, string::npos);
+                        if (n.empty() && i + 1 < argc) {
+                            n = argv[++i];
+                        }
+                        args.push_back("jobs=" + n);
+                        break;
+                    }
+                    args.push_back(string{arg[j]});
                 }
             }
             for (const string &f: args) { // second iterator for "-abc"
@@ -143,15 +385,338 @@ Flags getFlags(int argc, char **argv) {
                     flags.help = true;
                     return flags;
                 }
+                else if (f == "stream") {
+                    flags.stream = true;
+                }
+                else if (f == "dispatch=switch") {
+                    flags.dispatch = DISPATCH_MODES::SWITCH_DISPATCH;
+                }
+                else if (f == "dispatch=threaded") {
+                    flags.dispatch = DISPATCH_MODES::THREADED_DISPATCH;
+                }
+                else if (f == "jit=off") {
+                    flags.jit = JIT_MODES::OFF_JIT;
+                }
+                else if (f == "jit=on") {
+                    flags.jit = JIT_MODES::ON_JIT;
+                }
+                else if (f == "jit=always") {
+                    flags.jit = JIT_MODES::ALWAYS_JIT;
+                }
+                else if (f == "bytecode") {
+                    flags.bytecode = true;
+                }
+                else if (f == "O0") {
+                    flags.level = OPT_LEVELS::O0_LEVEL;
+                }
+                else if (f == "O1") {
+                    flags.level = OPT_LEVELS::O1_LEVEL;
+                }
+                else if (f == "O2") {
+                    flags.level = OPT_LEVELS::O2_LEVEL;
+                }
+                else if (f == "no-cache") {
+                    flags.cache = false;
+                }
+                else if (f == "ast") {
+                    flags.ast = true;
+                }
+                else if (f == "emit-tokens=bin") {
+                    flags.binary = true;
+                }
+                else if (f == "emit-tokens=text") {
+                    flags.binary = false;
+                }
+                else if (f == "output=batched") {
+                    flags.batched = true;
+                }
+                else if (f == "output=iostream") {
+                    flags.batched = false;
+                }
+                else if (f == "memory") {
+                    flags.memory = true;
+                }
+                else if (f == "stats") {
+                    flags.stats = true;
+                }
+                else if (f.rfind("trace=", 0) == 0) {
+                    flags.trace = f.substr(6, string::npos);
+                    if (flags.trace.empty()) {
+                        flags.error = true;
+                        flags.errorMsg = "Missing trace file: " + arg;
+                    }
+                }
+                else if (f == "gc-stats") {
+                    flags.gcStats = true;
+                }
+                else if (f.rfind("nursery=", 0) == 0
+                         || f.rfind("heap=", 0) == 0) {
+                    size_t eq = f.find('=');
+                    string n = f.substr(eq + 1, string::npos);
+                    if (n.empty() || n.size() > 9
+                        || n.find_first_not_of("0123456789") != string::npos
+                        || std::stoul(n) == 0) {
+                        flags.error = true;
+                        flags.errorMsg = "Invalid heap size: " + arg;
+                        continue;
+                    }
+                    if (f[0] == 'n') {
+                        flags.heap.nursery = size_t(std::stoul(n)) << 10;
+                        if (flags.heap.nursery < MIN_NURSERY
+                            || flags.heap.nursery > MAX_NURSERY) {
+                            flags.error = true;
+                            flags.errorMsg =
+                                "Invalid heap size: " + arg
+                                + ", the nursery is from "
+                                + std::to_string(MIN_NURSERY >> 10) + " to "
+                                + std::to_string(MAX_NURSERY >> 10) + " KB";
+                        }
+                    }
+                    else {
+                        flags.heap.limit = size_t(std::stoul(n)) << 20;
+                        if (flags.heap.limit > MAX_OLD) {
+                            flags.error = true;
+                            flags.errorMsg =
+                                "Invalid heap size: " + arg
+                                + ", the old generation is at most "
+                                + std::to_string(MAX_OLD >> 20) + " MB";
+                        }
+                    }
+                }
+                else if (f.rfind("jobs=", 0) == 0) {
+                    string n = f.substr(5, string::npos);
+                    unsigned cores =
+                        std::max(std::thread::hardware_concurrency(), 1u);
+                    unsigned most = cores * JOBS_PER_CORE;
+                    if (n.empty() || n.size() > 9
+                        || n.find_first_not_of("0123456789") != string::npos
+                        || std::stoul(n) > most) {
+                        flags.error = true;
+                        flags.errorMsg = "Invalid job count: '" + n
+                                         + "', at most "
+                                         + std::to_string(most);
+                        continue;
+                    }
+                    flags.jobs = unsigned(std::stoul(n));
+                    if (flags.jobs == 0) {
+                        flags.jobs = cores;
+                    }
+                    flags.jobsSet = true;
+                }
+                else if (f == "simd=scalar") {
+                    setSimdLevel(SIMD_LEVELS::SCALAR);
+                }
+                else if (f == "simd=sse2") {
+                    setSimdLevel(SIMD_LEVELS::SSE2);
+                }
+                else if (f == "simd=avx2") {
+                    setSimdLevel(SIMD_LEVELS::AVX2);
+                }
+                else if (f == "lexer=regex") {
+                    flags.backend = BACKENDS::REGEX;
+                }
+                else if (f == "lexer=dfa") {
+                    flags.backend = BACKENDS::DFA;
+                }
                 else {
                     flags.error = true;
                     flags.errorMsg = "Unknown flag: " + arg;
                 }
             }
         }
+        else if (arg == "run" && flags.files.empty() && !flags.run) {
+            flags.run = true;
+        }
         else {
             flags.files.push_back(arg);
         }
     }
+    if (flags.binary && (flags.ast || flags.memory || flags.stream)) {
+        flags.error = true;
+        flags.errorMsg = "--emit-tokens=bin can't be used with --ast, "
+                         "--memory or --stream";
+    }
     return flags;
 }
+
+LexResult lexFile(const string &file, BACKENDS backend, bool parse) {
+    PhaseTimer whole{FILE_PHASE, file};
+    LexResult result;
+    PhaseTimer reading{READ_PHASE, file};
+    auto source = std::make_unique<SourceBuffer>(file);
+    reading.stop();
+    if (!source->isOpen()) {
+        return result;
+    }
+    STATS.countBytes(source->size());
+    Lexer lexer{file, source->view(), backend};
+    try {
+        PhaseTimer timer{LEX_PHASE, file};
+        result.tokens = lexer.tokenize();
+    }
+    catch (InvalidSyntax const &exc) {
+        result.status = "Invalid syntax";
+        result.error = exc.what();
+    }
+    catch (exception const &exc) {
+        result.status = "Unknown exception";
+        result.error = exc.what();
+    }
+    STATS.countTokens(result.tokens);
+    result.diagnostics = lexer.diagnostics.all();
+    if (parse && result.status.empty()) {
+        Parser parser{std::move(result.tokens)};
+        PhaseTimer parsing{PARSE_PHASE, file};
+        Ast ast = parser.parse();
+        parsing.stop();
+        PhaseTimer timer{EMIT_PHASE, file};
+        result.ast = ast.toString();
+        const vector<Diagnostic> &found = parser.diagnostics.all();
+        result.diagnostics.insert(result.diagnostics.end(), found.begin(),
+                                  found.end());
+    }
+    result.source = std::move(source);
+    return result;
+}
+
+bool streamFile(const string &file, BACKENDS backend, std::ostream &out) {
+    PhaseTimer whole{FILE_PHASE, file};
+    out << "Tooty-lang: " << file << ": \n";
+    TokenStream stream{file, backend};
+    if (!stream.isOpen()) {
+        cerr << "Could not open the file - '" << file << "'" << endl;
+        return false;
+    }
+    // the token count is only known at the end, so it goes last
+    size_t count = 0;
+    Token token;
+    PhaseTimer timer{LEX_PHASE, file};
+    try {
+        while (stream.next(token)) {
+            STATS.countToken(token.type);
+            for (const Diagnostic &diagnostic: stream.lexer.diagnostics.all()) {
+                cerr << diagnostic.toString() << endl;
+            }
+            stream.lexer.diagnostics.truncate(0);
+            writeToken(out, count++, token);
+        }
+    }
+    catch (InvalidSyntax const &exc) {
+        out << "Invalid syntax\n";
+        cerr << "Exception caught " << exc.what() << endl;
+    }
+    for (const Diagnostic &diagnostic: stream.lexer.diagnostics.all()) {
+        cerr << diagnostic.toString() << endl;
+    }
+    STATS.countBytes(stream.bytesRead());
+    if (stream.failed()) {
+        cerr << "Could not read the file - '" << file << "'" << endl;
+        return false;
+    }
+    out << count << "\n";
+    return true;
+}
+
+bool runFile(const string &file, const Flags &flags) {
+    PhaseTimer whole{FILE_PHASE, file};
+    PhaseTimer reading{READ_PHASE, file};
+    SourceBuffer source{file};
+    if (!source.isOpen()) {
+        cerr << "Could not open the file - '" << file << "'" << endl;
+        return false;
+    }
+    STATS.countBytes(source.size());
+    // a cache file is only good for the level it was compiled at
+    uint64_t hash = sourceHash(source.view()) ^ flags.level;
+    bool cached = flags.cache && file != "-";
+    Program program;
+    bool loaded = cached && loadCache(file, hash, program);
+    reading.stop();
+    if (!loaded) {
+        Lexer lexer{file, source.view(), flags.backend};
+        vector<Token> tokens;
+        try {
+            PhaseTimer timer{LEX_PHASE, file};
+            tokens = lexer.tokenize();
+        }
+        catch (InvalidSyntax const &exc) {
+            cerr << exc.what() << endl;
+            return false;
+        }
+        STATS.countTokens(tokens);
+        Parser parser{std::move(tokens)};
+        PhaseTimer parsing{PARSE_PHASE, file};
+        Ast ast = parser.parse();
+        parsing.stop();
+        PhaseTimer timer{COMPILE_PHASE, file};
+        Compiler compiler{ast, flags.level};
+        program = compiler.compile(file, hash);
+        bool failed = false;
+        for (const Diagnostics *found:
+             {&lexer.diagnostics, &parser.diagnostics, &compiler.diagnostics}) {
+            for (const Diagnostic &diagnostic: found->all()) {
+                cerr << diagnostic.toString() << endl;
+                failed = true;
+            }
+        }
+        if (failed) {
+            return false;
+        }
+        if (cached) { // a read-only directory just means compiling next time
+            storeCache(file, program);
+        }
+    }
+    program.filename = file;
+    if (flags.bytecode) {
+        PhaseTimer timer{EMIT_PHASE, file};
+        (flags.batched ? dump : cout) << program.toString();
+        return true;
+    }
+    VM vm{program, cout, flags.heap};
+    bool ran = true;
+    try {
+        PhaseTimer timer{RUN_PHASE, file};
+        vm.run(flags.dispatch, flags.jit);
+    }
+    catch (RuntimeError const &exc) {
+        cout.flush();
+        cerr << exc.what() << endl;
+        ran = false;
+    }
+    if (flags.gcStats) {
+        cout.flush();
+        vm.heap.report(cerr);
+    }
+    return ran;
+}
+
+void writeToken(std::ostream &out, size_t index, const Token &token) {
+    if (&out == &dump) { // straight into the block, no string in between
+        batched.token(index, token);
+        return;
+    }
+    out << index << ": " << token.toString() << "\n";
+}
+
+void memoryReport(std::ostream &out, const vector<Token> &tokens) {
+    // Tokens used to own their filename and value, so estimate what they
+    // would cost: four ints, two strings and any heap past the SSO buffer
+    size_t sso = string{}.capacity();
+    size_t before = 0;
+    for (const Token &token: tokens) {
+        before += 4 * sizeof(int) + 2 * sizeof(string);
+        if (token.filename().size() > sso) {
+            before += token.filename().size() + 1;
+        }
+        if (token.value().size() > sso) {
+            before += token.value().size() + 1;
+        }
+    }
+    size_t after = tokens.size() * sizeof(Token);
+    size_t count = tokens.empty() ? 1 : tokens.size();
+    out << "Memory: " << tokens.size() << " tokens\n"
+         << "  std::string tokens: " << before << " bytes ("
+         << double(before) / count << " bytes/token)\n"
+         << "  compact tokens:     " << after << " bytes ("
+         << double(after) / count << " bytes/token)\n";
+}
@@ -0,0 +1,76 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// Bump allocator for one kind of trivial object. Objects are named by
+// 32-bit indices instead of pointers and never move once pushed, chunks
+// hold 2^SHIFT of them. Nothing is freed on its own, clear() drops
+// everything at once and keeps the chunks for reuse.
+template <typename T, unsigned SHIFT = 16> class Arena {
+    static_assert(std::is_trivially_destructible<T>::value,
+                  "arena objects are never destroyed");
+
+  public:
+    static const uint32_t CHUNK = uint32_t(1) << SHIFT;
+    Arena() = default;
+    Arena(Arena &&) = default;
+    Arena &operator=(Arena &&) = default;
+    uint32_t push(const T &value) {
+        if (this->count == this->chunks.size() * CHUNK) {
+            this->chunks.emplace_back(new T[CHUNK]);
+        }
+        uint32_t index = this->count++;
+        (*this)[index] = value;
+        return index;
+    }
+    T &operator[](uint32_t index) {
+        return this->chunks[index >> SHIFT][index & (CHUNK - 1)];
+    }
+    const T &operator[](uint32_t index) const {
+        return this->chunks[index >> SHIFT][index & (CHUNK - 1)];
+    }
+    size_t size() const {
+        return this->count;
+    }
+    size_t bytes() const { // reserved, not just used
+        return this->chunks.size() * CHUNK * sizeof(T);
+    }
+    void clear() {
+        this->count = 0;
+    }
+
+  private:
+    std::vector<std::unique_ptr<T[]>> chunks;
+    uint32_t count = 0;
+};
@@ -0,0 +1,125 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "ast.hpp"
+
+#include "tokens.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+static const char *kinds[] = {
+    "MODULE",    "BLOCK",     "IF",        "WHILE",     "FUN",
+    "PARAM",     "CLASS",     "ENUM",      "STRUCT",    "FIELD",
+    "DECORATED", "DECORATOR", "RETURN",    "EXPR",      "ASSIGN",
+    "BINARY",    "UNARY",     "CALL",      "ATTR",      "INDEX",
+    "LIST",      "NAME",      "NUMBER",    "STRING",    "CHAR",
+    "FSTRING",   "FTEXT",     "NONE",      "TYPE",      "ERROR"};
+
+uint32_t Ast::add(NODES kind, uint32_t token, uint32_t a, uint32_t b,
+                  uint32_t c) {
+    return this->nodes.push(Node{kind, TOKENS::ERROR, token, a, b, c, NO_NODE});
+}
+
+const Node &Ast::operator[](uint32_t index) const {
+    return this->nodes[index];
+}
+
+Node &Ast::operator[](uint32_t index) {
+    return this->nodes[index];
+}
+
+// Walks the tree with a stack of its own, as a long chain of operators
+// nests a level per operator and could run the call stack out
+string Ast::toString() const {
+    string t;
+    vector<std::pair<uint32_t, int>> pending; // the next one at the back
+    vector<uint32_t> children;
+    if (this->root != NO_NODE) {
+        pending.emplace_back(this->root, 0);
+    }
+    while (!pending.empty()) {
+        auto [index, depth] = pending.back();
+        pending.pop_back();
+        this->dump(t, index, depth);
+        const Node &node = this->nodes[index];
+        children.clear();
+        for (uint32_t child: {node.a, node.b, node.c}) {
+            for (; child != NO_NODE; child = this->nodes[child].next) {
+                children.push_back(child);
+            }
+        }
+        for (auto child = children.rbegin(); child != children.rend();
+             child++) {
+            pending.emplace_back(*child, depth + 1);
+        }
+    }
+    return t;
+}
+
+// The line of one node
+void Ast::dump(string &t, uint32_t index, int depth) const {
+    const Node &node = this->nodes[index];
+    t.append(std::min(depth, MAXINDENT) * 2, ' ');
+    if (depth > MAXINDENT) {
+        t += '[' + std::to_string(depth) + "] ";
+    }
+    t += kinds[int{node.kind}];
+    switch (node.kind) {
+        case NODES::ASSIGN_NODE:
+        case NODES::BINARY_NODE:
+        case NODES::UNARY_NODE:
+            t += ' ';
+            t += typeName(node.op);
+            break;
+        case NODES::FUN_NODE:
+        case NODES::PARAM_NODE:
+        case NODES::CLASS_NODE:
+        case NODES::ENUM_NODE:
+        case NODES::STRUCT_NODE:
+        case NODES::FIELD_NODE:
+        case NODES::ATTR_NODE:
+        case NODES::NAME_NODE:
+        case NODES::NUMBER_NODE:
+        case NODES::STRING_NODE:
+        case NODES::CHAR_NODE:
+        case NODES::FTEXT_NODE:
+        case NODES::TYPE_NODE:
+            t += ' ';
+            t += this->tokens[node.token].value();
+            break;
+        default:
+            break;
+    }
+    t += '\n';
+}
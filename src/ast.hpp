@@ -0,0 +1,108 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "arena.hpp"
+#include "names.hpp"
+#include "tokens.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Marks a missing child or the end of a list
+const uint32_t NO_NODE = UINT32_MAX;
+
+// Lists (statements, parameters, arguments...) are a first child and then
+// the next field of each element. Unused children are NO_NODE.
+enum NODES : uint8_t
+{
+    MODULE_NODE,    // a: first statement
+    BLOCK_NODE,     // a: first statement
+    IF_NODE,        // a: condition, b: BLOCK, c: else BLOCK or IF
+    WHILE_NODE,     // a: condition, b: BLOCK
+    FUN_NODE,       // token: name, a: first PARAM, b: return TYPE, c: BLOCK
+    PARAM_NODE,     // token: name, a: TYPE, b: default
+    CLASS_NODE,     // token: name, a: first base, b: BLOCK
+    ENUM_NODE,      // token: name, a: first FIELD
+    STRUCT_NODE,    // token: name, a: first FIELD
+    FIELD_NODE,     // token: name, a: TYPE, b: value
+    DECORATED_NODE, // a: first DECORATOR, b: the FUN or CLASS
+    DECORATOR_NODE, // a: expression after the @
+    RETURN_NODE,    // a: value
+    EXPR_NODE,      // a: expression used as a statement
+    ASSIGN_NODE,    // op: EQL or a compound assignment, a: target, b: value
+    BINARY_NODE,    // op, a: left, b: right
+    UNARY_NODE,     // op, a: operand
+    CALL_NODE,      // a: callee, b: first argument
+    ATTR_NODE,      // token: name after the dot, a: object
+    INDEX_NODE,     // a: object, b: index
+    LIST_NODE,      // a: first item
+    NAME_NODE,      // token
+    NUMBER_NODE,    // token
+    STRING_NODE,    // token
+    CHAR_NODE,      // token
+    FSTRING_NODE,   // token: FSTART, a: first FTEXT or expression
+    FTEXT_NODE,     // token: FTEXT
+    NONE_NODE,      // token
+    TYPE_NODE,      // token: name, a: first type argument
+    ERROR_NODE,     // token: where parsing gave up
+};
+
+struct Node {
+    NODES kind;
+    TOKENS op;
+    uint32_t token; // index in Ast::tokens, the first token if no other
+    uint32_t a;
+    uint32_t b;
+    uint32_t c;
+    uint32_t next;
+};
+
+const int MAXINDENT = 32;
+
+// A parsed file. Nodes sit in an arena and point at each other and at the
+// tokens by index, so an Ast is a handful of allocations however big the
+// file is, and moving or dropping it is O(1) in the number of nodes.
+class Ast {
+  public:
+    Arena<Node> nodes;
+    std::vector<Token> tokens;
+    std::vector<uint32_t> names; // NAMES id of each token, or NO_NAME
+    uint32_t root = NO_NODE;
+    uint32_t add(NODES, uint32_t token, uint32_t a = NO_NODE,
+                 uint32_t b = NO_NODE, uint32_t c = NO_NODE);
+    const Node &operator[](uint32_t index) const;
+    Node &operator[](uint32_t index);
+    // One node per line, indented by depth up to MAXINDENT levels and with
+    // the depth written out past that
+    std::string toString() const;
+
+  private:
+    void dump(std::string &, uint32_t, int) const;
+};
@@ -0,0 +1,514 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "bytecode.hpp"
+#include "VERSION.hpp"
+#include "names.hpp"
+#include "object.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using std::string;
+using std::string_view;
+using std::to_string;
+using std::vector;
+
+// The image starts with a Header and then holds, in order, the functions,
+// the constants, all code, the locations for it, the defaults, the
+// attribute sites, the global names and the text of every name and
+// string. Records only use offsets into those arrays, so an image works
+// wherever it is mapped.
+namespace {
+const char MAGIC[8] = {'T', 'O', 'O', 'T', 'Y', 'B', 'C', '\0'};
+const uint32_t ENDIAN = 0x01020304; // reads differently on another machine
+
+struct Header {
+    char magic[8];
+    uint64_t hash; // of the source
+    uint32_t format;
+    uint32_t major;
+    uint32_t minor;
+    uint32_t micro;
+    uint32_t endian;
+    uint32_t functions;
+    uint32_t constants;
+    uint32_t globals;
+    uint32_t code; // instructions in all functions
+    uint32_t defaults;
+    uint32_t text; // bytes
+    uint32_t sites;
+};
+static_assert(sizeof(Header) == 64);
+
+struct Slice { // of the text
+    uint32_t offset;
+    uint32_t size;
+};
+
+struct FunctionRecord {
+    Slice name;
+    uint32_t params;
+    uint32_t registers;
+    uint32_t code; // first instruction
+    uint32_t size;
+    uint32_t defaults; // first default
+    uint32_t defaultCount;
+};
+
+struct ConstantRecord {
+    uint32_t type;
+    uint32_t size;  // of a string
+    uint64_t value; // the bits of the number, or where a string starts
+};
+
+// Where each array starts, checked against the size of the image
+struct Layout {
+    uint64_t functions, constants, code, locations, defaults, sites, globals,
+        text;
+    uint64_t end;
+    explicit Layout(const Header &header) {
+        this->functions = sizeof(Header);
+        this->constants = this->functions
+                          + uint64_t{header.functions} * sizeof(FunctionRecord);
+        this->code = this->constants
+                     + uint64_t{header.constants} * sizeof(ConstantRecord);
+        this->locations = this->code + uint64_t{header.code} * sizeof(uint32_t);
+        this->defaults = this->locations
+                         + uint64_t{header.code} * sizeof(Location);
+        this->sites = this->defaults
+                      + uint64_t{header.defaults} * sizeof(uint32_t);
+        this->globals = this->sites + uint64_t{header.sites} * sizeof(uint32_t);
+        this->text = this->globals + uint64_t{header.globals} * sizeof(Slice);
+        this->end = this->text + header.text;
+    }
+};
+} // namespace
+
+static const char *opcodes[] = {
+    "MOVE",    "LOADK",     "LOADNONE", "GETGLOBAL", "SETGLOBAL", "ADD",
+    "SUB",     "MUL",       "DIV",      "IDIV",      "MOD",       "POW",
+    "SHL",     "SHR",       "BAND",     "BOR",       "BXOR",      "EQ",
+    "NE",      "SEQ",       "SNE",      "LT",        "LE",        "GT",
+    "GE",      "NEG",       "POS",      "NOT",       "BNOT",      "JMP",
+    "JMPIF",   "JMPIFNOT",  "CALL",     "RETURN",    "CLASS",     "GETATTR",
+    "SETATTR", "GETMETHOD", "EXTRA",    "FORMAT",    "EQJMP",     "NEJMP",
+    "SEQJMP",  "SNEJMP",    "LTJMP",    "LEJMP",     "GTJMP",     "GEJMP",
+    "KADD",    "KSUB",      "KMUL",     "KMOD",
+};
+static_assert(sizeof(opcodes) / sizeof(*opcodes) == OPCODES::OPCODE_COUNT);
+
+const char *opcodeName(OPCODES op) {
+    return opcodes[int{op}];
+}
+
+string valueString(const Value &value, const Program &program) {
+    switch (value.type) {
+        case VALUE_TYPES::UNDEFINED_VALUE:
+            return "<undefined>";
+        case VALUE_TYPES::NONE_VALUE:
+            return "None";
+        case VALUE_TYPES::BOOL_VALUE:
+            return value.b ? "true" : "false";
+        case VALUE_TYPES::INT_VALUE:
+            return to_string(value.i);
+        case VALUE_TYPES::FLOAT_VALUE: {
+            char buffer[32];
+            snprintf(buffer, sizeof(buffer), "%.17g", value.f);
+            // the shortest form that reads back the same
+            for (int digits = 1; digits < 17; digits++) {
+                char shorter[32];
+                snprintf(shorter, sizeof(shorter), "%.*g", digits, value.f);
+                if (strtod(shorter, nullptr) == value.f) {
+                    snprintf(buffer, sizeof(buffer), "%s", shorter);
+                    break;
+                }
+            }
+            string text{buffer};
+            if (std::isfinite(value.f)
+                && text.find_first_of(".e") == string::npos) {
+                text += ".0";
+            }
+            return text;
+        }
+        case VALUE_TYPES::STRING_VALUE:
+            return string(*value.s);
+        case VALUE_TYPES::FUN_VALUE:
+            return "<fun " + string(program.functions[value.fun].name) + ">";
+        case VALUE_TYPES::NATIVE_VALUE:
+            return "<native fun>";
+        case VALUE_TYPES::OBJECT_VALUE:
+            return "<" + string(NAMES.name(value.object->shape->owner->name))
+                   + " object>";
+        case VALUE_TYPES::CLASS_VALUE: {
+            const Class &klass = *value.klass;
+            return string("<") + kindName(klass.kind) + " "
+                   + string(NAMES.name(klass.name)) + ">";
+        }
+    }
+    return "";
+}
+
+Program Program::link(const vector<Chunk> &chunks,
+                      const vector<Value> &constants,
+                      const vector<string> &globals,
+                      const vector<uint32_t> &sites, uint64_t hash) {
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.hash = hash;
+    header.format = IMAGE_FORMAT;
+    header.major = VERSION_MAJOR;
+    header.minor = VERSION_MINOR;
+    header.micro = VERSION_MICRO;
+    header.endian = ENDIAN;
+    header.functions = chunks.size();
+    header.constants = constants.size();
+    header.globals = globals.size();
+    header.sites = sites.size();
+    for (const Chunk &chunk: chunks) {
+        header.code += chunk.code.size();
+        header.defaults += chunk.defaults.size();
+        header.text += chunk.name.size();
+    }
+    for (const Value &value: constants) {
+        if (value.type == VALUE_TYPES::STRING_VALUE) {
+            header.text += value.s->size();
+        }
+    }
+    for (const string &name: globals) {
+        header.text += name.size();
+    }
+    Layout layout{header};
+    Program program;
+    program.owned.resize((layout.end + 7) / 8);
+    char *image = reinterpret_cast<char *>(program.owned.data());
+    std::memcpy(image, &header, sizeof(header));
+    uint32_t text = 0;
+    auto slice = [&](string_view bytes) {
+        if (!bytes.empty()) {
+            std::memcpy(image + layout.text + text, bytes.data(),
+                        bytes.size());
+        }
+        Slice written{text, uint32_t(bytes.size())};
+        text += bytes.size();
+        return written;
+    };
+    uint32_t code = 0;
+    uint32_t defaults = 0;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        const Chunk &chunk = chunks[i];
+        FunctionRecord record{slice(chunk.name),
+                              chunk.params,
+                              chunk.registers,
+                              code,
+                              uint32_t(chunk.code.size()),
+                              defaults,
+                              uint32_t(chunk.defaults.size())};
+        std::memcpy(image + layout.functions + i * sizeof(record), &record,
+                    sizeof(record));
+        std::memcpy(image + layout.code + code * sizeof(uint32_t),
+                    chunk.code.data(), chunk.code.size() * sizeof(uint32_t));
+        std::memcpy(image + layout.locations + code * sizeof(Location),
+                    chunk.locations.data(),
+                    chunk.locations.size() * sizeof(Location));
+        if (!chunk.defaults.empty()) {
+            std::memcpy(image + layout.defaults + defaults * sizeof(uint32_t),
+                        chunk.defaults.data(),
+                        chunk.defaults.size() * sizeof(uint32_t));
+        }
+        code += chunk.code.size();
+        defaults += chunk.defaults.size();
+    }
+    for (size_t i = 0; i < constants.size(); i++) {
+        const Value &value = constants[i];
+        ConstantRecord record{value.type, 0, 0};
+        switch (value.type) {
+            case VALUE_TYPES::BOOL_VALUE:
+                record.value = value.b;
+                break;
+            case VALUE_TYPES::INT_VALUE:
+            case VALUE_TYPES::FLOAT_VALUE:
+                std::memcpy(&record.value, &value.i, sizeof(record.value));
+                break;
+            case VALUE_TYPES::FUN_VALUE:
+                record.value = value.fun;
+                break;
+            case VALUE_TYPES::STRING_VALUE: {
+                Slice bytes = slice(*value.s);
+                record.size = bytes.size;
+                record.value = bytes.offset;
+                break;
+            }
+            default:
+                break;
+        }
+        std::memcpy(image + layout.constants + i * sizeof(record), &record,
+                    sizeof(record));
+    }
+    if (!sites.empty()) {
+        std::memcpy(image + layout.sites, sites.data(),
+                    sites.size() * sizeof(uint32_t));
+    }
+    for (size_t i = 0; i < globals.size(); i++) {
+        Slice name = slice(globals[i]);
+        std::memcpy(image + layout.globals + i * sizeof(name), &name,
+                    sizeof(name));
+    }
+    if (!program.attach(image, layout.end, hash)) {
+        throw std::logic_error("Linked an image that does not load");
+    }
+    return program;
+}
+
+bool Program::load(std::unique_ptr<SourceBuffer> file, uint64_t hash) {
+    if (!file->isOpen() || !this->attach(file->data(), file->size(), hash)) {
+        return false;
+    }
+    this->owned.clear();
+    this->file = std::move(file);
+    return true;
+}
+
+string_view Program::image() const {
+    return string_view{this->bytes, this->length};
+}
+
+// Points the tables at an image after checking everything they index is
+// inside it. The code itself is trusted like the source it came from.
+bool Program::attach(const char *image, size_t size, uint64_t hash) {
+    Header header;
+    if (size < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, image, sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0
+        || header.hash != hash || header.format != IMAGE_FORMAT
+        || header.major != VERSION_MAJOR || header.minor != VERSION_MINOR
+        || header.micro != VERSION_MICRO || header.endian != ENDIAN
+        || header.functions == 0) {
+        return false;
+    }
+    Layout layout{header};
+    if (layout.end != size) {
+        return false;
+    }
+    const char *text = image + layout.text;
+    auto inText = [&](Slice slice) {
+        return uint64_t{slice.offset} + slice.size <= header.text;
+    };
+    vector<Function> functions;
+    vector<Value> constants;
+    vector<string_view> globals;
+    std::deque<string_view> strings;
+    functions.reserve(header.functions);
+    for (uint32_t i = 0; i < header.functions; i++) {
+        FunctionRecord record;
+        std::memcpy(&record, image + layout.functions + i * sizeof(record),
+                    sizeof(record));
+        if (!inText(record.name) || record.size == 0
+            || uint64_t{record.code} + record.size > header.code
+            || uint64_t{record.defaults} + record.defaultCount > header.defaults
+            || record.defaultCount > record.params
+            || record.registers > MAXREGISTERS + 1
+            || record.params > record.registers) {
+            return false;
+        }
+        const uint32_t *defaults = reinterpret_cast<const uint32_t *>(
+            image + layout.defaults + record.defaults * sizeof(uint32_t));
+        for (uint32_t j = 0; j < record.defaultCount; j++) {
+            if (defaults[j] >= header.constants) {
+                return false;
+            }
+        }
+        Function function;
+        function.name = string_view{text + record.name.offset,
+                                    record.name.size};
+        function.params = record.params;
+        function.registers = record.registers;
+        function.size = record.size;
+        function.defaultCount = record.defaultCount;
+        function.code = reinterpret_cast<const uint32_t *>(
+            image + layout.code + record.code * sizeof(uint32_t));
+        function.locations = reinterpret_cast<const Location *>(
+            image + layout.locations + record.code * sizeof(Location));
+        function.defaults = defaults;
+        functions.push_back(function);
+    }
+    constants.reserve(header.constants);
+    for (uint32_t i = 0; i < header.constants; i++) {
+        ConstantRecord record;
+        std::memcpy(&record, image + layout.constants + i * sizeof(record),
+                    sizeof(record));
+        Value value = noneValue();
+        switch (record.type) {
+            case VALUE_TYPES::NONE_VALUE:
+                break;
+            case VALUE_TYPES::BOOL_VALUE:
+                value = boolValue(record.value != 0);
+                break;
+            case VALUE_TYPES::INT_VALUE:
+            case VALUE_TYPES::FLOAT_VALUE:
+                value.type = VALUE_TYPES(record.type);
+                std::memcpy(&value.i, &record.value, sizeof(value.i));
+                break;
+            case VALUE_TYPES::FUN_VALUE:
+                if (record.value >= header.functions) {
+                    return false;
+                }
+                value.type = VALUE_TYPES::FUN_VALUE;
+                value.fun = record.value;
+                break;
+            case VALUE_TYPES::STRING_VALUE:
+                if (record.value > header.text
+                    || !inText(Slice{uint32_t(record.value), record.size})) {
+                    return false;
+                }
+                strings.emplace_back(text + record.value, record.size);
+                value.type = VALUE_TYPES::STRING_VALUE;
+                value.s = &strings.back();
+                break;
+            default:
+                return false;
+        }
+        constants.push_back(value);
+    }
+    globals.reserve(header.globals);
+    for (uint32_t i = 0; i < header.globals; i++) {
+        Slice name;
+        std::memcpy(&name, image + layout.globals + i * sizeof(name),
+                    sizeof(name));
+        if (!inText(name)) {
+            return false;
+        }
+        globals.emplace_back(text + name.offset, name.size);
+    }
+    const uint32_t *names =
+        reinterpret_cast<const uint32_t *>(image + layout.sites);
+    vector<uint32_t> sites(names, names + header.sites);
+    for (uint32_t name: sites) {
+        if (name >= header.constants
+            || constants[name].type != VALUE_TYPES::STRING_VALUE) {
+            return false;
+        }
+    }
+    this->functions = std::move(functions);
+    this->constants = std::move(constants);
+    this->globals = std::move(globals);
+    this->sites = std::move(sites);
+    this->strings = std::move(strings);
+    this->bytes = image;
+    this->length = size;
+    return true;
+}
+
+string Program::toString() const {
+    string t;
+    for (const Function &function: this->functions) {
+        t += "fun " + string(function.name) + " ("
+             + to_string(function.params) + " params, "
+             + to_string(function.registers) + " registers)\n";
+        for (size_t pc = 0; pc < function.size; pc++) {
+            uint32_t i = function.code[pc];
+            OPCODES op = OPCODES(i & 0xFF);
+            uint32_t a = i >> 8 & 0xFF;
+            uint32_t b = i >> 16 & 0xFF;
+            uint32_t c = i >> 24;
+            uint32_t bx = i >> 16;
+            t += "  " + to_string(pc) + ": " + opcodeName(op);
+            switch (op) {
+                case OPCODES::LOADK_OP:
+                case OPCODES::KADD_OP:
+                case OPCODES::KSUB_OP:
+                case OPCODES::KMUL_OP:
+                case OPCODES::KMOD_OP:
+                    t += " r" + to_string(a) + " "
+                         + valueString(this->constants[bx], *this);
+                    break;
+                case OPCODES::GETGLOBAL_OP:
+                case OPCODES::SETGLOBAL_OP:
+                    t += " r" + to_string(a) + " " + string(this->globals[bx]);
+                    break;
+                case OPCODES::LOADNONE_OP:
+                case OPCODES::RETURN_OP:
+                    t += " r" + to_string(a);
+                    break;
+                case OPCODES::JMP_OP:
+                case OPCODES::JMPIF_OP:
+                case OPCODES::JMPIFNOT_OP:
+                    if (op != OPCODES::JMP_OP) {
+                        t += " r" + to_string(a);
+                    }
+                    t += " -> " + to_string(int64_t(pc) + 1 + int(bx)
+                                            - JUMP_BIAS);
+                    break;
+                case OPCODES::MOVE_OP:
+                case OPCODES::NEG_OP:
+                case OPCODES::POS_OP:
+                case OPCODES::NOT_OP:
+                case OPCODES::BNOT_OP:
+                    t += " r" + to_string(a) + " r" + to_string(b);
+                    break;
+                case OPCODES::CALL_OP:
+                    t += " r" + to_string(a) + " " + to_string(b) + " args";
+                    if (c) {
+                        t += " method";
+                    }
+                    break;
+                case OPCODES::CLASS_OP:
+                    t += " r" + to_string(a) + " " + to_string(b) + " members";
+                    break;
+                case OPCODES::FORMAT_OP:
+                    t += " r" + to_string(a) + " r" + to_string(b) + " "
+                         + to_string(c) + " parts";
+                    break;
+                case OPCODES::GETATTR_OP:
+                case OPCODES::SETATTR_OP:
+                case OPCODES::GETMETHOD_OP:
+                    t += " r" + to_string(a) + " r" + to_string(b);
+                    break;
+                case OPCODES::EXTRA_OP:
+                    t += " " + to_string(i >> 8) + " "
+                         + valueString(this->constants[this->sites[i >> 8]],
+                                       *this);
+                    break;
+                default:
+                    t += " r" + to_string(a) + " r" + to_string(b) + " r"
+                         + to_string(c);
+                    break;
+            }
+            t += '\n';
+        }
+    }
+    return t;
+}
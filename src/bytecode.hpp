@@ -0,0 +1,286 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "sources.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Instructions are 32 bits: the opcode in the low byte, then registers a,
+// b and c a byte each. bx is b and c read as one 16-bit operand, and jumps
+// store their offset from the next instruction as bx - JUMP_BIAS. The
+// attribute instructions are followed by an EXTRA word, whose other 24
+// bits (ax) hold their index in Program::sites.
+enum OPCODES : uint8_t
+{
+    MOVE_OP,      // R[a] = R[b]
+    LOADK_OP,     // R[a] = K[bx]
+    LOADNONE_OP,  // R[a] = None
+    GETGLOBAL_OP, // R[a] = G[bx]
+    SETGLOBAL_OP, // G[bx] = R[a]
+    // Ints never wrap. When the result of +, -, *, //, **, << or unary -
+    // does not fit in 64 bits, it is the float of the exact result instead.
+    // The compiler folds constants with the same code, fold() in vm.hpp.
+    ADD_OP,       // R[a] = R[b] + R[c], and so on to BXOR
+    SUB_OP,
+    MUL_OP,
+    DIV_OP,  // /, always a float
+    IDIV_OP, // //, rounds down
+    MOD_OP,  // %, takes the sign of the divisor
+    POW_OP,  // **
+    SHL_OP,  // <<
+    SHR_OP,  // >>
+    BAND_OP, // &
+    BOR_OP,  // |
+    BXOR_OP, // ^
+    EQ_OP,   // ==, numbers compare by value across int and float
+    NE_OP,   // !=
+    SEQ_OP,  // ===, also needs the same type
+    SNE_OP,  // !==
+    LT_OP,
+    LE_OP,
+    GT_OP,
+    GE_OP,
+    NEG_OP,      // R[a] = -R[b]
+    POS_OP,      // R[a] = +R[b]
+    NOT_OP,      // R[a] = !R[b]
+    BNOT_OP,     // R[a] = ~R[b]
+    JMP_OP,      // pc += sbx
+    JMPIF_OP,    // if R[a] is true, pc += sbx
+    JMPIFNOT_OP, // if R[a] is false, pc += sbx
+    CALL_OP,     // R[a] = R[a](R[a + 1], ..., R[a + b]), c set for methods
+    RETURN_OP,   // returns R[a]
+    // R[a] = a class named R[a] with base R[a + 1] (or None) and b members,
+    // each a name then a value in the registers after them. c is the
+    // CLASS_KINDS.
+    CLASS_OP,
+    GETATTR_OP,   // R[a] = R[b].name
+    SETATTR_OP,   // R[a].name = R[b]
+    GETMETHOD_OP, // R[a + 1] = R[b], R[a] = R[b].name
+    EXTRA_OP,     // never runs, the site of the instruction before it
+    FORMAT_OP,    // R[a] = R[b] .. R[b + c - 1] as strings, joined
+    // Superinstructions, only made by the peephole pass. Each replaces the
+    // first of a pair and runs both, the second stays in place for it to
+    // read, so a jump can still land on it.
+    EQJMP_OP,  // EQ, then the JMPIF or JMPIFNOT on its result
+    NEJMP_OP,  // NE, and so on to GE
+    SEQJMP_OP,
+    SNEJMP_OP,
+    LTJMP_OP,
+    LEJMP_OP,
+    GTJMP_OP,
+    GEJMP_OP,
+    KADD_OP, // LOADK, then the ADD after it
+    KSUB_OP, // LOADK, then SUB
+    KMUL_OP, // LOADK, then MUL
+    KMOD_OP, // LOADK, then MOD
+    OPCODE_COUNT,
+};
+
+const int JUMP_BIAS = 0x7FFF;
+const int MAXREGISTERS = 255;
+
+inline uint32_t encode(OPCODES op, uint32_t a, uint32_t b, uint32_t c) {
+    return op | a << 8 | b << 16 | c << 24;
+}
+
+inline uint32_t encodeBx(OPCODES op, uint32_t a, uint32_t bx) {
+    return op | a << 8 | bx << 16;
+}
+
+inline uint32_t encodeAx(OPCODES op, uint32_t ax) {
+    return op | ax << 8;
+}
+
+const uint32_t MAXSITES = 1 << 24;
+
+// What a CLASS instruction makes
+enum CLASS_KINDS : uint8_t
+{
+    CLASS_KIND,  // members are funs and attributes, calling it makes an object
+    STRUCT_KIND, // members are fields and their defaults
+    ENUM_KIND,   // members are attributes of the enum itself
+};
+
+enum VALUE_TYPES : uint8_t
+{
+    UNDEFINED_VALUE, // a global nothing has been assigned to yet
+    NONE_VALUE,
+    BOOL_VALUE,
+    INT_VALUE,
+    FLOAT_VALUE,
+    STRING_VALUE,
+    FUN_VALUE,    // index in Program::functions
+    NATIVE_VALUE, // index in NATIVES
+    OBJECT_VALUE, // made by calling a class or struct
+    CLASS_VALUE,  // a class, struct or enum, made by CLASS
+};
+
+struct Object;
+struct Class;
+
+struct Value {
+    VALUE_TYPES type;
+    union {
+        bool b;
+        int64_t i;
+        double f;
+        const std::string_view *s; // in a Program or the heap of a VM
+        uint32_t fun;
+        Object *object; // in the heap of a VM
+        Class *klass;   // owned by a VM
+    };
+};
+
+inline Value noneValue() {
+    Value value;
+    value.type = VALUE_TYPES::NONE_VALUE;
+    value.i = 0;
+    return value;
+}
+
+inline Value boolValue(bool b) {
+    Value value;
+    value.type = VALUE_TYPES::BOOL_VALUE;
+    value.i = 0;
+    value.b = b;
+    return value;
+}
+
+inline Value intValue(int64_t i) {
+    Value value;
+    value.type = VALUE_TYPES::INT_VALUE;
+    value.i = i;
+    return value;
+}
+
+inline Value floatValue(double f) {
+    Value value;
+    value.type = VALUE_TYPES::FLOAT_VALUE;
+    value.f = f;
+    return value;
+}
+
+inline bool truthy(const Value &value) {
+    switch (value.type) {
+        case VALUE_TYPES::BOOL_VALUE:
+            return value.b;
+        case VALUE_TYPES::INT_VALUE:
+            return value.i != 0;
+        case VALUE_TYPES::FLOAT_VALUE:
+            return value.f != 0;
+        case VALUE_TYPES::STRING_VALUE:
+            return !value.s->empty();
+        case VALUE_TYPES::FUN_VALUE:
+        case VALUE_TYPES::NATIVE_VALUE:
+        case VALUE_TYPES::OBJECT_VALUE:
+        case VALUE_TYPES::CLASS_VALUE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+struct Location {
+    uint32_t line;
+    uint32_t lpos;
+};
+
+// A function as the compiler builds it, before it is linked into a Program
+struct Chunk {
+    std::string name;
+    uint32_t params = 0;
+    uint32_t registers = 1;
+    std::vector<uint32_t> defaults; // constants for the last params
+    std::vector<uint32_t> code;
+    std::vector<Location> locations; // one per instruction
+};
+
+// A linked function, its arrays point into the image of its Program
+struct Function {
+    std::string_view name;
+    uint32_t params;
+    uint32_t registers;
+    uint32_t size; // instructions
+    uint32_t defaultCount;
+    const uint32_t *code;
+    const Location *locations;
+    const uint32_t *defaults;
+};
+
+// Bumped whenever the image layout or the instruction set changes, so
+// caches written by another build are recompiled
+const uint32_t IMAGE_FORMAT = 4;
+
+// Everything a VM needs to run a file, laid out as one flat image: a header
+// then arrays of plain records, with offsets in place of pointers. A cache
+// file holds the image byte for byte, so loading one is a single mmap and
+// a fix up of the function and constant tables, no code is copied.
+// Functions and constants point into the image, so a Program can be moved
+// but not copied.
+class Program {
+  public:
+    Program() = default;
+    Program(Program &&) = default;
+    Program &operator=(Program &&) = default;
+    Program(const Program &) = delete;
+    Program &operator=(const Program &) = delete;
+    // Lays the chunks out, hash identifies the source they came from
+    static Program link(const std::vector<Chunk> &,
+                        const std::vector<Value> &constants,
+                        const std::vector<std::string> &globals,
+                        const std::vector<uint32_t> &sites, uint64_t hash);
+    // Uses an image in place, false if it is damaged, was written by another
+    // build or for a source with another hash
+    bool load(std::unique_ptr<SourceBuffer>, uint64_t hash);
+    std::string_view image() const; // what a cache file holds
+    std::string filename;
+    std::vector<Function> functions; // 0 is the top level of the file
+    std::vector<Value> constants;
+    std::vector<std::string_view> globals; // names, indexed by slot
+    std::vector<uint32_t> sites; // the constant naming each attribute site
+    std::string toString() const;          // disassembly
+
+  private:
+    std::vector<uint64_t> owned; // the image when it was linked here
+    std::unique_ptr<SourceBuffer> file; // or when it was mapped
+    std::deque<std::string_view> strings;
+    const char *bytes = nullptr;
+    size_t length = 0;
+    bool attach(const char *, size_t, uint64_t);
+};
+
+const char *opcodeName(OPCODES);
+// how print shows a value
+std::string valueString(const Value &, const Program &);
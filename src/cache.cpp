@@ -0,0 +1,127 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "cache.hpp"
+#include "bytecode.hpp"
+#include "sources.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+using std::string;
+using std::string_view;
+
+static const uint64_t PRIME = 0x9E3779B97F4A7C15;
+
+static uint64_t rotate(uint64_t x, int bits) {
+    return x << bits | x >> (64 - bits);
+}
+
+static uint64_t finish(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCD;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53;
+    return h ^ h >> 33;
+}
+
+static uint64_t word(const char *bytes) {
+    uint64_t w;
+    std::memcpy(&w, bytes, sizeof(w));
+    return w;
+}
+
+// Four independent lanes of multiply and rotate over 32 bytes at a time,
+// so the multiplies overlap, then the tail a word and a byte at a time
+uint64_t sourceHash(string_view source) {
+    const char *bytes = source.data();
+    size_t size = source.size();
+    uint64_t lanes[4] = {PRIME, PRIME * 3, PRIME * 5, PRIME * 7};
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        for (int j = 0; j < 4; j++) {
+            lanes[j] = rotate((lanes[j] ^ word(bytes + i + j * 8)) * PRIME, 31);
+        }
+    }
+    uint64_t h = size;
+    for (uint64_t lane: lanes) {
+        h = rotate((h ^ finish(lane)) * PRIME, 27);
+    }
+    for (; i + 8 <= size; i += 8) {
+        h = rotate((h ^ word(bytes + i)) * PRIME, 27);
+    }
+    uint64_t tail = 0;
+    for (size_t shift = 0; i < size; i++, shift += 8) {
+        tail |= uint64_t{uint8_t(bytes[i])} << shift;
+    }
+    return finish(h ^ tail * PRIME);
+}
+
+string cachePath(const string &file) {
+    fs::path source{file};
+    return (source.parent_path() / CACHEDIR / source.filename()).string()
+           + ".ttc";
+}
+
+bool loadCache(const string &file, uint64_t hash, Program &program) {
+    auto cache = std::make_unique<SourceBuffer>(cachePath(file));
+    return program.load(std::move(cache), hash);
+}
+
+bool storeCache(const string &file, const Program &program) {
+    string path = cachePath(file);
+    std::error_code error;
+    fs::create_directories(fs::path{path}.parent_path(), error);
+    if (error) {
+        return false;
+    }
+    string temporary = path + "." + std::to_string(getpid());
+    {
+        std::ofstream out{temporary, std::ios::binary | std::ios::trunc};
+        string_view image = program.image();
+        out.write(image.data(), image.size());
+        if (!out.good()) {
+            out.close();
+            fs::remove(temporary, error);
+            return false;
+        }
+    }
+    fs::rename(temporary, path, error);
+    if (error) {
+        fs::remove(temporary, error);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,51 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "bytecode.hpp"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Compiled programs are kept in a CACHEDIR next to their sources, one file
+// per source. A cache file is the image of its Program, whose header says
+// which source hash and version of tooty it was compiled for, so a stale
+// one is simply compiled again and replaced.
+const char CACHEDIR[] = "__tootycache__";
+
+// Hash of the source bytes, cheap enough to take on every start
+uint64_t sourceHash(std::string_view);
+// Where the cache for a source file lives
+std::string cachePath(const std::string &);
+// Fills the Program from the cache for a file, false if there is none for
+// a source with that hash
+bool loadCache(const std::string &, uint64_t, Program &);
+// Writes the image of a Program as the cache for a file, atomically so a
+// concurrent run never maps half a file. False if it can't be written.
+bool storeCache(const std::string &, const Program &);
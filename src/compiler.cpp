@@ -0,0 +1,1100 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "compiler.hpp"
+
+#include "ast.hpp"
+#include "bytecode.hpp"
+#include "diagnostics.hpp"
+#include "names.hpp"
+#include "peephole.hpp"
+#include "sources.hpp"
+#include "tokens.hpp"
+#include "vm.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+using std::string;
+using std::string_view;
+using std::vector;
+
+static OPCODES binaryOp(TOKENS);
+
+Compiler::Compiler(const Ast &ast, OPT_LEVELS level)
+    : ast(ast), level(level), variable(ast.nodes.size(), false) {
+}
+
+Program Compiler::compile(const string &filename, uint64_t hash) {
+    this->chunks.emplace_back();
+    this->chunks[0].name = "<module>";
+    Scope scope;
+    scope.function = 0;
+    scope.global = true;
+    this->scope = &scope;
+    uint32_t first = NO_NODE;
+    uint32_t deep = this->tooDeep();
+    if (deep != NO_NODE) {
+        this->error(this->ast[deep].token,
+                    "Too deeply nested to compile, MAXNESTING is "
+                        + std::to_string(MAXNESTING));
+    }
+    else if (this->ast.root != NO_NODE) {
+        first = this->ast[this->ast.root].a;
+    }
+    this->statements(first);
+    uint32_t end = this->ast.tokens.empty() ? 0 : this->ast.tokens.size() - 1;
+    int none = this->temp(end);
+    this->emit(encode(OPCODES::LOADNONE_OP, none, 0, 0), end);
+    this->emit(encode(OPCODES::RETURN_OP, none, 0, 0), end);
+    this->scope = nullptr;
+    if (this->level >= OPT_LEVELS::O2_LEVEL) {
+        for (Chunk &chunk: this->chunks) {
+            peephole(chunk);
+        }
+    }
+    Program program =
+        Program::link(this->chunks, this->constants, this->names,
+                      this->sites, hash);
+    program.filename = filename;
+    return program;
+}
+
+string_view Compiler::text(uint32_t token) const {
+    return this->ast.tokens[token].value();
+}
+
+uint32_t Compiler::name(uint32_t token) const {
+    return this->ast.names[token];
+}
+
+void Compiler::error(uint32_t token, const string &message) {
+    if (this->ast.tokens.empty()) {
+        this->diagnostics.report(0, 0, message);
+        return;
+    }
+    const Token &at = this->ast.tokens[std::min<size_t>(
+        token, this->ast.tokens.size() - 1)];
+    this->diagnostics.report(at.file, at.pos, message);
+}
+
+uint32_t Compiler::emit(uint32_t instruction, uint32_t token) {
+    Chunk &function = this->chunks[this->scope->function];
+    Location location{0, 0};
+    if (token < this->ast.tokens.size()) {
+        const Token &at = this->ast.tokens[token];
+        SOURCES.position(at.file, at.pos - 1, location.line, location.lpos);
+    }
+    function.code.push_back(instruction);
+    function.locations.push_back(location);
+    return function.code.size() - 1;
+}
+
+// a jump to patch once its target is known
+uint32_t Compiler::jump(OPCODES op, int a, uint32_t token) {
+    return this->emit(encodeBx(op, a, JUMP_BIAS), token);
+}
+
+void Compiler::patch(uint32_t at, uint32_t target) {
+    Chunk &function = this->chunks[this->scope->function];
+    int64_t offset = int64_t(target) - int64_t(at) - 1;
+    if (offset < -JUMP_BIAS || offset > 0xFFFF - JUMP_BIAS) {
+        if (!this->full) {
+            this->error(this->scope->token,
+                        "Function too long, " + function.name
+                            + " jumps further than the bytecode allows");
+        }
+        this->full = true;
+        return;
+    }
+    uint32_t &instruction = function.code[at];
+    instruction = (instruction & 0xFFFF) | uint32_t(offset + JUMP_BIAS) << 16;
+}
+
+void Compiler::land(uint32_t at) {
+    this->patch(at, this->chunks[this->scope->function].code.size());
+}
+
+int Compiler::temp(uint32_t token) {
+    if (this->scope->top >= MAXREGISTERS) {
+        if (!this->full) {
+            this->error(token, "Too many registers needed, MAXREGISTERS is "
+                                   + std::to_string(MAXREGISTERS));
+        }
+        this->full = true;
+        return MAXREGISTERS - 1;
+    }
+    int r = this->scope->top++;
+    Chunk &function = this->chunks[this->scope->function];
+    function.registers =
+        std::max(function.registers, uint32_t(this->scope->top));
+    return r;
+}
+
+// the register of a local, or -1 if name is a global
+int Compiler::local(uint32_t name) const {
+    auto found = this->scope->locals.find(name);
+    return found == this->scope->locals.end() ? -1 : found->second;
+}
+
+uint32_t Compiler::global(uint32_t name) {
+    auto found = this->globals.find(name);
+    if (found != this->globals.end()) {
+        return found->second;
+    }
+    uint32_t slot = this->names.size();
+    // NO_NAME only comes from broken code the parser already reported
+    this->names.emplace_back(name == NO_NAME ? "" : NAMES.name(name));
+    this->globals.emplace(name, slot);
+    return slot;
+}
+
+uint32_t Compiler::constant(const Value &value, uint32_t token) {
+    if (value.type == VALUE_TYPES::INT_VALUE) {
+        auto found = this->ints.find(value.i);
+        if (found != this->ints.end()) {
+            return found->second;
+        }
+    }
+    if (this->constants.size() > 0xFFFF) {
+        if (!this->full) {
+            this->error(token, "Too many constants in one file");
+        }
+        this->full = true;
+        return 0;
+    }
+    uint32_t index = this->constants.size();
+    this->constants.push_back(value);
+    if (value.type == VALUE_TYPES::INT_VALUE) {
+        this->ints.emplace(value.i, index);
+    }
+    return index;
+}
+
+// The constant for a string, the same one each time it is asked for
+uint32_t Compiler::intern(string text, uint32_t token) {
+    auto known = this->strings.find(text);
+    if (known != this->strings.end()) {
+        return known->second;
+    }
+    this->texts.push_back(text);
+    this->views.push_back(this->texts.back());
+    Value value;
+    value.type = VALUE_TYPES::STRING_VALUE;
+    value.s = &this->views.back();
+    uint32_t found = this->constant(value, token);
+    this->strings.emplace(std::move(text), found);
+    return found;
+}
+
+// The value of a number token, negated first so that the most negative
+// number fits. False if it is too big.
+bool Compiler::number(uint32_t token, bool negative, int64_t &value) {
+    string digits = (negative ? "-" : "") + string(this->text(token));
+    value = 0;
+    const char *end = digits.data() + digits.size();
+    return std::from_chars(digits.data(), end, value).ec == std::errc();
+}
+
+// The text between the quotes with its escapes worked out, and for the
+// text of an f-string each {{ and }} made one brace. The lexer ends the
+// text at a quote or brace whatever comes before it, so a backslash in
+// front of one is left as it is.
+static string unescape(string_view raw, bool braces) {
+    string text;
+    for (size_t i = 0; i < raw.size(); i++) {
+        if (braces && (raw[i] == '{' || raw[i] == '}') && i + 1 < raw.size()
+            && raw[i + 1] == raw[i]) {
+            text += raw[i++];
+            continue;
+        }
+        if (raw[i] != '\\' || i + 1 == raw.size()
+            || (braces && (raw[i + 1] == '{' || raw[i + 1] == '}'))) {
+            text += raw[i];
+            continue;
+        }
+        switch (raw[++i]) {
+            case 'n':
+                text += '\n';
+                break;
+            case 't':
+                text += '\t';
+                break;
+            case 'r':
+                text += '\r';
+                break;
+            case '0':
+                text += '\0';
+                break;
+            default:
+                text += raw[i];
+                break;
+        }
+    }
+    return text;
+}
+
+// The constant for a literal, false if node is not one
+bool Compiler::literal(uint32_t index, uint32_t &found) {
+    const Node &node = this->ast[index];
+    int64_t value;
+    switch (node.kind) {
+        case NODES::NUMBER_NODE:
+            if (!this->number(node.token, false, value)) {
+                this->error(node.token, "Number too big");
+            }
+            found = this->constant(intValue(value), node.token);
+            return true;
+        case NODES::UNARY_NODE: {
+            const Node &operand = this->ast[node.a];
+            if (node.op != TOKENS::MINUS
+                || operand.kind != NODES::NUMBER_NODE) {
+                return false;
+            }
+            if (!this->number(operand.token, true, value)) {
+                this->error(operand.token, "Number too big");
+            }
+            found = this->constant(intValue(value), node.token);
+            return true;
+        }
+        case NODES::STRING_NODE:
+        case NODES::CHAR_NODE: {
+            string_view quoted = this->text(node.token);
+            found = this->intern(
+                unescape(quoted.substr(1, quoted.size() - 2), false),
+                node.token);
+            return true;
+        }
+        case NODES::NONE_NODE:
+            found = this->constant(noneValue(), node.token);
+            return true;
+        default:
+            return false;
+    }
+}
+
+// The value of an expression made only of numbers, None and operators,
+// false if it has to wait for run time. Strings are left alone, and so is
+// anything that would fail, so the error still comes from where it runs.
+bool Compiler::evaluate(uint32_t index, Value &value) {
+    if (this->variable[index]) {
+        return false;
+    }
+    const Node &node = this->ast[index];
+    int64_t i;
+    Value x;
+    Value y;
+    bool constant = false;
+    switch (node.kind) {
+        case NODES::NUMBER_NODE:
+            constant = this->number(node.token, false, i);
+            value = intValue(i);
+            break;
+        case NODES::NONE_NODE:
+            constant = true;
+            value = noneValue();
+            break;
+        case NODES::UNARY_NODE:
+            if (node.op == TOKENS::MINUS
+                && this->ast[node.a].kind == NODES::NUMBER_NODE) {
+                constant = this->number(this->ast[node.a].token, true, i);
+                value = intValue(i);
+                break;
+            }
+            constant =
+                this->evaluate(node.a, x)
+                && fold(node.op == TOKENS::MINUS  ? OPCODES::NEG_OP
+                        : node.op == TOKENS::PLUS ? OPCODES::POS_OP
+                        : node.op == TOKENS::EXCL ? OPCODES::NOT_OP
+                                                  : OPCODES::BNOT_OP,
+                        x, value);
+            break;
+        case NODES::BINARY_NODE:
+            if (!this->evaluate(node.a, x)) {
+                break;
+            }
+            if (node.op == TOKENS::DBAMPER || node.op == TOKENS::DBPIPE) {
+                // logical() drops a right one that is not constant
+                constant = this->evaluate(node.b, y);
+                value = truthy(x) == (node.op == TOKENS::DBPIPE) ? x : y;
+                break;
+            }
+            constant = this->evaluate(node.b, y)
+                       && fold(binaryOp(node.op), x, y, value);
+            break;
+        default:
+            break;
+    }
+    this->variable[index] = !constant;
+    return constant;
+}
+
+// Puts a constant in target, or a new register if it is -1
+int Compiler::load(const Value &value, uint32_t token, int target) {
+    int r = target < 0 ? this->temp(token) : target;
+    if (value.type == VALUE_TYPES::NONE_VALUE) {
+        this->emit(encode(OPCODES::LOADNONE_OP, r, 0, 0), token);
+    }
+    else {
+        this->emit(encodeBx(OPCODES::LOADK_OP, r,
+                            this->constant(value, token)),
+                   token);
+    }
+    return r;
+}
+
+// Throws away the code of the current fun from an instruction on
+void Compiler::drop(uint32_t from) {
+    Chunk &function = this->chunks[this->scope->function];
+    function.code.resize(from);
+    function.locations.resize(from);
+}
+
+// The statements of a BLOCK, or an else IF. A branch that can never run is
+// still compiled, so it reports the same errors, and then dropped.
+void Compiler::branch(uint32_t index, bool live) {
+    uint32_t start = this->chunks[this->scope->function].code.size();
+    if (this->ast[index].kind == NODES::IF_NODE) {
+        this->statement(index);
+    }
+    else {
+        this->statements(this->ast[index].a);
+    }
+    if (!live) {
+        this->drop(start);
+    }
+}
+
+// Every name a fun assigns to, nested funs have their own
+// The first node nested deeper than MAXNESTING, or NO_NODE. Looked for
+// with a stack of its own before anything recurses on the tree.
+uint32_t Compiler::tooDeep() const {
+    vector<std::pair<uint32_t, int>> pending;
+    if (this->ast.root != NO_NODE) {
+        pending.emplace_back(this->ast.root, 0);
+    }
+    while (!pending.empty()) {
+        auto [index, depth] = pending.back();
+        pending.pop_back();
+        if (depth > MAXNESTING) {
+            return index;
+        }
+        const Node &node = this->ast[index];
+        for (uint32_t child: {node.a, node.b, node.c}) {
+            for (; child != NO_NODE; child = this->ast[child].next) {
+                pending.emplace_back(child, depth + 1);
+            }
+        }
+    }
+    return NO_NODE;
+}
+
+void Compiler::collectLocals(uint32_t index) {
+    const Node &node = this->ast[index];
+    if (node.kind == NODES::FUN_NODE || node.kind == NODES::CLASS_NODE
+        || node.kind == NODES::ENUM_NODE || node.kind == NODES::STRUCT_NODE) {
+        uint32_t name = this->name(node.token);
+        if (this->local(name) < 0) {
+            this->scope->locals.emplace(name, this->temp(node.token));
+        }
+        return;
+    }
+    if (node.kind == NODES::ASSIGN_NODE
+        && this->ast[node.a].kind == NODES::NAME_NODE) {
+        uint32_t name = this->name(this->ast[node.a].token);
+        if (this->local(name) < 0) {
+            this->scope->locals.emplace(name, this->temp(node.token));
+        }
+    }
+    for (uint32_t child: {node.a, node.b, node.c}) {
+        for (; child != NO_NODE; child = this->ast[child].next) {
+            this->collectLocals(child);
+        }
+    }
+}
+
+uint32_t Compiler::function(uint32_t index) {
+    const Node &node = this->ast[index];
+    uint32_t id = this->chunks.size();
+    this->chunks.emplace_back();
+    this->chunks[id].name = string(this->text(node.token));
+    Scope scope;
+    scope.function = id;
+    scope.token = node.token;
+    Scope *outer = this->scope;
+    this->scope = &scope;
+
+    uint32_t params = 0;
+    vector<uint32_t> defaults;
+    for (uint32_t param = node.a; param != NO_NODE;
+         param = this->ast[param].next) {
+        const Node &p = this->ast[param];
+        if (p.kind != NODES::PARAM_NODE) {
+            continue;
+        }
+        uint32_t name = this->name(p.token);
+        if (this->local(name) >= 0) {
+            this->error(p.token, "Duplicate parameter '"
+                                     + string(this->text(p.token)) + "'");
+        }
+        scope.locals[name] = this->temp(p.token);
+        params++;
+        uint32_t k;
+        if (p.b == NO_NODE) {
+            if (!defaults.empty()) {
+                this->error(p.token, "Parameter '" + string(this->text(p.token))
+                                         + "' without a default follows one "
+                                           "with a default");
+            }
+        }
+        else if (this->literal(p.b, k)) {
+            defaults.push_back(k);
+        }
+        else {
+            this->error(this->ast[p.b].token,
+                        "Default values must be constants");
+        }
+    }
+    this->chunks[id].params = params;
+    this->chunks[id].defaults = std::move(defaults);
+    if (node.c != NO_NODE) {
+        uint32_t body = this->ast[node.c].a;
+        for (uint32_t s = body; s != NO_NODE; s = this->ast[s].next) {
+            this->collectLocals(s);
+        }
+        this->statements(body);
+    }
+    int none = this->temp(node.token);
+    this->emit(encode(OPCODES::LOADNONE_OP, none, 0, 0), node.token);
+    this->emit(encode(OPCODES::RETURN_OP, none, 0, 0), node.token);
+    this->scope = outer;
+    return id;
+}
+
+void Compiler::statements(uint32_t first) {
+    for (uint32_t s = first; s != NO_NODE; s = this->ast[s].next) {
+        int top = this->scope->top;
+        this->statement(s);
+        this->scope->top = top;
+    }
+}
+
+void Compiler::statement(uint32_t index) {
+    const Node &node = this->ast[index];
+    switch (node.kind) {
+        case NODES::EXPR_NODE:
+            this->expression(node.a, -1);
+            break;
+        case NODES::IF_NODE: {
+            Value known;
+            if (this->level >= OPT_LEVELS::O1_LEVEL
+                && this->evaluate(node.a, known)) {
+                this->branch(node.b, truthy(known));
+                if (node.c != NO_NODE) {
+                    this->branch(node.c, !truthy(known));
+                }
+                break;
+            }
+            int condition = this->expression(node.a, -1);
+            uint32_t skip =
+                this->jump(OPCODES::JMPIFNOT_OP, condition, node.token);
+            this->statements(this->ast[node.b].a);
+            if (node.c == NO_NODE) {
+                this->land(skip);
+                break;
+            }
+            uint32_t end = this->jump(OPCODES::JMP_OP, 0, node.token);
+            this->land(skip);
+            if (this->ast[node.c].kind == NODES::IF_NODE) {
+                this->statement(node.c);
+            }
+            else {
+                this->statements(this->ast[node.c].a);
+            }
+            this->land(end);
+            break;
+        }
+        case NODES::WHILE_NODE: {
+            uint32_t start =
+                this->chunks[this->scope->function].code.size();
+            Value known;
+            if (this->level >= OPT_LEVELS::O1_LEVEL
+                && this->evaluate(node.a, known)) {
+                this->branch(node.b, truthy(known));
+                if (truthy(known)) { // loops forever, or until a return
+                    this->patch(this->jump(OPCODES::JMP_OP, 0, node.token),
+                                start);
+                }
+                break;
+            }
+            if (this->level >= OPT_LEVELS::O2_LEVEL) {
+                // the test goes at the bottom, so each time round takes
+                // one jump instead of two
+                uint32_t test = this->jump(OPCODES::JMP_OP, 0, node.token);
+                uint32_t body =
+                    this->chunks[this->scope->function].code.size();
+                this->statements(this->ast[node.b].a);
+                this->land(test);
+                int condition = this->expression(node.a, -1);
+                this->patch(this->jump(OPCODES::JMPIF_OP, condition,
+                                       node.token),
+                            body);
+                break;
+            }
+            int condition = this->expression(node.a, -1);
+            uint32_t exit =
+                this->jump(OPCODES::JMPIFNOT_OP, condition, node.token);
+            this->statements(this->ast[node.b].a);
+            this->patch(this->jump(OPCODES::JMP_OP, 0, node.token), start);
+            this->land(exit);
+            break;
+        }
+        case NODES::FUN_NODE: {
+            Value value;
+            value.type = VALUE_TYPES::FUN_VALUE;
+            value.i = 0;
+            value.fun = this->function(index);
+            uint32_t k = this->constant(value, node.token);
+            int r = this->local(this->name(node.token));
+            if (r < 0) {
+                r = this->temp(node.token);
+            }
+            this->emit(encodeBx(OPCODES::LOADK_OP, r, k), node.token);
+            this->store(this->name(node.token), r, node.token);
+            break;
+        }
+        case NODES::RETURN_NODE: {
+            int value;
+            if (node.a == NO_NODE) {
+                value = this->temp(node.token);
+                this->emit(encode(OPCODES::LOADNONE_OP, value, 0, 0),
+                           node.token);
+            }
+            else {
+                value = this->expression(node.a, -1);
+            }
+            this->emit(encode(OPCODES::RETURN_OP, value, 0, 0), node.token);
+            break;
+        }
+        case NODES::CLASS_NODE:
+        case NODES::ENUM_NODE:
+        case NODES::STRUCT_NODE:
+            this->declare(index);
+            break;
+        case NODES::DECORATED_NODE:
+            this->error(node.token,
+                        "The compiler does not support decorators yet");
+            break;
+        default: // broken statements were reported by the parser
+            break;
+    }
+}
+
+// Writes r to a name, a global or a local's own register
+void Compiler::store(uint32_t name, int r, uint32_t token) {
+    int target = this->local(name);
+    if (target < 0) {
+        this->emit(encodeBx(OPCODES::SETGLOBAL_OP, r, this->global(name)),
+                   token);
+    }
+    else if (target != r) {
+        this->emit(encode(OPCODES::MOVE_OP, target, r, 0), token);
+    }
+}
+
+// A CLASS instruction for a class, enum or struct, then stores it under
+// its name. The name and base go first, then each member's name and
+// value. Enum values left out count on from the one before.
+void Compiler::declare(uint32_t index) {
+    const Node &node = this->ast[index];
+    CLASS_KINDS kind = node.kind == NODES::ENUM_NODE ? CLASS_KINDS::ENUM_KIND
+                       : node.kind == NODES::STRUCT_NODE
+                           ? CLASS_KINDS::STRUCT_KIND
+                           : CLASS_KINDS::CLASS_KIND;
+    int base = this->temp(node.token);
+    this->emit(encodeBx(OPCODES::LOADK_OP, base,
+                        this->intern(string(this->text(node.token)),
+                                     node.token)),
+               node.token);
+    int parent = this->temp(node.token);
+    if (kind == CLASS_KINDS::CLASS_KIND && node.a != NO_NODE) {
+        this->expression(node.a, parent);
+        if (this->ast[node.a].next != NO_NODE) {
+            this->error(this->ast[this->ast[node.a].next].token,
+                        "Only one base class is supported");
+        }
+    }
+    else {
+        this->emit(encode(OPCODES::LOADNONE_OP, parent, 0, 0), node.token);
+    }
+    std::unordered_set<uint32_t> seen;
+    uint32_t count = 0;
+    int64_t next = 0; // the next enum value
+    bool counting = true;
+    // puts the name of a member and hands out the register for its value,
+    // the only one above it that stays taken
+    auto member = [&](uint32_t token) {
+        if (!seen.insert(this->name(token)).second) {
+            this->error(token, "Duplicate member '"
+                                   + string(this->text(token)) + "'");
+        }
+        int r = this->temp(token);
+        this->emit(encodeBx(OPCODES::LOADK_OP, r,
+                            this->intern(string(this->text(token)), token)),
+                   token);
+        count++;
+        int value = this->temp(token);
+        this->scope->top = value + 1;
+        return value;
+    };
+    uint32_t first = node.kind == NODES::CLASS_NODE ? NO_NODE : node.a;
+    if (node.kind == NODES::CLASS_NODE && node.b != NO_NODE
+        && this->ast[node.b].kind == NODES::BLOCK_NODE) {
+        first = this->ast[node.b].a;
+    }
+    for (uint32_t s = first; s != NO_NODE; s = this->ast[s].next) {
+        const Node &statement = this->ast[s];
+        const Node &field = statement.kind == NODES::EXPR_NODE
+                                ? this->ast[statement.a]
+                                : statement;
+        if (field.kind == NODES::FUN_NODE) {
+            Value value;
+            value.type = VALUE_TYPES::FUN_VALUE;
+            value.i = 0;
+            value.fun = this->function(s);
+            this->load(value, field.token, member(field.token));
+        }
+        else if (field.kind == NODES::ASSIGN_NODE
+                 && field.op == TOKENS::EQL
+                 && this->ast[field.a].kind == NODES::NAME_NODE) {
+            int r = member(this->ast[field.a].token);
+            this->expression(field.b, r);
+            this->scope->top = r + 1;
+        }
+        else if (field.kind == NODES::FIELD_NODE) {
+            int r = member(field.token);
+            Value known;
+            if (field.b != NO_NODE) {
+                this->expression(field.b, r);
+                this->scope->top = r + 1;
+                counting = this->evaluate(field.b, known)
+                           && known.type == VALUE_TYPES::INT_VALUE
+                           && known.i < INT64_MAX;
+                next = counting ? known.i + 1 : 0;
+            }
+            else if (kind == CLASS_KINDS::STRUCT_KIND) {
+                this->emit(encode(OPCODES::LOADNONE_OP, r, 0, 0),
+                           field.token);
+            }
+            else if (counting) {
+                this->load(intValue(next++), field.token, r);
+            }
+            else {
+                this->error(field.token,
+                            "Enum value '" + string(this->text(field.token))
+                                + "' needs a value after one that is not "
+                                  "an int constant");
+            }
+        }
+        else if (field.kind == NODES::DECORATED_NODE) {
+            this->error(field.token,
+                        "The compiler does not support decorators yet");
+        }
+        else if (field.kind != NODES::ERROR_NODE) {
+            this->error(field.token, "A class can only hold funs and "
+                                     "assignments to names");
+        }
+    }
+    if (count > 0xFF) {
+        this->error(node.token, "Too many members");
+    }
+    this->emit(encode(OPCODES::CLASS_OP, base, count & 0xFF, kind),
+               node.token);
+    this->store(this->name(node.token), base, node.token);
+}
+
+// An attribute instruction and the EXTRA word with a new site for it
+void Compiler::attribute(OPCODES op, int a, int b, uint32_t token) {
+    if (this->sites.size() >= MAXSITES) {
+        if (!this->full) {
+            this->error(token, "Too many attribute accesses in one file");
+        }
+        this->full = true;
+    }
+    uint32_t name = this->intern(string(this->text(token)), token);
+    this->emit(encode(op, a, b, 0), token);
+    this->emit(encodeAx(OPCODES::EXTRA_OP, this->sites.size() & 0xFFFFFF),
+               token);
+    this->sites.push_back(name);
+}
+
+static OPCODES binaryOp(TOKENS type) {
+    switch (type) {
+        case TOKENS::PLUS:
+        case TOKENS::PLSEQL:
+            return OPCODES::ADD_OP;
+        case TOKENS::MINUS:
+        case TOKENS::MINUSEQL:
+            return OPCODES::SUB_OP;
+        case TOKENS::STAR:
+        case TOKENS::STAREQL:
+            return OPCODES::MUL_OP;
+        case TOKENS::SLASH:
+        case TOKENS::SLASHEQL:
+            return OPCODES::DIV_OP;
+        case TOKENS::DBSLASH:
+        case TOKENS::DBSLASHEQL:
+            return OPCODES::IDIV_OP;
+        case TOKENS::PERC:
+        case TOKENS::PERCEQL:
+            return OPCODES::MOD_OP;
+        case TOKENS::DBSTAR:
+        case TOKENS::DBSTAREQL:
+            return OPCODES::POW_OP;
+        case TOKENS::DBLESS:
+        case TOKENS::DBLESSEQL:
+            return OPCODES::SHL_OP;
+        case TOKENS::DBGREAT:
+        case TOKENS::DBGREATEQL:
+            return OPCODES::SHR_OP;
+        case TOKENS::AMPER:
+            return OPCODES::BAND_OP;
+        case TOKENS::PIPE:
+        case TOKENS::PIPEQL:
+            return OPCODES::BOR_OP;
+        case TOKENS::CARRET:
+            return OPCODES::BXOR_OP;
+        case TOKENS::DBEQL:
+            return OPCODES::EQ_OP;
+        case TOKENS::NTEQUL:
+            return OPCODES::NE_OP;
+        case TOKENS::TRPEQL:
+            return OPCODES::SEQ_OP;
+        case TOKENS::NTDBEQL:
+            return OPCODES::SNE_OP;
+        case TOKENS::LESS:
+            return OPCODES::LT_OP;
+        case TOKENS::LESSEQL:
+            return OPCODES::LE_OP;
+        case TOKENS::GREAT:
+            return OPCODES::GT_OP;
+        case TOKENS::GREATEQL:
+        default:
+            return OPCODES::GE_OP;
+    }
+}
+
+// Compiles an expression into target, or with a target of -1 into
+// whichever register is handiest, and returns the register used. Temporary
+// registers are handed out like a stack, so a result reuses the first one
+// its operands took.
+int Compiler::expression(uint32_t index, int target) {
+    const Node &node = this->ast[index];
+    int mark = this->scope->top;
+    int r;
+    uint32_t k;
+    Value known;
+    if ((node.kind == NODES::BINARY_NODE || node.kind == NODES::UNARY_NODE)
+        && this->level >= OPT_LEVELS::O1_LEVEL
+        && this->evaluate(index, known)) {
+        return this->load(known, node.token, target);
+    }
+    switch (node.kind) {
+        case NODES::NAME_NODE: {
+            uint32_t name = this->name(node.token);
+            int l = this->local(name);
+            if (l >= 0 && target < 0) {
+                return l;
+            }
+            r = target < 0 ? this->temp(node.token) : target;
+            if (l >= 0) {
+                if (l != r) {
+                    this->emit(encode(OPCODES::MOVE_OP, r, l, 0), node.token);
+                }
+            }
+            else {
+                uint32_t index = this->global(name);
+                this->emit(encodeBx(OPCODES::GETGLOBAL_OP, r, index),
+                           node.token);
+            }
+            return r;
+        }
+        case NODES::NONE_NODE:
+            r = target < 0 ? this->temp(node.token) : target;
+            this->emit(encode(OPCODES::LOADNONE_OP, r, 0, 0), node.token);
+            return r;
+        case NODES::BINARY_NODE: {
+            if (node.op == TOKENS::DBAMPER || node.op == TOKENS::DBPIPE) {
+                return this->logical(index, target);
+            }
+            int left = this->expression(node.a, -1);
+            int right = this->expression(node.b, -1);
+            this->scope->top = mark;
+            r = target < 0 ? this->temp(node.token) : target;
+            this->emit(encode(binaryOp(node.op), r, left, right), node.token);
+            return r;
+        }
+        case NODES::UNARY_NODE: {
+            if (this->literal(index, k)) {
+                r = target < 0 ? this->temp(node.token) : target;
+                this->emit(encodeBx(OPCODES::LOADK_OP, r, k), node.token);
+                return r;
+            }
+            int operand = this->expression(node.a, -1);
+            this->scope->top = mark;
+            r = target < 0 ? this->temp(node.token) : target;
+            OPCODES op = node.op == TOKENS::MINUS  ? OPCODES::NEG_OP
+                         : node.op == TOKENS::PLUS ? OPCODES::POS_OP
+                         : node.op == TOKENS::EXCL ? OPCODES::NOT_OP
+                                                   : OPCODES::BNOT_OP;
+            this->emit(encode(op, r, operand, 0), node.token);
+            return r;
+        }
+        case NODES::ATTR_NODE: {
+            int object = this->expression(node.a, -1);
+            this->scope->top = mark;
+            r = target < 0 ? this->temp(node.token) : target;
+            this->attribute(OPCODES::GETATTR_OP, r, object, node.token);
+            return r;
+        }
+        case NODES::ASSIGN_NODE:
+            return this->assign(index, target);
+        case NODES::CALL_NODE:
+            return this->call(index, target);
+        case NODES::FSTRING_NODE:
+            return this->format(index, target);
+        case NODES::ERROR_NODE: // reported by the lexer or parser
+            return target < 0 ? this->temp(node.token) : target;
+        default:
+            if (this->literal(index, k)) {
+                r = target < 0 ? this->temp(node.token) : target;
+                this->emit(encodeBx(OPCODES::LOADK_OP, r, k), node.token);
+                return r;
+            }
+            this->error(node.token,
+                        "The compiler does not support lists or indexing "
+                        "yet");
+            return target < 0 ? this->temp(node.token) : target;
+    }
+}
+
+// An f-string, its text and expressions already apart in the tree, put in
+// consecutive registers for one FORMAT to join. Text alone is a constant.
+int Compiler::format(uint32_t index, int target) {
+    const Node &node = this->ast[index];
+    int mark = this->scope->top;
+    bool constant = true;
+    string joined;
+    for (uint32_t part = node.a; part != NO_NODE;
+         part = this->ast[part].next) {
+        const Node &p = this->ast[part];
+        if (p.kind != NODES::FTEXT_NODE) {
+            constant = false;
+            break;
+        }
+        joined += unescape(this->text(p.token), true);
+    }
+    if (constant) {
+        uint32_t k = this->intern(std::move(joined), node.token);
+        int r = target < 0 ? this->temp(node.token) : target;
+        this->emit(encodeBx(OPCODES::LOADK_OP, r, k), node.token);
+        return r;
+    }
+    int first = this->scope->top;
+    int count = 0;
+    for (uint32_t part = node.a; part != NO_NODE;
+         part = this->ast[part].next) {
+        const Node &p = this->ast[part];
+        int r = this->temp(p.token);
+        if (p.kind == NODES::FTEXT_NODE) {
+            uint32_t k =
+                this->intern(unescape(this->text(p.token), true), p.token);
+            this->emit(encodeBx(OPCODES::LOADK_OP, r, k), p.token);
+        }
+        else {
+            this->expression(part, r);
+        }
+        this->scope->top = r + 1;
+        count++;
+    }
+    if (count > 0xFF) {
+        this->error(node.token, "Too many parts in an f-string");
+    }
+    this->scope->top = mark;
+    int r = target < 0 ? this->temp(node.token) : target;
+    this->emit(encode(OPCODES::FORMAT_OP, r, first, count & 0xFF),
+               node.token);
+    return r;
+}
+
+// && and || give whichever operand decided them, without looking at the
+// right one if the left one is enough
+int Compiler::logical(uint32_t index, int target) {
+    const Node &node = this->ast[index];
+    Value known;
+    if (this->level >= OPT_LEVELS::O1_LEVEL
+        && this->evaluate(node.a, known)) {
+        // the left one decides it, or it is just the right one
+        int top = this->scope->top;
+        uint32_t start = this->chunks[this->scope->function].code.size();
+        int r = this->expression(node.b, target);
+        if (truthy(known) != (node.op == TOKENS::DBPIPE)) {
+            return r;
+        }
+        this->drop(start); // compiled for its errors
+        this->scope->top = top;
+        return this->load(known, node.token, target);
+    }
+    // a local as the target could be read by the right operand after the
+    // left one was written over it
+    int r = target < 0 || target < int(this->scope->locals.size())
+                ? this->temp(node.token)
+                : target;
+    this->expression(node.a, r);
+    uint32_t skip = this->jump(node.op == TOKENS::DBAMPER ? OPCODES::JMPIFNOT_OP
+                                                          : OPCODES::JMPIF_OP,
+                               r, node.token);
+    int top = this->scope->top;
+    this->expression(node.b, r);
+    this->scope->top = top;
+    this->land(skip);
+    if (target >= 0 && target != r) {
+        this->emit(encode(OPCODES::MOVE_OP, target, r, 0), node.token);
+        return target;
+    }
+    return r;
+}
+
+int Compiler::assign(uint32_t index, int target) {
+    const Node &node = this->ast[index];
+    const Node &name = this->ast[node.a];
+    if (name.kind == NODES::ATTR_NODE) {
+        // the object is read once, then its field and the value
+        int mark = this->scope->top;
+        int object = this->expression(name.a, -1);
+        int r;
+        if (node.op == TOKENS::EQL || node.op == TOKENS::COLONEQL) {
+            r = this->expression(node.b, -1);
+        }
+        else {
+            r = this->temp(node.token);
+            this->attribute(OPCODES::GETATTR_OP, r, object, name.token);
+            int value = this->expression(node.b, -1);
+            this->emit(encode(binaryOp(node.op), r, r, value), node.token);
+        }
+        this->attribute(OPCODES::SETATTR_OP, object, r, name.token);
+        this->scope->top = r >= mark ? r + 1 : mark;
+        if (target >= 0 && target != r) {
+            this->emit(encode(OPCODES::MOVE_OP, target, r, 0), node.token);
+            this->scope->top = mark;
+            return target;
+        }
+        return r;
+    }
+    if (name.kind != NODES::NAME_NODE) {
+        this->error(node.token, "Only names and attributes can be assigned "
+                                "to for now");
+        return target < 0 ? this->temp(node.token) : target;
+    }
+    uint32_t id = this->name(name.token);
+    int l = this->local(id);
+    int r;
+    if (node.op == TOKENS::EQL || node.op == TOKENS::COLONEQL) {
+        r = this->expression(node.b, l >= 0 ? l : -1);
+    }
+    else {
+        // x op= y is x = x op y, with x read only once
+        int mark = this->scope->top;
+        r = l >= 0 ? l : this->temp(node.token);
+        if (l < 0) {
+            this->emit(encodeBx(OPCODES::GETGLOBAL_OP, r, this->global(id)),
+                       node.token);
+        }
+        int value = this->expression(node.b, -1);
+        this->emit(encode(binaryOp(node.op), r, r, value), node.token);
+        this->scope->top = l >= 0 ? mark : r + 1;
+    }
+    if (l < 0) {
+        this->emit(encodeBx(OPCODES::SETGLOBAL_OP, r, this->global(id)),
+                   node.token);
+    }
+    if (target >= 0 && target != r) {
+        this->emit(encode(OPCODES::MOVE_OP, target, r, 0), node.token);
+        return target;
+    }
+    return r;
+}
+
+// The callee and its arguments go in consecutive registers from a fresh
+// one, which then holds the result
+int Compiler::call(uint32_t index, int target) {
+    const Node &node = this->ast[index];
+    // a fresh temporary as the target can be the base itself
+    int base = target >= int(this->scope->locals.size())
+                       && target == this->scope->top - 1
+                   ? target
+                   : this->temp(node.token);
+    const Node &callee = this->ast[node.a];
+    int count = 0;
+    if (callee.kind == NODES::ATTR_NODE) {
+        // a method of an object gets the object as its first argument
+        this->scope->top = base + 1;
+        int object = this->temp(callee.token);
+        this->expression(callee.a, object);
+        this->attribute(OPCODES::GETMETHOD_OP, base, object, callee.token);
+        this->scope->top = object + 1;
+        count++;
+    }
+    else {
+        this->expression(node.a, base);
+        this->scope->top = base + 1;
+    }
+    for (uint32_t arg = node.b; arg != NO_NODE; arg = this->ast[arg].next) {
+        int r = this->temp(this->ast[arg].token);
+        this->expression(arg, r);
+        this->scope->top = r + 1;
+        count++;
+    }
+    if (count > 0xFF) {
+        this->error(node.token, "Too many arguments");
+    }
+    this->emit(encode(OPCODES::CALL_OP, base, count & 0xFF,
+                      callee.kind == NODES::ATTR_NODE),
+               node.token);
+    this->scope->top = base + 1;
+    if (target >= 0 && target != base) {
+        this->emit(encode(OPCODES::MOVE_OP, target, base, 0), node.token);
+        return target;
+    }
+    return base;
+}
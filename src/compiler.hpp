@@ -0,0 +1,118 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "ast.hpp"
+#include "bytecode.hpp"
+#include "diagnostics.hpp"
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Turns an Ast into register bytecode. Names assigned at the top level
+// are globals, names assigned in a fun are its registers and anything
+// else is looked up as a global. Constructs the VM has no instructions for
+// yet (lists, indexing, decorators...) are reported to diagnostics.
+// Deepest the tree may nest, as the compiler recurses on it. A chain of
+// operators, attributes or calls nests a level per link without the parser
+// recursing, so MAXDEPTH does not bound it.
+const int MAXNESTING = 10000;
+
+// What -O0, -O1 and -O2 turn on, each level adds to the one before
+enum OPT_LEVELS : uint8_t
+{
+    O0_LEVEL, // the code as written
+    O1_LEVEL, // folds constants and drops branches that can never run
+    O2_LEVEL, // tests loops at the bottom, peephole and superinstructions
+};
+
+class Compiler {
+  public:
+    explicit Compiler(const Ast &, OPT_LEVELS = OPT_LEVELS::O2_LEVEL);
+    // Only once, takes the filename and the hash of its source
+    Program compile(const std::string &, uint64_t = 0);
+    Diagnostics diagnostics;
+
+  private:
+    struct Scope {
+        uint32_t function; // index in Program::functions
+        uint32_t token = 0; // where the fun is declared
+        std::unordered_map<uint32_t, int> locals; // by NAMES id
+        int top = 0; // first free register
+        bool global = false;
+    };
+    bool full = false; // ran out of registers or constants
+    const Ast &ast;
+    OPT_LEVELS level;
+    std::vector<bool> variable; // nodes known not to be constant
+    std::vector<Chunk> chunks; // 0 is the top level of the file
+    std::vector<Value> constants;
+    std::vector<std::string> names; // of the globals, indexed by slot
+    std::deque<std::string> texts;  // of the string constants
+    std::deque<std::string_view> views;
+    std::vector<uint32_t> sites; // the name of each attribute site
+    Scope *scope = nullptr;
+    std::unordered_map<uint32_t, uint32_t> globals; // NAMES id to slot
+    std::unordered_map<int64_t, uint32_t> ints;
+    std::unordered_map<std::string, uint32_t> strings;
+    std::string_view text(uint32_t) const;
+    uint32_t name(uint32_t) const; // NAMES id of a token
+    void error(uint32_t, const std::string &);
+    uint32_t emit(uint32_t, uint32_t);
+    uint32_t jump(OPCODES, int, uint32_t);
+    void patch(uint32_t, uint32_t);
+    void land(uint32_t);
+    int temp(uint32_t);
+    int local(uint32_t) const;
+    uint32_t global(uint32_t);
+    uint32_t constant(const Value &, uint32_t);
+    uint32_t intern(std::string, uint32_t);
+    bool number(uint32_t, bool, int64_t &);
+    bool literal(uint32_t, uint32_t &);
+    bool evaluate(uint32_t, Value &);
+    uint32_t tooDeep() const;
+    int load(const Value &, uint32_t, int);
+    void drop(uint32_t);
+    void branch(uint32_t, bool);
+    void collectLocals(uint32_t);
+    uint32_t function(uint32_t);
+    void statements(uint32_t);
+    void statement(uint32_t);
+    void store(uint32_t, int, uint32_t);
+    void declare(uint32_t);
+    void attribute(OPCODES, int, int, uint32_t);
+    int expression(uint32_t, int);
+    int logical(uint32_t, int);
+    int assign(uint32_t, int);
+    int call(uint32_t, int);
+    int format(uint32_t, int);
+};
@@ -0,0 +1,131 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "dfa.hpp"
+
+#include <cstddef>
+
+enum CHAR_CLASSES
+{
+    OTHER,
+    LETTER,  // a-zA-Z_
+    DIGIT,   // 0-9
+    DQUOTE,  // "
+    SQUOTE,  // '
+    HASH,    // #
+    SLASH,   // /
+    STAR,    // *
+    NEWLINE, // \n \r
+    CHAR_CLASS_COUNT
+};
+
+struct CharClassTable {
+    unsigned char classes[256];
+    constexpr CharClassTable() : classes() {
+        for (int c = 'a'; c <= 'z'; c++) {
+            classes[c] = LETTER;
+        }
+        for (int c = 'A'; c <= 'Z'; c++) {
+            classes[c] = LETTER;
+        }
+        for (int c = '0'; c <= '9'; c++) {
+            classes[c] = DIGIT;
+        }
+        classes[int{'_'}] = LETTER;
+        classes[int{'"'}] = DQUOTE;
+        classes[int{'\''}] = SQUOTE;
+        classes[int{'#'}] = HASH;
+        classes[int{'/'}] = SLASH;
+        classes[int{'*'}] = STAR;
+        classes[int{'\n'}] = NEWLINE;
+        classes[int{'\r'}] = NEWLINE;
+    }
+};
+
+static constexpr CharClassTable CHAR_CLASS{};
+
+// clang-format off
+static constexpr unsigned char TRANSITIONS[DFA_STATE_COUNT][CHAR_CLASS_COUNT] = {
+//    OTHER           LETTER          DIGIT           DQUOTE          SQUOTE          HASH            SLASH           STAR            NEWLINE
+    { DEAD,           DEAD,           DEAD,           DEAD,           DEAD,           DEAD,           DEAD,           DEAD,           DEAD           }, // DEAD
+    { DEAD,           IDENT_BODY,     DEAD,           DEAD,           DEAD,           DEAD,           DEAD,           DEAD,           DEAD           }, // IDENT_START
+    { DEAD,           IDENT_BODY,     IDENT_BODY,     DEAD,           DEAD,           DEAD,           DEAD,           DEAD,           DEAD           }, // IDENT_BODY
+    { DEAD,           DEAD,           NUMBER_BODY,    DEAD,           DEAD,           DEAD,           DEAD,           DEAD,           DEAD           }, // NUMBER_START
+    { DEAD,           DEAD,           NUMBER_BODY,    DEAD,           DEAD,           DEAD,           DEAD,           DEAD,           DEAD           }, // NUMBER_BODY
+    { DEAD,           DEAD,           DEAD,           STRING_BODY,    DEAD,           DEAD,           DEAD,           DEAD,           DEAD           }, // STRING_START
+    { STRING_BODY,    STRING_BODY,    STRING_BODY,    STRING_END,     STRING_BODY,    STRING_BODY,    STRING_BODY,    STRING_BODY,    STRING_BODY    }, // STRING_BODY
+    { DEAD,           DEAD,           DEAD,           DEAD,           DEAD,           DEAD,           DEAD,           DEAD,           DEAD           }, // STRING_END
+    { DEAD,           DEAD,           DEAD,           DEAD,           CHAR_OPEN,      DEAD,           DEAD,           DEAD,           DEAD           }, // CHAR_START
+    { CHAR_BODY,      CHAR_BODY,      CHAR_BODY,      CHAR_BODY,      CHAR_BODY,      CHAR_BODY,      CHAR_BODY,      CHAR_BODY,      DEAD           }, // CHAR_OPEN
+    { DEAD,           DEAD,           DEAD,           DEAD,           CHAR_END,       DEAD,           DEAD,           DEAD,           DEAD           }, // CHAR_BODY
+    { DEAD,           DEAD,           DEAD,           DEAD,           DEAD,           DEAD,           DEAD,           DEAD,           DEAD           }, // CHAR_END
+    { DEAD,           DEAD,           DEAD,           DEAD,           DEAD,           CMT_BODY,       DEAD,           DEAD,           DEAD           }, // CMT_START
+    { CMT_BODY,       CMT_BODY,       CMT_BODY,       CMT_BODY,       CMT_BODY,       CMT_BODY,       CMT_BODY,       CMT_BODY,       DEAD           }, // CMT_BODY
+    { DEAD,           DEAD,           DEAD,           DEAD,           DEAD,           DEAD,           MULTI_CMT_OPEN, DEAD,           DEAD           }, // MULTI_CMT_START
+    { DEAD,           DEAD,           DEAD,           DEAD,           DEAD,           DEAD,           DEAD,           MULTI_CMT_BODY, DEAD           }, // MULTI_CMT_OPEN
+    { MULTI_CMT_BODY, MULTI_CMT_BODY, MULTI_CMT_BODY, MULTI_CMT_BODY, MULTI_CMT_BODY, MULTI_CMT_BODY, MULTI_CMT_BODY, MULTI_CMT_STAR, MULTI_CMT_BODY }, // MULTI_CMT_BODY
+    { MULTI_CMT_BODY, MULTI_CMT_BODY, MULTI_CMT_BODY, MULTI_CMT_BODY, MULTI_CMT_BODY, MULTI_CMT_BODY, MULTI_CMT_END,  MULTI_CMT_STAR, MULTI_CMT_BODY }, // MULTI_CMT_STAR
+    { DEAD,           DEAD,           DEAD,           DEAD,           DEAD,           DEAD,           DEAD,           DEAD,           DEAD           }, // MULTI_CMT_END
+};
+// clang-format on
+
+static constexpr bool ACCEPTING[DFA_STATE_COUNT] = {
+    false, // DEAD
+    false, // IDENT_START
+    true,  // IDENT_BODY
+    false, // NUMBER_START
+    true,  // NUMBER_BODY
+    false, // STRING_START
+    false, // STRING_BODY
+    true,  // STRING_END
+    false, // CHAR_START
+    false, // CHAR_OPEN
+    false, // CHAR_BODY
+    true,  // CHAR_END
+    false, // CMT_START
+    true,  // CMT_BODY
+    false, // MULTI_CMT_START
+    false, // MULTI_CMT_OPEN
+    false, // MULTI_CMT_BODY
+    false, // MULTI_CMT_STAR
+    true,  // MULTI_CMT_END
+};
+
+size_t scanDFA(DFA_STATES start, const char *begin, const char *end) {
+    unsigned char state = start;
+    size_t matched = 0;
+    for (const char *p = begin; p != end; p++) {
+        state = TRANSITIONS[state][CHAR_CLASS.classes[(unsigned char)*p]];
+        if (state == DEAD) {
+            break;
+        }
+        if (ACCEPTING[state]) {
+            matched = p - begin + 1;
+        }
+    }
+    return matched;
+}
@@ -0,0 +1,59 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstddef>
+
+// Start states for the table-driven scanner, one per token class that used
+// to be matched by a regex in tokens.hpp
+enum DFA_STATES
+{
+    DEAD,
+    IDENT_START,     // [a-zA-Z_]
+    IDENT_BODY,      // [a-zA-Z0-9_]*
+    NUMBER_START,    // [0-9]
+    NUMBER_BODY,     // [0-9]*
+    STRING_START,    // "
+    STRING_BODY,     // [^"]*
+    STRING_END,      // "
+    CHAR_START,      // '
+    CHAR_OPEN,       // any but \n or \r
+    CHAR_BODY,       // '
+    CHAR_END,        //
+    CMT_START,       // #
+    CMT_BODY,        // any but \n or \r
+    MULTI_CMT_START, // /
+    MULTI_CMT_OPEN,  // *
+    MULTI_CMT_BODY,  // anything up to the first */
+    MULTI_CMT_STAR,  //
+    MULTI_CMT_END,   //
+    DFA_STATE_COUNT
+};
+
+// Returns the length of the longest match starting at begin, 0 if none
+size_t scanDFA(DFA_STATES start, const char *begin, const char *end);
@@ -0,0 +1,96 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "diagnostics.hpp"
+
+#include "sources.hpp"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+using std::string;
+using std::to_string;
+using std::vector;
+
+Diagnostic::Diagnostic(uint32_t file, uint32_t pos, string message) {
+    this->file = file;
+    this->pos = pos;
+    this->message = std::move(message);
+}
+
+uint32_t Diagnostic::line() const {
+    uint32_t line = 0, lpos = 0;
+    if (this->pos) {
+        SOURCES.position(this->file, this->pos - 1, line, lpos);
+    }
+    return line;
+}
+
+uint32_t Diagnostic::lpos() const {
+    uint32_t line = 0, lpos = 0;
+    if (this->pos) {
+        SOURCES.position(this->file, this->pos - 1, line, lpos);
+    }
+    return lpos;
+}
+
+string Diagnostic::toString() const {
+    string t;
+    t += SOURCES.filename(this->file);
+    t += ":";
+    t += to_string(this->line());
+    t += ":";
+    t += to_string(this->lpos());
+    t += ": ";
+    t += this->message;
+    return t;
+}
+
+void Diagnostics::report(uint32_t file, uint32_t pos, string message) {
+    this->diagnostics.emplace_back(file, pos, std::move(message));
+}
+
+void Diagnostics::truncate(size_t size) {
+    if (size < this->diagnostics.size()) {
+        this->diagnostics.erase(this->diagnostics.begin() + size,
+                                this->diagnostics.end());
+    }
+}
+
+const vector<Diagnostic> &Diagnostics::all() const {
+    return this->diagnostics;
+}
+
+bool Diagnostics::empty() const {
+    return this->diagnostics.empty();
+}
+
+size_t Diagnostics::size() const {
+    return this->diagnostics.size();
+}
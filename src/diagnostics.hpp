@@ -0,0 +1,59 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Where a problem is, as a file and pos like a Token, with line and
+// column looked up when it is shown. pos 0 is no position.
+class Diagnostic {
+  public:
+    Diagnostic(uint32_t, uint32_t, std::string);
+    uint32_t file;
+    uint32_t pos;
+    std::string message;
+    uint32_t line() const;
+    uint32_t lpos() const;
+    std::string toString() const;
+};
+
+// Collects every error found while lexing a file, so that one bad token
+// does not hide the rest. Only fatal errors are still thrown.
+class Diagnostics {
+  public:
+    void report(uint32_t, uint32_t, std::string); // file, pos, message
+    void truncate(size_t); // drops everything reported after the first n
+    const std::vector<Diagnostic> &all() const;
+    bool empty() const;
+    size_t size() const;
+
+  private:
+    std::vector<Diagnostic> diagnostics;
+};
@@ -0,0 +1,447 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "heap.hpp"
+
+#include "bytecode.hpp"
+#include "object.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <string_view>
+#include <sys/mman.h>
+#include <utility>
+
+using std::string_view;
+using std::chrono::duration;
+using std::chrono::steady_clock;
+
+// The old generation is committed this much at a time
+const size_t CHUNK = size_t(1) << 20;
+
+// Cells over this part of the nursery are made in the old generation
+const size_t LARGE = 8;
+
+static size_t align(size_t bytes) {
+    return (bytes + 7) & ~size_t(7);
+}
+
+static Cell *header(void *payload) {
+    return static_cast<Cell *>(payload) - 1;
+}
+
+static Cell *after(Cell *cell) {
+    return reinterpret_cast<Cell *>(reinterpret_cast<char *>(cell)
+                                    + cell->size);
+}
+
+// Points what a cell holds into itself at where it now is, after moving
+// it from the address from
+static void settle(const Cell *from, Cell *to) {
+    if (to->kind == CELL_KINDS::STRING_CELL) {
+        string_view *view = reinterpret_cast<string_view *>(to + 1);
+        *view = string_view(reinterpret_cast<char *>(view + 1), view->size());
+    }
+    else if (to->kind == CELL_KINDS::OBJECT_CELL) {
+        const Object *before = reinterpret_cast<const Object *>(from + 1);
+        Object *object = reinterpret_cast<Object *>(to + 1);
+        if (object->slots == reinterpret_cast<const Value *>(before + 1)) {
+            object->slots = object->room();
+        }
+    }
+}
+
+Reservation::~Reservation() {
+    if (this->base) {
+        munmap(this->base, this->reserved);
+    }
+}
+
+bool Reservation::reserve(size_t bytes) {
+    void *map = mmap(nullptr, bytes, PROT_NONE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    this->base = static_cast<char *>(map);
+    this->reserved = bytes;
+    return true;
+}
+
+bool Reservation::commit(size_t bytes) {
+    if (bytes <= this->committed) {
+        return true;
+    }
+    size_t end = std::min((bytes + CHUNK - 1) / CHUNK * CHUNK, this->reserved);
+    if (mprotect(this->base + this->committed, end - this->committed,
+                 PROT_READ | PROT_WRITE)
+        != 0) {
+        return false;
+    }
+    this->committed = end;
+    return true;
+}
+
+Heap::Heap(const HeapOptions &options, std::function<void()> roots)
+    : options(options), roots(std::move(roots)) {
+    this->options.nursery = align(
+        std::min(std::max(this->options.nursery, MIN_NURSERY), MAX_NURSERY));
+    this->options.limit = std::min(
+        std::max(this->options.limit, 2 * this->options.nursery), MAX_OLD);
+    this->threshold = std::min(this->options.limit - this->options.nursery,
+                               8 * this->options.nursery);
+}
+
+void *Heap::allocate(CELL_KINDS kind, size_t bytes) {
+    if (bytes > UINT32_MAX - sizeof(Cell) - 7) {
+        return nullptr;
+    }
+    size_t size = align(sizeof(Cell) + bytes);
+    if (!this->nursery) { // a run that makes nothing reserves nothing
+        this->nursery.reset(new (std::nothrow) char[this->options.nursery]);
+        if (!this->nursery) {
+            return nullptr;
+        }
+        if (!this->old.reserve(this->options.limit)) {
+            this->nursery.reset();
+            return nullptr;
+        }
+    }
+    Cell *cell;
+    if (size > this->options.nursery / LARGE) {
+        if (this->options.limit - this->top < size) {
+            this->major();
+            if (this->options.limit - this->top < size + this->survivors) {
+                return nullptr;
+            }
+        }
+        if (!this->old.commit(this->top + size)) {
+            return nullptr;
+        }
+        char *at = this->claim(size);
+        cell = reinterpret_cast<Cell *>(at);
+        // the caller fills it in without the barrier
+        size_t offset = at - this->old.get();
+        std::fill(this->cards.begin() + (offset >> CARD_SHIFT),
+                  this->cards.begin() + ((offset + size - 1) >> CARD_SHIFT)
+                      + 1,
+                  1);
+    }
+    else {
+        if (this->fresh + size > this->options.nursery) {
+            if (this->options.limit - this->top < this->fresh) {
+                // what survives might not fit, a major finds out
+                this->major();
+                if (this->options.limit - this->top < this->survivors) {
+                    return nullptr;
+                }
+            }
+            // at worst the whole nursery survives
+            if (!this->old.commit(this->top + this->fresh)) {
+                return nullptr;
+            }
+            this->minor();
+            if (this->top > this->threshold) {
+                this->major();
+            }
+        }
+        cell = reinterpret_cast<Cell *>(this->nursery.get() + this->fresh);
+        this->fresh += size;
+    }
+    cell->size = uint32_t(size);
+    cell->kind = kind;
+    cell->marked = false;
+    cell->forward = nullptr;
+    this->stats.allocated += size;
+    return cell + 1;
+}
+
+bool Heap::young(const void *p) const {
+    uintptr_t offset = reinterpret_cast<uintptr_t>(p)
+                       - reinterpret_cast<uintptr_t>(this->nursery.get());
+    return offset < this->fresh;
+}
+
+bool Heap::inOld(const void *p) const {
+    uintptr_t offset = reinterpret_cast<uintptr_t>(p)
+                       - reinterpret_cast<uintptr_t>(this->old.get());
+    return offset < this->top;
+}
+
+// Keeps a card and first cell for every card up to the new top, which a
+// collection has made sure there is room for
+char *Heap::claim(size_t size) {
+    size_t offset = this->top;
+    this->top += size;
+    size_t cards = ((this->top - 1) >> CARD_SHIFT) + 1;
+    if (this->cards.size() < cards) {
+        this->cards.resize(cards, 0);
+        this->firsts.resize(cards, 0);
+    }
+    if (!this->firsts[offset >> CARD_SHIFT]) {
+        this->firsts[offset >> CARD_SHIFT] = uint32_t(offset + 1);
+    }
+    this->stats.peak = std::max(this->stats.peak, this->top);
+    return this->old.get() + offset;
+}
+
+void Heap::visit(Value &value) {
+    if (value.type == VALUE_TYPES::STRING_VALUE) {
+        void *payload = const_cast<string_view *>(value.s);
+        this->relocate(payload);
+        value.s = static_cast<const string_view *>(payload);
+    }
+    else if (value.type == VALUE_TYPES::OBJECT_VALUE) {
+        void *payload = value.object;
+        this->relocate(payload);
+        value.object = static_cast<Object *>(payload);
+    }
+}
+
+// What a collection does with a pointer to a payload. Strings from the
+// Program are in neither generation and left alone.
+void Heap::relocate(void *&payload) {
+    Cell *cell = header(payload);
+    switch (this->phase) {
+        case GC_PHASES::MINOR_GC:
+            if (!this->young(cell)) {
+                return;
+            }
+            if (!cell->forward) {
+                Cell *copy = reinterpret_cast<Cell *>(this->claim(cell->size));
+                std::memcpy(copy, cell, cell->size);
+                copy->marked = false;
+                settle(cell, copy);
+                cell->forward = copy;
+            }
+            payload = cell->forward + 1;
+            return;
+        case GC_PHASES::MARK_GC: {
+            // before the header is looked at, which a Program string lacks
+            bool young = this->young(cell);
+            if ((!young && !this->inOld(cell)) || cell->marked) {
+                return;
+            }
+            if (young) {
+                this->survivors += cell->size;
+            }
+            cell->marked = true;
+            this->marking.push_back(cell);
+            return;
+        }
+        default: // UPDATE_GC
+            if (this->inOld(cell)) {
+                payload = cell->forward + 1;
+            }
+            return;
+    }
+}
+
+// Relocates every pointer the cell holds
+void Heap::trace(Cell *cell) {
+    if (cell->kind == CELL_KINDS::OBJECT_CELL) {
+        Object *object = reinterpret_cast<Object *>(cell + 1);
+        if (object->slots == object->room()) {
+            for (uint32_t j = 0; j < object->inlined; j++) {
+                this->visit(object->slots[j]);
+            }
+        }
+        else {
+            void *slots = object->slots;
+            this->relocate(slots);
+            object->slots = static_cast<Value *>(slots);
+        }
+    }
+    else if (cell->kind == CELL_KINDS::SLOTS_CELL) {
+        Value *values = reinterpret_cast<Value *>(cell + 1);
+        size_t count = (cell->size - sizeof(Cell)) / sizeof(Value);
+        for (size_t j = 0; j < count; j++) {
+            this->visit(values[j]);
+        }
+    }
+}
+
+// The old cell the start of a card falls in
+Cell *Heap::covering(size_t card) const {
+    size_t first = card;
+    while (!this->firsts[first]) { // cells bigger than a card cross it
+        first--;
+    }
+    char *start = this->old.get() + (card << CARD_SHIFT);
+    Cell *cell = reinterpret_cast<Cell *>(this->old.get() + this->firsts[first]
+                                          - 1);
+    while (reinterpret_cast<char *>(after(cell)) <= start) {
+        cell = after(cell);
+    }
+    return cell;
+}
+
+// Copies the reachable part of the nursery to the old generation, from
+// the roots and the cards, then from the copies themselves
+void Heap::minor() {
+    auto start = steady_clock::now();
+    this->phase = GC_PHASES::MINOR_GC;
+    size_t before = this->top;
+    this->roots();
+    char *base = this->old.get();
+    size_t cards = before ? ((before - 1) >> CARD_SHIFT) + 1 : 0;
+    Cell *done = reinterpret_cast<Cell *>(base);
+    for (size_t card = 0; card < cards; card++) {
+        if (!this->cards[card]) {
+            continue;
+        }
+        char *end = base + std::min((card + 1) << CARD_SHIFT, before);
+        Cell *cell = std::max(this->covering(card), done);
+        for (; reinterpret_cast<char *>(cell) < end; cell = after(cell)) {
+            this->trace(cell);
+        }
+        done = cell;
+    }
+    for (size_t scan = before; scan < this->top;) {
+        Cell *cell = reinterpret_cast<Cell *>(base + scan);
+        this->trace(cell);
+        scan += cell->size;
+    }
+    std::fill(this->cards.begin(), this->cards.end(), 0);
+    this->fresh = 0;
+    this->stats.promoted += this->top - before;
+    this->stats.minors++;
+    double seconds = duration<double>(steady_clock::now() - start).count();
+    this->stats.minorSeconds += seconds;
+    this->stats.minorMax = std::max(this->stats.minorMax, seconds);
+}
+
+// Marks from the roots through both generations, then slides the live
+// old cells down in order, LISP2 style: work out where each goes, point
+// everything at that, then move them
+void Heap::major() {
+    auto start = steady_clock::now();
+    this->phase = GC_PHASES::MARK_GC;
+    this->survivors = 0;
+    this->roots();
+    while (!this->marking.empty()) {
+        Cell *cell = this->marking.back();
+        this->marking.pop_back();
+        this->trace(cell);
+    }
+    char *base = this->old.get();
+    size_t live = 0;
+    for (size_t at = 0; at < this->top;) {
+        Cell *cell = reinterpret_cast<Cell *>(base + at);
+        if (cell->marked) {
+            cell->forward = reinterpret_cast<Cell *>(base + live);
+            live += cell->size;
+        }
+        at += cell->size;
+    }
+    this->phase = GC_PHASES::UPDATE_GC;
+    this->roots();
+    for (size_t at = 0; at < this->top;) {
+        Cell *cell = reinterpret_cast<Cell *>(base + at);
+        if (cell->marked) {
+            this->trace(cell);
+        }
+        at += cell->size;
+    }
+    char *young = this->nursery.get();
+    for (size_t at = 0; at < this->fresh;) {
+        Cell *cell = reinterpret_cast<Cell *>(young + at);
+        if (cell->marked) {
+            this->trace(cell);
+            cell->marked = false;
+        }
+        at += cell->size;
+    }
+    std::fill(this->firsts.begin(), this->firsts.end(), 0);
+    for (size_t at = 0; at < this->top;) {
+        Cell *cell = reinterpret_cast<Cell *>(base + at);
+        size_t size = cell->size;
+        if (cell->marked) {
+            Cell *to = cell->forward;
+            if (to != cell) {
+                std::memmove(to, cell, size);
+                settle(cell, to);
+            }
+            to->marked = false;
+            size_t offset = reinterpret_cast<char *>(to) - base;
+            if (!this->firsts[offset >> CARD_SHIFT]) {
+                this->firsts[offset >> CARD_SHIFT] = uint32_t(offset + 1);
+            }
+        }
+        at += size;
+    }
+    this->top = live;
+    // the cards no longer say where young cells are pointed at from, so
+    // the next minor looks at all of them
+    std::fill(this->cards.begin(), this->cards.end(), this->fresh ? 1 : 0);
+    this->phase = GC_PHASES::MINOR_GC;
+    this->threshold =
+        std::min(this->options.limit - this->options.nursery,
+                 std::max(2 * live, 8 * this->options.nursery));
+    this->stats.live = live;
+    this->stats.majors++;
+    double seconds = duration<double>(steady_clock::now() - start).count();
+    this->stats.majorSeconds += seconds;
+    this->stats.majorMax = std::max(this->stats.majorMax, seconds);
+}
+
+void Heap::report(std::ostream &out) const {
+    char line[128];
+    out << "Tooty-lang: gc stats\n";
+    snprintf(line, sizeof line,
+             "  nursery %zu KB, old generation up to %zu MB\n",
+             this->options.nursery >> 10, this->options.limit >> 20);
+    out << line;
+    snprintf(line, sizeof line, "  %-8s %8s %12s %12s %12s\n", "pause",
+             "count", "total ms", "max ms", "mean ms");
+    out << line;
+    const char *names[] = {"minor", "major"};
+    uint64_t counts[] = {this->stats.minors, this->stats.majors};
+    double totals[] = {this->stats.minorSeconds, this->stats.majorSeconds};
+    double maxes[] = {this->stats.minorMax, this->stats.majorMax};
+    for (int k = 0; k < 2; k++) {
+        double mean = counts[k] ? totals[k] / counts[k] : 0;
+        snprintf(line, sizeof line, "  %-8s %8llu %12.3f %12.3f %12.3f\n",
+                 names[k], (unsigned long long)counts[k], totals[k] * 1e3,
+                 maxes[k] * 1e3, mean * 1e3);
+        out << line;
+    }
+    snprintf(line, sizeof line,
+             "  allocated %llu bytes, promoted %llu bytes\n",
+             (unsigned long long)this->stats.allocated,
+             (unsigned long long)this->stats.promoted);
+    out << line;
+    snprintf(line, sizeof line,
+             "  old generation: %zu bytes now, %zu at peak, %zu live after "
+             "the last major\n",
+             this->top, this->stats.peak, this->stats.live);
+    out << line;
+    out.flush();
+}
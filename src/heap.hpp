@@ -0,0 +1,171 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "bytecode.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+enum CELL_KINDS : uint8_t
+{
+    STRING_CELL, // a string_view and the bytes it looks at
+    OBJECT_CELL, // an Object and room for its first fields
+    SLOTS_CELL,  // the fields of an Object that outgrew that room
+};
+
+// In front of everything the heap holds. Values and objects point at what
+// follows it, so the header of a payload p is static_cast<Cell *>(p) - 1.
+struct Cell {
+    uint32_t size; // with the header, a multiple of 8
+    CELL_KINDS kind;
+    bool marked;
+    Cell *forward; // where a collection moved it
+};
+
+// Tunable with --nursery and --heap. A Heap keeps the nursery between
+// MIN_NURSERY and MAX_NURSERY and the limit between twice the nursery and
+// MAX_OLD.
+struct HeapOptions {
+    size_t nursery = size_t(1) << 20; // bytes
+    size_t limit = size_t(256) << 20; // the most the old generation holds
+};
+
+// Small enough that a full nursery is quick to copy out of
+const size_t MIN_NURSERY = size_t(64) << 10;
+// Offsets in the old generation fit in 32 bits
+const size_t MAX_OLD = size_t(2048) << 20;
+// So that the old generation can hold two of it
+const size_t MAX_NURSERY = MAX_OLD / 2;
+
+// Address space for the old generation. All of it is reserved up front so
+// that cells never move when it grows, but only what has been committed is
+// backed by memory, so a run pays for what it uses rather than the limit.
+class Reservation {
+  public:
+    Reservation() = default;
+    Reservation(const Reservation &) = delete;
+    Reservation &operator=(const Reservation &) = delete;
+    ~Reservation();
+    bool reserve(size_t bytes);
+    // Makes the first bytes usable, as far as they are reserved. False if
+    // there is no memory for them.
+    bool commit(size_t bytes);
+    char *get() const {
+        return this->base;
+    }
+
+  private:
+    char *base = nullptr;
+    size_t reserved = 0;
+    size_t committed = 0;
+};
+
+// Pauses and traffic, for --gc-stats
+struct GcStats {
+    uint64_t allocated = 0; // bytes, with headers
+    uint64_t promoted = 0;
+    uint64_t minors = 0;
+    uint64_t majors = 0;
+    double minorSeconds = 0;
+    double minorMax = 0;
+    double majorSeconds = 0;
+    double majorMax = 0;
+    size_t live = 0; // in the old generation after the last major
+    size_t peak = 0; // most the old generation held
+};
+
+// 512-byte cards, the granule of the write barrier
+const unsigned CARD_SHIFT = 9;
+
+enum GC_PHASES : uint8_t
+{
+    MINOR_GC,  // copying what is reachable out of the nursery
+    MARK_GC,   // finding what is reachable at all
+    UPDATE_GC, // pointing at where the old generation is compacted to
+};
+
+// A precise generational heap. New cells are bumped out of the nursery,
+// and when it fills up a minor collection copies the ones still reachable
+// to the end of the old generation and starts the nursery over. Old cells
+// that were written since are found through the cards the write barrier
+// marked. Once the old generation grows past a threshold a major
+// collection marks it and slides the live cells down over the dead ones.
+// Cells too big for the nursery go straight to the old generation.
+class Heap {
+  public:
+    // roots is called during every collection and hands each value that
+    // lives outside the heap and may point into it to visit()
+    Heap(const HeapOptions &, std::function<void()> roots);
+    Heap(const Heap &) = delete;
+    Heap &operator=(const Heap &) = delete;
+    // Room for bytes after a header of kind, nullptr once even a major
+    // collection leaves too little. Anything may move while collecting,
+    // and the payload has to be filled in before the next allocation.
+    void *allocate(CELL_KINDS, size_t bytes);
+    // After storing into a cell, so the next minor collection looks at it
+    void barrier(const void *slot) {
+        uintptr_t offset = reinterpret_cast<uintptr_t>(slot)
+                           - reinterpret_cast<uintptr_t>(this->old.get());
+        if (offset < this->top) {
+            this->cards[offset >> CARD_SHIFT] = 1;
+        }
+    }
+    void visit(Value &);
+    size_t limit() const {
+        return this->options.limit;
+    }
+    void report(std::ostream &) const;
+    GcStats stats;
+
+  private:
+    HeapOptions options;
+    std::function<void()> roots;
+    std::unique_ptr<char[]> nursery;
+    size_t fresh = 0; // bytes of the nursery handed out
+    Reservation old;
+    size_t top = 0; // bytes of the old generation in use
+    size_t threshold;
+    std::vector<uint8_t> cards;   // per card, written since the last minor
+    std::vector<uint32_t> firsts; // offset + 1 of the first cell in a card
+    std::vector<Cell *> marking;
+    size_t survivors = 0; // bytes of the nursery a major marked
+    GC_PHASES phase = GC_PHASES::MINOR_GC;
+    bool young(const void *) const;
+    bool inOld(const void *) const;
+    char *claim(size_t); // at the top of the old generation
+    void relocate(void *&);
+    void trace(Cell *);
+    Cell *covering(size_t card) const;
+    void minor();
+    void major();
+};
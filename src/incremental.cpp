@@ -0,0 +1,255 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "incremental.hpp"
+
+#include "diagnostics.hpp"
+#include "lexer.hpp"
+#include "sources.hpp"
+#include "tokens.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+IncrementalLexer::IncrementalLexer(string filename, string source,
+                                   BACKENDS backend) {
+    this->filename = std::move(filename);
+    this->source = std::move(source);
+    this->file = SOURCES.intern(this->filename);
+    SOURCES.setSource(this->file, this->source);
+    this->backend = backend;
+    this->relex(0, this->source.size(), 0);
+}
+
+Token IncrementalLexer::Block::at(size_t i) const {
+    Token token = this->tokens[i];
+    token.pos += this->posShift;
+    return token;
+}
+
+void IncrementalLexer::apply(const Edit &edit) {
+    if (edit.offset > this->source.size()
+        || edit.removed > this->source.size() - edit.offset) {
+        throw std::out_of_range("Edit past the end of the text");
+    }
+    string removed = this->source.substr(edit.offset, edit.removed);
+    this->source.replace(edit.offset, edit.removed, edit.inserted);
+    SOURCES.edit(this->file, this->source, edit.offset, edit.removed,
+                 edit.inserted.size());
+    try {
+        this->relex(edit.offset, edit.offset + edit.inserted.size(),
+                    int64_t(edit.inserted.size()) - int64_t(edit.removed));
+    }
+    catch (...) {
+        this->source.replace(edit.offset, edit.inserted.size(), removed);
+        SOURCES.edit(this->file, this->source, edit.offset,
+                     edit.inserted.size(), removed.size());
+        throw;
+    }
+}
+
+// Lexes the text from the start of the last block whose first token ends
+// before offset, as nothing before that can see the edit. The old tokens
+// are walked alongside, replaying their bracket state, until a new token
+// past end is the same as an old one and leaves the same state.
+void IncrementalLexer::relex(size_t offset, size_t end, int64_t delta) {
+    vector<Block> &blocks = this->blocks;
+    size_t lo = 0;
+    size_t hi = blocks.size();
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        Token token = blocks[mid].at(0);
+        if (token.pos - 1 + token.length < offset) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    size_t first = lo ? lo - 1 : 0;
+
+    Lexer lexer(this->file, this->source, this->backend);
+    LexState old;
+    if (lo) {
+        Token token = blocks[first].at(0);
+        lexer.resume(token.pos, blocks[first].state);
+        old = blocks[first].state;
+    }
+
+    // the old token the new ones are compared against
+    size_t ob = first;
+    size_t oi = 0;
+    bool synced = false;
+    char expected;
+
+    vector<Block> fresh;
+    size_t lexed = 0;
+    Token token;
+    while (true) {
+        if (fresh.empty() || fresh.back().tokens.size() == BLOCK) {
+            fresh.emplace_back();
+            fresh.back().state = lexer.state();
+            fresh.back().tokens.reserve(BLOCK);
+        }
+        size_t reported = lexer.diagnostics.size();
+        if (!lexer.nextToken(token)) {
+            break;
+        }
+        Block &block = fresh.back();
+        for (size_t i = reported; i < lexer.diagnostics.size(); i++) {
+            block.reports.push_back(Report{uint32_t(block.tokens.size()),
+                                           lexer.diagnostics.all()[i]});
+        }
+        block.tokens.push_back(token);
+        lexed++;
+        if (token.pos - 1 < end) {
+            continue;
+        }
+        int64_t target = int64_t(token.pos) - delta;
+        for (; ob < blocks.size(); ob++, oi = 0) {
+            for (; oi < blocks[ob].tokens.size(); oi++) {
+                Token o = blocks[ob].at(oi);
+                if (o.pos >= target) {
+                    break;
+                }
+                old.track(o.type, expected);
+            }
+            if (oi < blocks[ob].tokens.size()) {
+                break;
+            }
+        }
+        if (ob == blocks.size()) {
+            continue;
+        }
+        Token o = blocks[ob].at(oi);
+        if (o.pos != target || o.type != token.type
+            || o.length != token.length) {
+            continue;
+        }
+        old.track(o.type, expected);
+        if (old == lexer.state()) {
+            synced = true;
+            break;
+        }
+        oi++;
+    }
+    if (fresh.back().tokens.empty()) {
+        fresh.pop_back();
+    }
+    this->lastRelexed = lexed;
+
+    vector<Block> tail;
+    if (synced) {
+        // the old tokens after the one matched keep their distance to it
+        Block rest;
+        rest.state = lexer.state();
+        const Block &split = blocks[ob];
+        for (size_t i = oi + 1; i < split.tokens.size(); i++) {
+            rest.tokens.push_back(split.at(i));
+        }
+        for (const Report &report: split.reports) {
+            if (report.token > oi) {
+                Report moved = report;
+                moved.token -= oi + 1;
+                moved.diagnostic.pos += split.posShift;
+                rest.reports.push_back(moved);
+            }
+        }
+        if (!rest.tokens.empty()) {
+            tail.push_back(std::move(rest));
+        }
+        std::move(blocks.begin() + ob + 1, blocks.end(),
+                  std::back_inserter(tail));
+        for (Block &block: tail) {
+            block.posShift += delta;
+        }
+        // a short piece left of the split block joins the last new block
+        if (!tail.empty() && !fresh.empty()
+            && fresh.back().tokens.size() + tail[0].tokens.size() <= BLOCK) {
+            Block &last = fresh.back();
+            uint32_t at = last.tokens.size();
+            for (size_t i = 0; i < tail[0].tokens.size(); i++) {
+                last.tokens.push_back(tail[0].at(i));
+            }
+            for (Report &report: tail[0].reports) {
+                report.token += at;
+                report.diagnostic.pos += tail[0].posShift;
+                last.reports.push_back(std::move(report));
+            }
+            tail.erase(tail.begin());
+        }
+    }
+    blocks.erase(blocks.begin() + first, blocks.end());
+    std::move(fresh.begin(), fresh.end(), std::back_inserter(blocks));
+    std::move(tail.begin(), tail.end(), std::back_inserter(blocks));
+    this->count = 0;
+    for (const Block &block: blocks) {
+        this->count += block.tokens.size();
+    }
+}
+
+const string &IncrementalLexer::text() const {
+    return this->source;
+}
+
+size_t IncrementalLexer::size() const {
+    return this->count;
+}
+
+vector<Token> IncrementalLexer::tokens() const {
+    vector<Token> tokens;
+    tokens.reserve(this->count);
+    for (const Block &block: this->blocks) {
+        for (size_t i = 0; i < block.tokens.size(); i++) {
+            tokens.push_back(block.at(i));
+        }
+    }
+    return tokens;
+}
+
+vector<Diagnostic> IncrementalLexer::diagnostics() const {
+    vector<Diagnostic> diagnostics;
+    for (const Block &block: this->blocks) {
+        for (const Report &report: block.reports) {
+            diagnostics.push_back(report.diagnostic);
+            diagnostics.back().pos += block.posShift;
+        }
+    }
+    return diagnostics;
+}
+
+size_t IncrementalLexer::relexed() const {
+    return this->lastRelexed;
+}
@@ -0,0 +1,86 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "diagnostics.hpp"
+#include "lexer.hpp"
+#include "tokens.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// removed bytes at offset replaced with inserted
+struct Edit {
+    size_t offset;
+    size_t removed;
+    std::string_view inserted;
+};
+
+// Keeps the tokens of a buffer that is being edited. An edit re-lexes from
+// a little before it until a token lines up with an old one in the same
+// lexer state, the tokens after that are shifted rather than lexed again.
+// Tokens are kept in blocks so the shift is per block, not per token.
+class IncrementalLexer {
+  public:
+    IncrementalLexer(std::string, std::string, BACKENDS = BACKENDS::DFA);
+    IncrementalLexer(const IncrementalLexer &) = delete;
+    IncrementalLexer &operator=(const IncrementalLexer &) = delete;
+    // Throws std::out_of_range for an edit outside the text, and what the
+    // lexer throws, leaving the text and tokens as they were
+    void apply(const Edit &);
+    const std::string &text() const;
+    size_t size() const;
+    std::vector<Token> tokens() const;
+    std::vector<Diagnostic> diagnostics() const;
+    size_t relexed() const; // tokens lexed by the last edit
+
+  private:
+    static const size_t BLOCK = 256;
+    struct Report {
+        uint32_t token; // index in the block of the token it came with
+        Diagnostic diagnostic;
+    };
+    struct Block {
+        std::vector<Token> tokens;
+        std::vector<Report> reports;
+        int64_t posShift = 0; // not yet applied to tokens and reports
+        LexState state; // before the first token
+        Token at(size_t) const;
+    };
+    std::string filename;
+    std::string source;
+    uint32_t file;
+    BACKENDS backend;
+    std::vector<Block> blocks;
+    size_t count = 0;
+    size_t lastRelexed = 0;
+    void relex(size_t, size_t, int64_t);
+};
@@ -0,0 +1,647 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "jit.hpp"
+
+#include "bytecode.hpp"
+#include "object.hpp"
+#include "vm.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) && defined(__unix__)
+#define TOOTY_JIT 1
+#include <sys/mman.h>
+#include <unistd.h>
+#else
+#define TOOTY_JIT 0
+#endif
+
+using std::vector;
+
+static_assert(sizeof(Value) == 16 && offsetof(Value, i) == 8,
+              "native code knows where a Value keeps its type and payload");
+
+// The op a superinstruction starts with, native code runs the second one
+// on its own
+static OPCODES first(OPCODES op) {
+    switch (op) {
+        case OPCODES::EQJMP_OP:
+            return OPCODES::EQ_OP;
+        case OPCODES::NEJMP_OP:
+            return OPCODES::NE_OP;
+        case OPCODES::SEQJMP_OP:
+            return OPCODES::SEQ_OP;
+        case OPCODES::SNEJMP_OP:
+            return OPCODES::SNE_OP;
+        case OPCODES::LTJMP_OP:
+            return OPCODES::LT_OP;
+        case OPCODES::LEJMP_OP:
+            return OPCODES::LE_OP;
+        case OPCODES::GTJMP_OP:
+            return OPCODES::GT_OP;
+        case OPCODES::GEJMP_OP:
+            return OPCODES::GE_OP;
+        case OPCODES::KADD_OP:
+        case OPCODES::KSUB_OP:
+        case OPCODES::KMUL_OP:
+        case OPCODES::KMOD_OP:
+            return OPCODES::LOADK_OP;
+        default:
+            return op;
+    }
+}
+
+Jit::Jit(const Program &program, JIT_MODES mode)
+    : program(program), mode(mode), functions(program.functions.size()) {
+}
+
+Jit::~Jit() {
+#if TOOTY_JIT
+    for (const Native &native: this->functions) {
+        if (native.code) {
+            munmap(const_cast<uint8_t *>(native.code), native.size);
+        }
+    }
+#endif
+}
+
+bool Jit::supported() {
+    return TOOTY_JIT;
+}
+
+size_t Jit::compiled() const {
+    return this->count;
+}
+
+uint32_t Jit::run(uint32_t function, uint32_t pc, Value *registers, VM &vm) {
+    const Native &native = this->functions[function];
+    Entry entry = reinterpret_cast<Entry>(
+        reinterpret_cast<uintptr_t>(native.code));
+    return entry(registers, this->program.constants.data(), vm.globals.data(),
+                 &vm, native.code + native.offsets[pc]);
+}
+
+// The slow paths native code calls. None of them throws, false sends the
+// instruction back to the interpreter, which fails on it the same way.
+bool Jit::arithmetic(VM *vm, Value *R, uint32_t i) {
+    try {
+        R[i >> 8 & 0xFF] = vm->arithmetic(first(OPCODES(i & 0xFF)),
+                                          R[i >> 16 & 0xFF], R[i >> 24]);
+        return true;
+    }
+    catch (...) {
+        return false;
+    }
+}
+
+// GETATTR, SETATTR and GETMETHOD, through the cache of the site in extra
+bool Jit::attribute(VM *vm, Value *R, uint32_t i, uint32_t extra) {
+    try {
+        Cache &cache = vm->caches[extra >> 8];
+        uint32_t a = i >> 8 & 0xFF;
+        uint32_t b = i >> 16 & 0xFF;
+        switch (OPCODES(i & 0xFF)) {
+            case OPCODES::GETATTR_OP:
+                R[a] = vm->attribute(R[b], cache);
+                break;
+            case OPCODES::SETATTR_OP:
+                vm->assign(R[a], cache, R[b]);
+                break;
+            default: { // GETMETHOD_OP
+                const Value object = R[b];
+                R[a] = vm->attribute(object, cache);
+                R[a + 1] = object;
+                break;
+            }
+        }
+        return true;
+    }
+    catch (...) {
+        return false;
+    }
+}
+
+bool Jit::unary(Value *R, uint32_t i) {
+    Value result;
+    if (!fold(OPCODES(i & 0xFF), R[i >> 16 & 0xFF], result)) {
+        return false;
+    }
+    R[i >> 8 & 0xFF] = result;
+    return true;
+}
+
+bool Jit::test(const Value *value) {
+    return truthy(*value);
+}
+
+#if TOOTY_JIT
+namespace {
+enum REGISTERS : uint8_t
+{
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15,
+};
+
+enum CONDITIONS : uint8_t
+{
+    O_CONDITION = 0x0,
+    E_CONDITION = 0x4,
+    NE_CONDITION = 0x5,
+    NS_CONDITION = 0x9,
+    L_CONDITION = 0xC,
+    GE_CONDITION = 0xD,
+    LE_CONDITION = 0xE,
+    G_CONDITION = 0xF,
+};
+
+// What native code keeps where, all saved by the callee
+const REGISTERS RBASE = RBX; // the registers of the fun
+const REGISTERS KBASE = R12; // the constants
+const REGISTERS GBASE = R13; // the globals
+const REGISTERS VMREG = R14; // the VM
+
+// Just the x86-64 the JIT needs. Memory operands are always a base
+// register and a 32-bit displacement.
+class Assembler {
+  public:
+    vector<uint8_t> bytes;
+    size_t size() const {
+        return this->bytes.size();
+    }
+    void byte(uint8_t b) {
+        this->bytes.push_back(b);
+    }
+    void word(uint32_t w) {
+        for (int i = 0; i < 4; i++) {
+            this->byte(w >> 8 * i);
+        }
+    }
+    void rex(bool wide, int reg, int base) {
+        uint8_t prefix = 0x40 | wide << 3 | (reg >> 3) << 2 | base >> 3;
+        if (prefix != 0x40) {
+            this->byte(prefix);
+        }
+    }
+    void memory(int reg, int base, int32_t disp) {
+        this->byte(0x80 | (reg & 7) << 3 | (base & 7));
+        if ((base & 7) == RSP) { // r12 needs a SIB byte too
+            this->byte(0x24);
+        }
+        this->word(disp);
+    }
+    // op reg, [base + disp] or the other way round, 64 bits wide
+    void wide(uint8_t op, int reg, int base, int32_t disp) {
+        this->rex(true, reg, base);
+        this->byte(op);
+        this->memory(reg, base, disp);
+    }
+    void load(int reg, int base, int32_t disp) {
+        this->wide(0x8B, reg, base, disp);
+    }
+    void store(int base, int32_t disp, int reg) {
+        this->wide(0x89, reg, base, disp);
+    }
+    void lea(int reg, int base, int32_t disp) {
+        this->wide(0x8D, reg, base, disp);
+    }
+    void imul(int reg, int base, int32_t disp) {
+        this->rex(true, reg, base);
+        this->byte(0x0F);
+        this->byte(0xAF);
+        this->memory(reg, base, disp);
+    }
+    void idiv(int base, int32_t disp) { // rdx:rax by the operand
+        this->wide(0xF7, 7, base, disp);
+    }
+    void storeImmediate(int base, int32_t disp, int32_t value) {
+        this->wide(0xC7, 0, base, disp);
+        this->word(value);
+    }
+    void compareByte(int base, int32_t disp, uint8_t value) {
+        this->rex(false, 0, base);
+        this->byte(0x80);
+        this->memory(7, base, disp);
+        this->byte(value);
+    }
+    void compareQuad(int base, int32_t disp, int8_t value) {
+        this->wide(0x83, 7, base, disp);
+        this->byte(value);
+    }
+    // 16 bytes through xmm0, a whole Value
+    void copy(int to, int32_t toDisp, int from, int32_t fromDisp) {
+        this->byte(0xF3);
+        this->rex(false, 0, from);
+        this->byte(0x0F);
+        this->byte(0x6F);
+        this->memory(0, from, fromDisp);
+        this->byte(0xF3);
+        this->rex(false, 0, to);
+        this->byte(0x0F);
+        this->byte(0x7F);
+        this->memory(0, to, toDisp);
+    }
+    void move(int to, int from) {
+        this->rex(true, from, to);
+        this->byte(0x89);
+        this->byte(0xC0 | (from & 7) << 3 | (to & 7));
+    }
+    void move32(int reg, uint32_t value) {
+        this->rex(false, 0, reg);
+        this->byte(0xB8 | (reg & 7));
+        this->word(value);
+    }
+    void move64(int reg, uint64_t value) {
+        this->rex(true, 0, reg);
+        this->byte(0xB8 | (reg & 7));
+        this->word(uint32_t(value));
+        this->word(uint32_t(value >> 32));
+    }
+    void call(int reg) {
+        this->rex(false, 0, reg);
+        this->byte(0xFF);
+        this->byte(0xD0 | (reg & 7));
+    }
+    void jump(int reg) {
+        this->rex(false, 0, reg);
+        this->byte(0xFF);
+        this->byte(0xE0 | (reg & 7));
+    }
+    void push(int reg) {
+        this->rex(false, 0, reg);
+        this->byte(0x50 | (reg & 7));
+    }
+    void pop(int reg) {
+        this->rex(false, 0, reg);
+        this->byte(0x58 | (reg & 7));
+    }
+    void testAl() {
+        this->byte(0x84);
+        this->byte(0xC0);
+    }
+    void testRdx() {
+        this->byte(0x48);
+        this->byte(0x85);
+        this->byte(0xD2);
+    }
+    void cqo() {
+        this->byte(0x48);
+        this->byte(0x99);
+    }
+    void set(CONDITIONS condition) { // eax = condition, 0 or 1
+        this->byte(0x0F);
+        this->byte(0x90 | condition);
+        this->byte(0xC0);
+        this->byte(0x0F);
+        this->byte(0xB6);
+        this->byte(0xC0);
+    }
+    void ret() {
+        this->byte(0xC3);
+    }
+    // Jumps return where their offset is, for patch()
+    size_t jump() {
+        this->byte(0xE9);
+        this->word(0);
+        return this->size() - 4;
+    }
+    size_t jump(CONDITIONS condition) {
+        this->byte(0x0F);
+        this->byte(0x80 | condition);
+        this->word(0);
+        return this->size() - 4;
+    }
+    void patch(size_t at, size_t target) {
+        uint32_t offset = uint32_t(int64_t(target) - int64_t(at + 4));
+        std::memcpy(&this->bytes[at], &offset, 4);
+    }
+};
+
+int32_t type(uint32_t r) {
+    return int32_t(r * sizeof(Value));
+}
+
+int32_t payload(uint32_t r) {
+    return int32_t(r * sizeof(Value) + offsetof(Value, i));
+}
+} // namespace
+#endif
+
+void Jit::compile(uint32_t index) {
+    Native &native = this->functions[index];
+    native.tried = true;
+#if TOOTY_JIT
+    const Function &function = this->program.functions[index];
+    const uint32_t *code = function.code;
+    // A fun without loops spends its time going in and out of native code
+    // at each CALL and RETURN, so it is only worth it to test the JIT
+    bool loops = false;
+    for (uint32_t pc = 0; pc < function.size; pc++) {
+        OPCODES op = OPCODES(code[pc] & 0xFF);
+        loops |= (op == OPCODES::JMP_OP || op == OPCODES::JMPIF_OP
+                  || op == OPCODES::JMPIFNOT_OP)
+                 && int(code[pc] >> 16) - JUMP_BIAS < 0;
+    }
+    if (!loops && this->mode != JIT_MODES::ALWAYS_JIT) {
+        return;
+    }
+    Assembler x;
+    // Entry(R, K, G, vm, where): saves what it uses, five registers so
+    // calls see the stack aligned, and jumps to where
+    for (int reg: {RBX, R12, R13, R14, R15}) {
+        x.push(reg);
+    }
+    x.move(RBASE, RDI);
+    x.move(KBASE, RSI);
+    x.move(GBASE, RDX);
+    x.move(VMREG, RCX);
+    x.jump(R8);
+    size_t epilogue = x.size();
+    for (int reg: {R15, R14, R13, R12, RBX}) {
+        x.pop(reg);
+    }
+    x.ret();
+
+    vector<uint32_t> offsets(function.size);
+    vector<std::pair<size_t, uint32_t>> jumps; // to patch, and their target
+    auto leave = [&](uint32_t pc) { // back to the interpreter at pc
+        x.move32(RAX, pc);
+        x.patch(x.jump(), epilogue);
+    };
+    // leaves unless the slow path in al worked
+    auto slow = [&](uint32_t pc, uint64_t helper) {
+        x.move(RDI, VMREG);
+        x.move(RSI, RBASE);
+        x.move32(RDX, code[pc]);
+        x.move64(RAX, helper);
+        x.call(RAX);
+        x.testAl();
+        size_t fine = x.jump(CONDITIONS::NE_CONDITION);
+        leave(pc);
+        x.patch(fine, x.size());
+    };
+    uint64_t arithmetic = reinterpret_cast<uintptr_t>(&Jit::arithmetic);
+    for (uint32_t pc = 0; pc < function.size; pc++) {
+        offsets[pc] = x.size();
+        uint32_t i = code[pc];
+        OPCODES op = first(OPCODES(i & 0xFF));
+        uint32_t a = i >> 8 & 0xFF;
+        uint32_t b = i >> 16 & 0xFF;
+        uint32_t c = i >> 24;
+        uint32_t bx = i >> 16;
+        uint32_t target = uint32_t(int64_t(pc) + 1 + int(bx) - JUMP_BIAS);
+        vector<size_t> toSlow;
+        vector<size_t> toDone;
+        auto ints = [&]() { // both operands, or off to the slow path
+            x.compareByte(RBASE, type(b), VALUE_TYPES::INT_VALUE);
+            toSlow.push_back(x.jump(CONDITIONS::NE_CONDITION));
+            x.compareByte(RBASE, type(c), VALUE_TYPES::INT_VALUE);
+            toSlow.push_back(x.jump(CONDITIONS::NE_CONDITION));
+        };
+        auto result = [&](VALUE_TYPES kind, int reg) {
+            x.storeImmediate(RBASE, type(a), kind);
+            x.store(RBASE, payload(a), reg);
+            toDone.push_back(x.jump());
+        };
+        auto finish = [&]() {
+            for (size_t at: toSlow) {
+                x.patch(at, x.size());
+            }
+            slow(pc, arithmetic);
+            for (size_t at: toDone) {
+                x.patch(at, x.size());
+            }
+        };
+        switch (op) {
+            case OPCODES::MOVE_OP:
+                x.copy(RBASE, type(a), RBASE, type(b));
+                break;
+            case OPCODES::LOADK_OP:
+                x.copy(RBASE, type(a), KBASE, type(bx));
+                break;
+            case OPCODES::LOADNONE_OP:
+                x.storeImmediate(RBASE, type(a), VALUE_TYPES::NONE_VALUE);
+                x.storeImmediate(RBASE, payload(a), 0);
+                break;
+            case OPCODES::GETGLOBAL_OP: {
+                x.compareByte(GBASE, type(bx), VALUE_TYPES::UNDEFINED_VALUE);
+                size_t defined = x.jump(CONDITIONS::NE_CONDITION);
+                leave(pc);
+                x.patch(defined, x.size());
+                x.copy(RBASE, type(a), GBASE, type(bx));
+                break;
+            }
+            case OPCODES::SETGLOBAL_OP:
+                x.copy(GBASE, type(bx), RBASE, type(a));
+                break;
+            case OPCODES::ADD_OP:
+            case OPCODES::SUB_OP:
+            case OPCODES::MUL_OP:
+                ints();
+                x.load(RAX, RBASE, payload(b));
+                if (op == OPCODES::MUL_OP) {
+                    x.imul(RAX, RBASE, payload(c));
+                }
+                else {
+                    x.wide(op == OPCODES::ADD_OP ? 0x03 : 0x2B, RAX, RBASE,
+                           payload(c));
+                }
+                toSlow.push_back(x.jump(CONDITIONS::O_CONDITION));
+                result(VALUE_TYPES::INT_VALUE, RAX);
+                finish();
+                break;
+            case OPCODES::BAND_OP:
+            case OPCODES::BOR_OP:
+            case OPCODES::BXOR_OP:
+                ints();
+                x.load(RAX, RBASE, payload(b));
+                x.wide(op == OPCODES::BAND_OP  ? 0x23
+                       : op == OPCODES::BOR_OP ? 0x0B
+                                               : 0x33,
+                       RAX, RBASE, payload(c));
+                result(VALUE_TYPES::INT_VALUE, RAX);
+                finish();
+                break;
+            case OPCODES::MOD_OP: {
+                ints();
+                x.compareQuad(RBASE, payload(c), 0); // only y > 0 inline
+                toSlow.push_back(x.jump(CONDITIONS::LE_CONDITION));
+                x.load(RAX, RBASE, payload(b));
+                x.cqo();
+                x.idiv(RBASE, payload(c));
+                x.testRdx(); // the sign of the divisor
+                size_t positive = x.jump(CONDITIONS::NS_CONDITION);
+                x.wide(0x03, RDX, RBASE, payload(c));
+                x.patch(positive, x.size());
+                result(VALUE_TYPES::INT_VALUE, RDX);
+                finish();
+                break;
+            }
+            case OPCODES::EQ_OP:
+            case OPCODES::NE_OP:
+            case OPCODES::SEQ_OP:
+            case OPCODES::SNE_OP:
+            case OPCODES::LT_OP:
+            case OPCODES::LE_OP:
+            case OPCODES::GT_OP:
+            case OPCODES::GE_OP: {
+                CONDITIONS condition =
+                    op == OPCODES::EQ_OP || op == OPCODES::SEQ_OP
+                        ? CONDITIONS::E_CONDITION
+                    : op == OPCODES::NE_OP || op == OPCODES::SNE_OP
+                        ? CONDITIONS::NE_CONDITION
+                    : op == OPCODES::LT_OP ? CONDITIONS::L_CONDITION
+                    : op == OPCODES::LE_OP ? CONDITIONS::LE_CONDITION
+                    : op == OPCODES::GT_OP ? CONDITIONS::G_CONDITION
+                                           : CONDITIONS::GE_CONDITION;
+                ints();
+                x.load(RAX, RBASE, payload(b));
+                x.wide(0x3B, RAX, RBASE, payload(c));
+                x.set(condition);
+                x.storeImmediate(RBASE, type(a), VALUE_TYPES::BOOL_VALUE);
+                x.store(RBASE, payload(a), RAX);
+                // a superinstruction jumps on eax right away, the jump
+                // after it is only for the slow path and for landing on
+                if (OPCODES(i & 0xFF) != op && pc + 2 < function.size) {
+                    uint32_t jump = code[pc + 1];
+                    uint32_t to = uint32_t(int64_t(pc) + 2 + int(jump >> 16)
+                                           - JUMP_BIAS);
+                    x.testAl();
+                    jumps.emplace_back(
+                        x.jump((jump & 0xFF) == OPCODES::JMPIF_OP
+                                   ? CONDITIONS::NE_CONDITION
+                                   : CONDITIONS::E_CONDITION),
+                        to);
+                    jumps.emplace_back(x.jump(), pc + 2);
+                }
+                else {
+                    toDone.push_back(x.jump());
+                }
+                finish();
+                break;
+            }
+            case OPCODES::DIV_OP:
+            case OPCODES::IDIV_OP:
+            case OPCODES::POW_OP:
+            case OPCODES::SHL_OP:
+            case OPCODES::SHR_OP:
+                slow(pc, arithmetic);
+                break;
+            case OPCODES::NEG_OP:
+            case OPCODES::POS_OP:
+            case OPCODES::NOT_OP:
+            case OPCODES::BNOT_OP: {
+                x.move(RDI, RBASE);
+                x.move32(RSI, i);
+                x.move64(RAX, reinterpret_cast<uintptr_t>(&Jit::unary));
+                x.call(RAX);
+                x.testAl();
+                size_t fine = x.jump(CONDITIONS::NE_CONDITION);
+                leave(pc);
+                x.patch(fine, x.size());
+                break;
+            }
+            case OPCODES::GETATTR_OP:
+            case OPCODES::SETATTR_OP:
+            case OPCODES::GETMETHOD_OP: {
+                x.move(RDI, VMREG);
+                x.move(RSI, RBASE);
+                x.move32(RDX, i);
+                x.move32(RCX, code[pc + 1]);
+                x.move64(RAX, reinterpret_cast<uintptr_t>(&Jit::attribute));
+                x.call(RAX);
+                x.testAl();
+                size_t fine = x.jump(CONDITIONS::NE_CONDITION);
+                leave(pc);
+                x.patch(fine, x.size());
+                break;
+            }
+            case OPCODES::EXTRA_OP: // part of the instruction before it
+                break;
+            case OPCODES::JMP_OP:
+                jumps.emplace_back(x.jump(), target);
+                break;
+            case OPCODES::JMPIF_OP:
+            case OPCODES::JMPIFNOT_OP: {
+                // bools and ints inline, anything else asks truthy()
+                CONDITIONS taken = op == OPCODES::JMPIF_OP
+                                       ? CONDITIONS::NE_CONDITION
+                                       : CONDITIONS::E_CONDITION;
+                x.compareByte(RBASE, type(a), VALUE_TYPES::BOOL_VALUE);
+                size_t notBool = x.jump(CONDITIONS::NE_CONDITION);
+                x.compareByte(RBASE, payload(a), 0);
+                jumps.emplace_back(x.jump(taken), target);
+                toDone.push_back(x.jump());
+                x.patch(notBool, x.size());
+                x.compareByte(RBASE, type(a), VALUE_TYPES::INT_VALUE);
+                size_t notInt = x.jump(CONDITIONS::NE_CONDITION);
+                x.compareQuad(RBASE, payload(a), 0);
+                jumps.emplace_back(x.jump(taken), target);
+                toDone.push_back(x.jump());
+                x.patch(notInt, x.size());
+                x.lea(RDI, RBASE, type(a));
+                x.move64(RAX, reinterpret_cast<uintptr_t>(&Jit::test));
+                x.call(RAX);
+                x.testAl();
+                jumps.emplace_back(x.jump(taken), target);
+                for (size_t at: toDone) {
+                    x.patch(at, x.size());
+                }
+                break;
+            }
+            default: // CALL, RETURN, CLASS and FORMAT are the interpreter's
+                leave(pc);
+                break;
+        }
+    }
+    for (const auto &jump: jumps) {
+        x.patch(jump.first, offsets[jump.second]);
+    }
+
+    size_t page = size_t(sysconf(_SC_PAGESIZE));
+    size_t size = (x.size() + page - 1) / page * page;
+    void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        return;
+    }
+    std::memcpy(memory, x.bytes.data(), x.size());
+    if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, size);
+        return;
+    }
+    native.code = static_cast<const uint8_t *>(memory);
+    native.size = size;
+    native.offsets = std::move(offsets);
+    this->count++;
+#else
+    (void)index;
+#endif
+}
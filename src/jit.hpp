@@ -0,0 +1,100 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "bytecode.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum JIT_MODES : uint8_t
+{
+    OFF_JIT,    // only the interpreter
+    ON_JIT,     // funs with loops are compiled once they get hot
+    ALWAYS_JIT, // every fun is compiled the first time it runs
+};
+
+// Calls of a fun plus times round its loops before it is compiled
+const uint32_t JIT_HEAT = 1000;
+
+class VM;
+
+// Baseline compiler from bytecode to x86-64, with its own assembler and
+// mmap'd pages. Native code works on the interpreter's registers, so it
+// can start at any instruction and hand back at any instruction: it runs
+// until a CALL, a RETURN or anything that would fail, and the interpreter
+// carries on from there. A loop that gets hot moves into native code on
+// its next time round. ints and bools are handled inline, everything else
+// calls into the VM. On other machines nothing is ever compiled.
+class Jit {
+  public:
+    Jit(const Program &, JIT_MODES);
+    Jit(const Jit &) = delete;
+    Jit &operator=(const Jit &) = delete;
+    ~Jit();
+    static bool supported(); // whether this build can emit code
+    // Counts a call of a fun or a time round one of its loops, true once it
+    // has native code
+    bool hot(uint32_t function) {
+        Native &native = this->functions[function];
+        if (!native.tried
+            && (this->mode == JIT_MODES::ALWAYS_JIT
+                || ++native.heat >= JIT_HEAT)) {
+            this->compile(function);
+        }
+        return native.code != nullptr;
+    }
+    bool ready(uint32_t function) const {
+        return this->functions[function].code != nullptr;
+    }
+    // Runs a fun's native code from an instruction, and returns the one the
+    // interpreter has to run next
+    uint32_t run(uint32_t function, uint32_t pc, Value *registers, VM &);
+    size_t compiled() const; // funs with native code
+
+  private:
+    typedef uint32_t (*Entry)(Value *, const Value *, Value *, VM *,
+                              const void *);
+    struct Native {
+        uint32_t heat = 0;
+        bool tried = false; // compiled, or found not worth it
+        const uint8_t *code = nullptr; // starts with the Entry
+        size_t size = 0;               // mapped bytes
+        std::vector<uint32_t> offsets; // of each instruction in code
+    };
+    const Program &program;
+    JIT_MODES mode;
+    std::vector<Native> functions;
+    size_t count = 0;
+    void compile(uint32_t);
+    static bool arithmetic(VM *, Value *, uint32_t);
+    static bool attribute(VM *, Value *, uint32_t, uint32_t);
+    static bool unary(Value *, uint32_t);
+    static bool test(const Value *);
+};
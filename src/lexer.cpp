@@ -28,348 +28,511 @@ SOFTWARE.
 #include "lexer.hpp"
 
 #include "exceptions.hpp"
+#include "simd.hpp"
+#include "sources.hpp"
+#include "tokenbuffer.hpp"
 #include "tokens.hpp"
 
 #include <algorithm>
 #include <cassert>
-#include <ctype.h>
+#include <cstdint>
 #include <iostream>
 #include <list>
 #include <memory>
 #include <regex>
 #include <string>
+#include <string_view>
 
 using std::count;
+using std::find;
 using std::cout;
 using std::endl;
 using std::list;
-using std::out_of_range;
 using std::regex_search;
-using std::smatch;
+using std::cmatch;
 using std::string;
+using std::string_view;
 using std::vector;
 
-Lexer::Lexer(string filename, string source) {
+Lexer::Lexer(string filename, string_view source, BACKENDS backend) {
     this->filename = filename;
     this->source = source;
+    this->file = SOURCES.intern(filename);
+    SOURCES.setSource(this->file, this->source);
+    this->backend = backend;
+}
+
+Lexer::Lexer(uint32_t file, string_view source, BACKENDS backend) {
+    this->filename = SOURCES.filename(file);
+    this->source = source;
+    this->file = file;
+    this->backend = backend;
+}
+
+void Lexer::feed(string_view window, size_t base, bool final) {
+    this->source = window;
+    this->base = base;
+    this->final = final;
+    SOURCES.setSource(this->file, window, base);
+    SOURCES.indexLines(this->file); // the window may be gone by the lookup
+}
+
+bool Lexer::starved() const {
+    return this->hungry;
+}
+
+size_t Lexer::consumed() const {
+    return this->pos - 1;
+}
+
+uint32_t Lexer::fileId() const {
+    return this->file;
+}
+
+size_t Lexer::offset() const {
+    return this->pos - 1 - this->base;
 }
 
 char Lexer::getChar() const {
-    try {
-        return source.at(this->pos - 1);
-    }
-    catch (const out_of_range &) {
-        return EOF;
-    }
+    return this->nextChar(0);
 }
 
 char Lexer::nextChar(int offset) const {
-    try {
-        return source.at(this->pos + offset - 1);
-    }
-    catch (const out_of_range &) {
-        return EOF;
+    size_t index = this->offset() + offset;
+    if (index < this->source.size()) {
+        return this->source[index];
     }
+    return EOF;
 }
 
 bool Lexer::next() const {
-    try {
-        source.at(this->pos - 1);
-        return true;
+    return this->offset() < this->source.size();
+}
+
+Token Lexer::error(uint32_t length, string message) {
+    this->diagnostics.report(this->file, this->pos, message);
+    Token token{this->file, this->pos, TOKENS::ERROR, length};
+    this->pos += length;
+    return token;
+}
+
+uint32_t Lexer::restOfLine(char stop) const {
+    size_t start = this->offset();
+    size_t end = this->source.find_first_of(string{'\n', stop}, start + 1);
+    if (end == string_view::npos) {
+        return this->source.size() - start;
     }
-    catch (const out_of_range &) {
-        return false;
+    if (this->source[end] == stop) {
+        end++;
+    }
+    return end - start;
+}
+
+// std::regex recurses once per character it matches, so a long string or
+// comment would overflow the stack. The regex only sees this much of the
+// source, and a match that might run past it is finished by search().
+static const size_t REGEX_WINDOW = 4096;
+
+size_t Lexer::match(DFA_STATES start,
+                    const std::basic_regex<char> &regex) const {
+    const char *begin = this->source.data() + this->offset();
+    const char *end = this->source.data() + this->source.size();
+    if (this->backend == BACKENDS::DFA) {
+        return this->search(start, begin, end);
+    }
+    size_t left = size_t(end - begin);
+    const char *stop = left > REGEX_WINDOW ? begin + REGEX_WINDOW : end;
+    cmatch m;
+    bool found = regex_search(begin, stop, m, regex,
+                              std::regex_constants::match_continuous);
+    if (found && (stop == end || m.length() < stop - begin)) {
+        return m.length();
+    }
+    if (stop != end) {
+        return this->search(start, begin, end);
+    }
+    this->hitEnd = true; // can't tell how far the regex looked
+    return 0;
+}
+
+size_t Lexer::search(DFA_STATES start, const char *begin,
+                     const char *end) const {
+    switch (start) { // bodies that can be skipped with a byte search
+        case DFA_STATES::STRING_START: {
+            const char *close = findByte(begin + 1, end, '"');
+            this->hitEnd = close == end;
+            return close == end ? 0 : close - begin + 1;
+        }
+        case DFA_STATES::CMT_START:
+            return findEither(begin + 1, end, '\n', '\r') - begin;
+        case DFA_STATES::MULTI_CMT_START: {
+            const char *close = findPair(begin + 2, end, '*', '/');
+            this->hitEnd = close == end;
+            return close == end ? 0 : close - begin + 2;
+        }
+        default:
+            return scanDFA(start, begin, end);
     }
 }
+
 Token Lexer::processIdent() {
-    smatch m;
-    string code = source.substr(this->pos - 1);
-    bool search = regex_search(code, m, IDENT_RE);
-    if (search) {
-        int tmp = this->pos;
-        int tmp2 = this->lpos;
-        this->pos += m.length();
-        this->lpos += m.length();
-        return Token{this->filename, this->line,    tmp,
-                     tmp2,           TOKENS::IDENT, m.str()};
+    uint32_t length = this->match(DFA_STATES::IDENT_START, IDENT_RE);
+    if (length) {
+        Token token{this->file, this->pos, TOKENS::IDENT, length};
+        token.keyword = KEYWORD_TABLE.match(
+            this->source.data() + this->offset(), length);
+        this->pos += length;
+        return token;
     }
     else {
-        throw UnknownToken(this->filename, this->line, this->lpos,
-                           string("Unknown symbol (id): '") + this->getChar()
-                               + '\'');
+        return this->error(1, string("Unknown symbol (id): '")
+                                  + this->getChar() + '\'');
     }
 }
 
 Token Lexer::processString() {
-    smatch m;
-    string code = source.substr(this->pos - 1);
-    bool search = regex_search(code, m, STRING_RE);
-    if (search) {
-        int tmp = this->pos;
-        int tmp2 = this->lpos;
-        this->pos += m.length();
-        this->lpos += m.length();
-        return Token{this->filename, this->line,     tmp,
-                     tmp2,           TOKENS::STRING, m.str()};
+    uint32_t length = this->match(DFA_STATES::STRING_START, STRING_RE);
+    if (length) {
+        uint32_t tmp = this->pos;
+        this->pos += length;
+        return Token{this->file, tmp, TOKENS::STRING, length};
     }
     else {
-        throw UnknownToken(this->filename, this->line, this->lpos,
-                           string("Unknown symbol (str): '") + this->getChar()
-                               + '\'');
+        return this->error(this->restOfLine('"'), "Unterminated string");
+    }
+}
+
+// Between the quotes of an f-string and outside its braces: the closing
+// quote, the brace opening an expression or the text up to either. The
+// text is one token however many {{ and }} it has. As in a string, a
+// backslash does not stop the quote or a brace from ending it.
+Token Lexer::processFText() {
+    const char *begin = this->source.data() + this->offset();
+    const char *end = this->source.data() + this->source.size();
+    uint32_t tmp = this->pos;
+    if (*begin == '"') {
+        this->pos++;
+        return Token{this->file, tmp, TOKENS::FEND, 1};
+    }
+    const char *at = begin;
+    while (at < end && *at != '"') {
+        if (*at == '{' || *at == '}') {
+            if (at + 1 == end) { // doubled or not is in the next window
+                this->hitEnd = true;
+                break;
+            }
+            if (at[1] != *at) {
+                break;
+            }
+            at++;
+        }
+        at++;
     }
+    if (at == end) {
+        this->hitEnd = true;
+        // runs to the end of the file
+        return this->error(end - begin, "Unterminated f-string");
+    }
+    if (at != begin) {
+        this->pos += at - begin;
+        return Token{this->file, tmp, TOKENS::FTEXT, uint32_t(at - begin)};
+    }
+    if (*at == '}') {
+        return this->error(1, "Single '}' in an f-string, '}}' writes one");
+    }
+    this->pos++;
+    return Token{this->file, tmp, TOKENS::LBRACE, 1};
 }
 
 Token Lexer::processNumber() {
-    smatch m;
-    string code = source.substr(this->pos - 1);
-    bool search = regex_search(code, m, NUMBER_RE);
-    if (search) {
-        int tmp = this->pos;
-        int tmp2 = this->lpos;
-        this->pos += m.length();
-        this->lpos += m.length();
-        return Token{this->filename, this->line,     tmp,
-                     tmp2,           TOKENS::NUMBER, m.str()};
+    uint32_t length = this->match(DFA_STATES::NUMBER_START, NUMBER_RE);
+    if (length) {
+        uint32_t tmp = this->pos;
+        this->pos += length;
+        return Token{this->file, tmp, TOKENS::NUMBER, length};
     }
     else {
-        throw UnknownToken(this->filename, this->line, this->lpos,
-                           string("Unknown symbol (num): '") + this->getChar()
-                               + '\'');
+        return this->error(1, string("Unknown symbol (num): '")
+                                  + this->getChar() + '\'');
     }
 }
 
 Token Lexer::processChar() {
-    smatch m;
-    string code = source.substr(this->pos - 1);
-    bool search = regex_search(code, m, CHAR_RE);
-    if (search) {
-        int tmp = this->pos;
-        int tmp2 = this->lpos;
-        this->pos += m.length();
-        this->lpos += m.length();
-        return Token{this->filename, this->line,   tmp,
-                     tmp2,           TOKENS::CHAR, m.str()};
+    uint32_t length = this->match(DFA_STATES::CHAR_START, CHAR_RE);
+    if (length) {
+        uint32_t tmp = this->pos;
+        this->pos += length;
+        return Token{this->file, tmp, TOKENS::CHAR, length};
     }
     else {
-        throw UnknownToken(this->filename, this->line, this->lpos,
-                           string("Unknown symbol (char): '") + this->getChar()
-                               + '\'');
+        return this->error(this->restOfLine('\''),
+                           "Character literals hold exactly one character");
     }
 }
 
 Token Lexer::processSymbol() {
-    char c = this->getChar();
-    char c2 = this->nextChar(1);
-    if (c2 == EOF) {
-        try {
-            int tmp = this->pos;
-            int tmp2 = this->lpos;
-            this->pos++;
-            this->lpos++;
-            return Token(this->filename, this->line, tmp, tmp2,
-                         SYMBOLS.at(string{c}), "");
-        }
-        catch (const out_of_range &e) {
-            this->pos--;
-            this->lpos--;
-            throw UnknownToken{this->filename, this->line, this->lpos,
-                               string("Unknown symbol (sym-1): '") + c + '\''};
-        }
+    const char *begin = this->source.data() + this->offset();
+    const char *end = this->source.data() + this->source.size();
+    TOKENS type;
+    uint32_t length = SYMBOL_TRIE.match(begin, end, type);
+    this->hitEnd = end - begin < SYMBOL_TRIE.longest;
+    if (length) {
+        uint32_t tmp = this->pos;
+        this->pos += length;
+        return Token(this->file, tmp, type, length);
     }
-    char c3 = this->nextChar(2);
-    if (c3 == EOF) {
-        try {
-            int tmp = this->pos;
-            int tmp2 = this->lpos;
-            this->pos += 2;
-            this->lpos += 2;
-            return Token(this->filename, this->line, tmp, tmp2,
-                         SYMBOLS.at(string{string() + c + c2}), "");
-        }
-        catch (const out_of_range &e) {
-            this->pos -= 2;
-            this->lpos -= 2;
-            throw UnknownToken{this->filename, this->line, this->lpos,
-                               string("Unknown symbol (sym-2): '") + c + '\''
-                                   + c2};
-        }
+    return this->error(1, string("Unknown symbol (sym): '") + this->getChar()
+                              + '\'');
+}
+
+Lexer::STEPS Lexer::step(Token &token) {
+    char c = this->getChar();
+    const vector<char> &brackets = this->lexState.brackets;
+    if (!brackets.empty() && brackets.back() == '"') {
+        token = processFText();
     }
-    try {
-        int tmp = this->pos;
-        int tmp2 = this->lpos;
-        this->pos += 3;
-        this->lpos += 3;
-        return Token(this->filename, this->line, tmp, tmp2,
-                     SYMBOLS.at(string{string() + c + c2 + c3}), "");
-    }
-    catch (const out_of_range &e) {
-        this->pos -= 3;
-        this->lpos -= 3;
-        try {
-            int tmp = this->pos;
-            int tmp2 = this->lpos;
-            this->pos += 2;
-            this->lpos += 2;
-            return Token(this->filename, this->line, tmp, tmp2,
-                         SYMBOLS.at(string{string() + c + c2}), "");
-        }
-        catch (const out_of_range &e) {
-            this->pos -= 2;
-            this->lpos -= 2;
-            try {
-                int tmp = this->pos;
-                int tmp2 = this->lpos;
+    else if (CHAR_KINDS[c] == SPACE_CHAR) {
+        if (c == '\n') {
+            uint32_t tmp = this->pos;
+            while (this->nextChar(1) == '\n') {
                 this->pos++;
-                this->lpos++;
-                return Token(this->filename, this->line, tmp, tmp2,
-                             SYMBOLS.at(string{string() + c}), "");
             }
-            catch (const out_of_range &e) {
-                this->pos--;
-                this->lpos--;
-                throw UnknownToken{this->filename, this->line, this->lpos,
-                                   string("Unknown symbol (sym-1): '") + c
-                                       + '\''};
+            this->pos++;
+            if (this->lexState.ignore_nl) {
+                return STEPS::SKIPPED;
             }
+            token = Token{this->file, tmp, TOKENS::NL, 1};
+            return STEPS::TOKEN;
         }
+        const char *begin = this->source.data() + this->offset();
+        const char *end = this->source.data() + this->source.size();
+        this->pos += skipBlanks(begin, end) - begin;
+        return STEPS::BLANK;
+    }
+    else if (c == '#') {
+        // always matches, "#" on its own is an empty comment. The newline
+        // after it is left for the next step.
+        this->pos += this->match(DFA_STATES::CMT_START, CMT_RE);
+        return STEPS::SKIPPED;
+    }
+    else if (c == '/' and this->nextChar(1) == '*') {
+        size_t length = this->match(DFA_STATES::MULTI_CMT_START, MULTI_CMT_RE);
+        if (length) {
+            this->pos += length;
+            return STEPS::SKIPPED;
+        }
+        // runs to the end of the file
+        token = this->error(this->source.size() - this->offset(),
+                            "Unterminated comment");
+    }
+    else if (c == '"') {
+        token = processString();
+    }
+    else if (c == '\'') {
+        token = processChar();
+    }
+    else if (c == 'f' && this->nextChar(1) == '"') {
+        token = Token{this->file, this->pos, TOKENS::FSTART, 2};
+        this->pos += 2;
+    }
+    else if (CHAR_KINDS[c] == SYMBOL_CHAR) {
+        token = processSymbol();
+    }
+    else if (CHAR_KINDS[c] == NUMBER_CHAR) {
+        token = processNumber();
+    }
+    else if (CHAR_KINDS[c] == IDENT_CHAR) {
+        token = processIdent();
     }
+    else {
+        token = this->error(1, string("Unknown symbol: '") + c + '\'');
+    }
+    return STEPS::TOKEN;
 }
 
-vector<Token> Lexer::tokenize() {
-    bool ignore_nl = false;
-    vector<Token> tokens{};
-    vector<char> brackets{};
-    while (next()) {
-        char c = this->getChar();
-        if (c == EOF) {
+LexState::RESULTS LexState::track(TOKENS type, char &expected) {
+    char c;
+    switch (type) {
+        case TOKENS::LPAR:
+            c = '(';
             break;
-        }
-        else if (isspace(c)) {
-            if (c == '\n') {
-                int tmp = this->pos;
-                int tmp2 = this->lpos;
-                int tmp3 = this->line;
-                for (int i = 1; this->nextChar(i) == '\n'; i++) {
-                    this->line++;
-                    this->pos++;
-                }
-                this->pos++;
-                this->line++;
-                this->lpos = 1;
-                if (!ignore_nl) {
-                    tokens.push_back(Token{this->filename, tmp3, tmp, tmp2,
-                                           TOKENS::NL, string("\n")});
-                }
-            }
-            else {
-                this->lpos++;
-                this->pos++;
-            }
-        }
-        else if (c == '#') {
-            smatch m;
-            string code = source.substr(this->pos - 1);
-            bool search = regex_search(code, m, CMT_RE);
-            if (search) {
-                this->pos += m.length();
-                this->lpos = 0;
-                this->line++;
+        case TOKENS::LSQB:
+            c = '[';
+            break;
+        case TOKENS::LBRACE:
+            c = '{';
+            break;
+        case TOKENS::RPAR:
+            c = ')';
+            break;
+        case TOKENS::RSQB:
+            c = ']';
+            break;
+        case TOKENS::RBRACE:
+            c = '}';
+            break;
+        case TOKENS::FSTART:
+            c = '"';
+            break;
+        case TOKENS::FEND: // only lexed with the '"' on top
+            this->brackets.pop_back();
+            this->ignore_nl = count(this->brackets.begin(),
+                                    this->brackets.end(), '(')
+                              || count(this->brackets.begin(),
+                                       this->brackets.end(), '[')
+                              || count(this->brackets.begin(),
+                                       this->brackets.end(), '"');
+            return RESULTS::FINE;
+        default:
+            return RESULTS::FINE;
+    }
+    vector<char> &brackets = this->brackets;
+    RESULTS result = RESULTS::FINE;
+    switch (c) {
+        case '(':
+        case '[':
+        case '{':
+        case '"':
+            if (brackets.size() > MAXLEVEL) {
+                return RESULTS::TOO_DEEP;
             }
-            else {
-                throw UnknownToken{this->filename, this->line, this->lpos,
-                                   string("Unknown symbol (cmt): '") + c
-                                       + '\''};
+            brackets.push_back(c);
+            break;
+        case ')':
+        case ']':
+        case '}': {
+            char open = c == ')' ? '(' : c == ']' ? '[' : '{';
+            if (brackets.empty()) {
+                result = RESULTS::UNOPENED;
+                break;
             }
-        }
-        else if (c == '/' and this->nextChar(1) == '*') {
-            smatch m;
-            string code = source.substr(this->pos - 1);
-            bool search = regex_search(code, m, MULTI_CMT_RE);
-            if (search) {
-                this->pos += m.length();
-                string::iterator b = m.str().begin();
-                string::iterator e = m.str().end();
-                int newlines = count(b, e, '\n');
-                this->line += newlines;
-                size_t found = m.str().find_last_of('\n');
-                if (found != string::npos) {
-                    this->lpos += (m.str().length() - found);
+            if (brackets.back() != open) {
+                result = RESULTS::MISMATCHED;
+                expected = brackets.back();
+                // recover by closing everything opened since the matching
+                // bracket, or nothing if there is none. Brackets outside
+                // the f-string the closing is in can't match it.
+                auto outside = find(brackets.rbegin(), brackets.rend(), '"');
+                auto match = find(brackets.rbegin(), outside, open);
+                if (match != outside) {
+                    brackets.erase(match.base(), brackets.end());
+                }
+                else {
+                    break;
                 }
             }
-            else {
-                throw UnknownToken{this->filename, this->line, this->lpos,
-                                   string("Unknown symbol (m-cmt): '") + c
-                                       + '\''};
-            }
-        }
-        else if (c == '"') {
-            tokens.push_back(processString());
-        }
-        else if (c == '\'') {
-            tokens.push_back(processChar());
+            brackets.pop_back();
+            break;
         }
-        else if (SYMS.find(c) != string::npos) {
-            tokens.push_back(processSymbol());
-            switch (c) {
-                case '(':
-                case '[':
-                case '{':
-                    if (brackets.size() > MAXLEVEL) {
-                        throw TooManyBrackets(
-                            this->filename, this->line, this->lpos,
-                            string("Too many brackets, MAXLEVEL is"
-                                   + MAXLEVEL));
-                    }
-                    brackets.push_back(c);
-                    break;
-                case ')':
-                case ']':
-                case '}':
-                    if (brackets.empty()) {
-                        throw UnmatchedBracket(
-                            this->filename, this->line, this->lpos,
-                            string("Bracket mismatch, there is no opening"));
-                    }
-                    if (!((brackets.back() == '(' && c == ')')
-                          || (brackets.back() == '[' && c == ']')
-                          || (brackets.back() == '{' && c == '}'))) {
-                        throw UnmatchedBracket(
-                            this->filename, this->line, this->lpos,
-                            string("Bracket mismatch, expected '")
-                                + brackets.back() + "'");
-                    }
-                    brackets.pop_back();
-                    break;
+    }
+    switch (c) {
+        case '(':
+        case '[':
+        case '"': // newlines in the braces of an f-string are ignored too
+            this->ignore_nl = true;
+            break;
+        case ')':
+        case ']':
+            if (!(count(brackets.begin(), brackets.end(), '(')
+                  || count(brackets.begin(), brackets.end(), '[')
+                  || count(brackets.begin(), brackets.end(), '"'))) {
+                this->ignore_nl = false;
             }
-            switch (c) {
-                case '(':
-                case '[':
-                    ignore_nl = true;
-                    break;
-                case ')':
-                case ']':
-                    if (!(count(brackets.begin(), brackets.end(), '(')
-                          || count(brackets.begin(), brackets.end(), '['))) {
-                        ignore_nl = false;
-                    }
-                    else if ((brackets.back() == '(' && c == ')')
-                             || (brackets.back() == '[' && c == ']')
-                             || (brackets.back() == '{' && c == '}')) {
-                        ignore_nl = false;
-                    }
-                    break;
+            else if ((brackets.back() == '(' && c == ')')
+                     || (brackets.back() == '[' && c == ']')
+                     || (brackets.back() == '{' && c == '}')) {
+                this->ignore_nl = false;
             }
+            break;
+    }
+    return result;
+}
+
+bool LexState::operator==(const LexState &other) const {
+    return this->ignore_nl == other.ignore_nl
+           && this->brackets == other.brackets;
+}
+
+bool LexState::operator!=(const LexState &other) const {
+    return !(*this == other);
+}
+
+void Lexer::trackBracket(const Token &token) {
+    char expected;
+    switch (this->lexState.track(token.type, expected)) {
+        case LexState::TOO_DEEP:
+            throw TooManyBrackets(this->filename, token.line(), token.lpos(),
+                                  "Too many brackets, MAXLEVEL is "
+                                      + std::to_string(MAXLEVEL));
+        case LexState::UNOPENED:
+            this->diagnostics.report(this->file, token.pos,
+                                     "Bracket mismatch, there is no opening");
+            break;
+        case LexState::MISMATCHED:
+            this->diagnostics.report(
+                this->file, token.pos,
+                string("Bracket mismatch, expected closing for '") + expected
+                    + "'");
+            break;
+        case LexState::FINE:
+            break;
+    }
+}
+
+const LexState &Lexer::state() const {
+    return this->lexState;
+}
+
+void Lexer::resume(uint32_t pos, const LexState &state) {
+    this->pos = pos;
+    this->lexState = state;
+}
+
+bool Lexer::nextToken(Token &token) {
+    this->hungry = false;
+    if (this->base + this->source.size() > MAXSOURCE) {
+        uint32_t line = 1, lpos = 1;
+        if (this->pos > 1) {
+            SOURCES.position(this->file, this->pos - 1, line, lpos);
         }
-        else if (NUMS.find(c) != string::npos) {
-            tokens.push_back(processNumber());
-        }
-        else if (IDENTS.find(c) != string::npos) {
-            tokens.push_back(processIdent());
+        throw SourceTooBig(this->filename, line, lpos,
+                           "Source too big, MAXSOURCE is 4 GiB");
+    }
+    while (this->next()) {
+        uint32_t pos = this->pos;
+        size_t reported = this->diagnostics.size();
+        this->hitEnd = false;
+        STEPS step = this->step(token);
+        // anything but blanks that ran into the end of a partial window may
+        // turn out differently with the next chunk, so undo it and wait
+        if (!this->final && step != STEPS::BLANK
+            && (this->hitEnd || this->offset() >= this->source.size())) {
+            this->pos = pos;
+            this->diagnostics.truncate(reported);
+            this->hungry = true;
+            return false;
         }
-        else {
-            throw UnknownToken{this->filename, this->line, this->lpos,
-                               string("Unknown symbol: '") + c + '\''};
+        if (step == STEPS::TOKEN) {
+            this->trackBracket(token);
+            return true;
         }
     }
+    this->hungry = !this->final;
+    return false;
+}
+
+vector<Token> Lexer::tokenize() {
+    vector<Token> tokens{};
+    Token token;
+    while (this->nextToken(token)) {
+        tokens.push_back(token);
+    }
     return tokens;
 }
+
+void Lexer::tokenize(TokenBuffer &tokens) {
+    Token token;
+    while (this->nextToken(token)) {
+        tokens.push(token);
+    }
+}
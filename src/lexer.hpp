@@ -27,30 +27,100 @@ SOFTWARE.
 
 #pragma once
 
+#include "dfa.hpp"
+#include "diagnostics.hpp"
+#include "tokenbuffer.hpp"
 #include "tokens.hpp"
 
+#include <cstdint>
+#include <regex>
 #include <string>
+#include <string_view>
 #include <vector>
 
 const int MAXLEVEL = 200;
+// Token::pos is the byte offset plus 1 in 32 bits, longer sources are
+// refused rather than wrapped
+const size_t MAXSOURCE = UINT32_MAX - 1;
+
+enum BACKENDS
+{
+    REGEX, // std::regex over the rest of the source, the reference
+    DFA,   // table-driven scanner from dfa.hpp
+};
+
+// What the lexer carries from one token to the next besides its position,
+// equal states lex the same text the same way.
+struct LexState {
+    enum RESULTS
+    {
+        FINE,
+        TOO_DEEP,   // an opening past MAXLEVEL, the state is left as it was
+        UNOPENED,   // a closing with nothing open
+        MISMATCHED, // a closing for another bracket, expected is set
+    };
+    // open brackets, and '"' for each f-string whose text is being lexed
+    // in between the braces of its expressions
+    std::vector<char> brackets;
+    bool ignore_nl = false;
+    // Updates the state after a token of the given type
+    RESULTS track(TOKENS, char &expected);
+    bool operator==(const LexState &) const;
+    bool operator!=(const LexState &) const;
+};
 
 class Lexer {
   public:
     std::vector<Token> tokenize();
-    Lexer(std::string, std::string);
+    void tokenize(TokenBuffer &); // appends to the columns instead
+    // Pulls the next token, false once the window is used up. For a window
+    // fed with final set to false, starved() then says more input is needed.
+    bool nextToken(Token &);
+    Lexer(std::string, std::string_view, BACKENDS = BACKENDS::DFA);
+    // Lexes a file already in SOURCES, leaving its entry there as it is
+    Lexer(uint32_t, std::string_view, BACKENDS = BACKENDS::DFA);
+    // Replaces the source with the bytes starting at offset base of the
+    // file. Lexing resumes where it stopped, which must be inside window.
+    void feed(std::string_view, size_t, bool);
+    bool starved() const;
+    size_t consumed() const; // bytes before the next token to lex
+    uint32_t fileId() const; // in SOURCES
+    const LexState &state() const;
+    // Continues lexing from a token start with the state saved there
+    void resume(uint32_t pos, const LexState &);
+    Diagnostics diagnostics;
 
   private:
-    int pos = 1;
-    int line = 1;
-    int lpos = 1;
+    enum STEPS
+    {
+        BLANK,   // skipped spaces
+        SKIPPED, // skipped a comment or an ignored newline
+        TOKEN,   // produced a token
+    };
+    uint32_t pos = 1;
     bool next() const;
-    std::string source;
+    std::string_view source;
+    size_t base = 0;
+    bool final = true;
+    bool hungry = false;
+    mutable bool hitEnd = false; // the current step looked past the window
+    LexState lexState;
     Token processChar();
     std::string filename;
+    uint32_t file;
+    BACKENDS backend;
     char getChar() const;
     Token processIdent();
     Token processString();
+    Token processFText();
     Token processNumber();
     Token processSymbol();
     char nextChar(int) const;
+    size_t offset() const;
+    Token error(uint32_t, std::string);
+    uint32_t restOfLine(char) const;
+    size_t match(DFA_STATES, const std::basic_regex<char> &) const;
+    size_t search(DFA_STATES, const char *, const char *) const;
+    STEPS step(Token &);
+    void trackBracket(const Token &);
 };
@@ -0,0 +1,161 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "names.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using std::string_view;
+using std::vector;
+
+NameTable NAMES;
+
+// Identifiers are short, so this reads them a word at a time and mixes
+// only once at the end
+static uint32_t hashName(string_view name) {
+    const uint64_t PRIME = 0x9E3779B97F4A7C15;
+    uint64_t h = name.size() * PRIME;
+    size_t i = 0;
+    for (; i + 8 <= name.size(); i += 8) {
+        uint64_t word;
+        memcpy(&word, name.data() + i, 8);
+        h = (h ^ word) * PRIME;
+        h ^= h >> 29;
+    }
+    if (i < name.size()) {
+        uint64_t word = 0;
+        memcpy(&word, name.data() + i, name.size() - i);
+        h = (h ^ word) * PRIME;
+    }
+    h ^= h >> 32;
+    return uint32_t(h);
+}
+
+uint32_t NameTable::find(string_view name, uint32_t hash,
+                         size_t &slot) const {
+    if (this->slots.empty()) {
+        return NO_NAME;
+    }
+    size_t mask = this->slots.size() - 1;
+    for (slot = hash & mask;; slot = (slot + 1) & mask) {
+        const Slot &at = this->slots[slot];
+        if (at.id == NO_NAME) {
+            return NO_NAME;
+        }
+        if (at.hash == hash && this->views[at.id] == name) {
+            return at.id;
+        }
+    }
+}
+
+void NameTable::grow() {
+    std::vector<Slot> old = std::move(this->slots);
+    this->slots.assign(old.empty() ? 1024 : old.size() * 2, Slot{});
+    size_t mask = this->slots.size() - 1;
+    for (const Slot &at: old) {
+        if (at.id == NO_NAME) {
+            continue;
+        }
+        size_t slot = at.hash & mask;
+        while (this->slots[slot].id != NO_NAME) {
+            slot = (slot + 1) & mask;
+        }
+        this->slots[slot] = at;
+    }
+}
+
+uint32_t NameTable::add(string_view name, uint32_t hash) {
+    if (2 * (this->views.size() + 1) > this->slots.size()) {
+        this->grow();
+    }
+    // another parser may have added it while the lock was let go
+    size_t slot = 0;
+    uint32_t id = this->find(name, hash, slot);
+    if (id != NO_NAME) {
+        return id;
+    }
+    id = this->views.size();
+    this->names.emplace_back(name);
+    this->views.push_back(this->names.back());
+    this->slots[slot] = Slot{hash, id};
+    return id;
+}
+
+uint32_t NameTable::intern(string_view name) {
+    uint32_t hash = hashName(name);
+    {
+        std::shared_lock<std::shared_mutex> guard{this->lock};
+        size_t slot;
+        uint32_t id = this->find(name, hash, slot);
+        if (id != NO_NAME) {
+            return id;
+        }
+    }
+    std::unique_lock<std::shared_mutex> guard{this->lock};
+    return this->add(name, hash);
+}
+
+void NameTable::intern(const vector<string_view> &names,
+                       vector<uint32_t> &ids) {
+    ids.resize(names.size());
+    vector<uint32_t> hashes(names.size());
+    bool missing = false;
+    {
+        std::shared_lock<std::shared_mutex> guard{this->lock};
+        for (size_t i = 0; i < names.size(); i++) {
+            hashes[i] = hashName(names[i]);
+            size_t slot;
+            ids[i] = this->find(names[i], hashes[i], slot);
+            missing = missing || ids[i] == NO_NAME;
+        }
+    }
+    if (!missing) {
+        return;
+    }
+    std::unique_lock<std::shared_mutex> guard{this->lock};
+    for (size_t i = 0; i < names.size(); i++) {
+        if (ids[i] == NO_NAME) {
+            ids[i] = this->add(names[i], hashes[i]);
+        }
+    }
+}
+
+string_view NameTable::name(uint32_t id) const {
+    std::shared_lock<std::shared_mutex> guard{this->lock};
+    return this->views[id];
+}
+
+size_t NameTable::size() const {
+    std::shared_lock<std::shared_mutex> guard{this->lock};
+    return this->views.size();
+}
@@ -0,0 +1,71 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Marks a token that names nothing, e.g. a keyword or an operator
+const uint32_t NO_NAME = UINT32_MAX;
+
+// Interns identifiers into dense 32-bit ids, so passes after the parser
+// compare and hash an int instead of the text. An id is the same in every
+// file and the text behind it never moves. Lookups go through an open
+// addressing table of hashes and ids, probed linearly. Safe to use from
+// several parsers at once.
+class NameTable {
+  public:
+    uint32_t intern(std::string_view);
+    // Interns every name at once, taking the lock once rather than per
+    // name. ids gets the id of each, in order.
+    void intern(const std::vector<std::string_view> &,
+                std::vector<uint32_t> &ids);
+    std::string_view name(uint32_t) const;
+    size_t size() const;
+
+  private:
+    struct Slot {
+        uint32_t hash;
+        uint32_t id = NO_NAME;
+    };
+    std::deque<std::string> names;
+    std::vector<std::string_view> views; // of names, by id
+    std::vector<Slot> slots;             // a power of two, at most half full
+    mutable std::shared_mutex lock;
+    // The id of a name, or NO_NAME with slot set to where it would go
+    uint32_t find(std::string_view, uint32_t, size_t &slot) const;
+    uint32_t add(std::string_view, uint32_t); // with the lock held
+    void grow();
+};
+
+extern NameTable NAMES;
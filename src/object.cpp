@@ -0,0 +1,82 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "object.hpp"
+
+#include "bytecode.hpp"
+
+#include <cstdint>
+#include <memory>
+
+uint32_t Shape::slot(uint32_t name) const {
+    for (uint32_t i = 0; i < this->names.size(); i++) {
+        if (this->names[i] == name) {
+            return i;
+        }
+    }
+    return NO_SLOT;
+}
+
+Shape *Shape::add(uint32_t name) {
+    for (const std::unique_ptr<Shape> &child: this->children) {
+        if (child->names.back() == name) {
+            return child.get();
+        }
+    }
+    this->children.push_back(std::make_unique<Shape>(this->owner));
+    Shape *child = this->children.back().get();
+    child->names = this->names;
+    child->names.push_back(name);
+    return child;
+}
+
+Class::Class(uint32_t name, CLASS_KINDS kind, Class *base)
+    : name(name), kind(kind), base(base),
+      root(std::make_unique<Shape>(this)),
+      members(std::make_unique<Shape>(this)), initial(root.get()) {
+}
+
+const Value *Class::find(uint32_t name) const {
+    for (const Class *klass = this; klass; klass = klass->base) {
+        uint32_t slot = klass->members->slot(name);
+        if (slot != NO_SLOT) {
+            return &klass->values[slot];
+        }
+    }
+    return nullptr;
+}
+
+const char *kindName(CLASS_KINDS kind) {
+    switch (kind) {
+        case CLASS_KINDS::STRUCT_KIND:
+            return "struct";
+        case CLASS_KINDS::ENUM_KIND:
+            return "enum";
+        default:
+            return "class";
+    }
+}
@@ -0,0 +1,106 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "bytecode.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+const uint32_t NO_SLOT = UINT32_MAX;
+
+// Shapes an attribute site remembers before it stops caching
+const uint32_t CACHE_ENTRIES = 4;
+
+// The layout of an object: the NAMES id of the field in each slot. Adding
+// a field moves an object to the child shape for that name, so objects
+// given the same fields in the same order share one shape and a field's
+// slot is known from the shape alone. Each class grows its own tree, so a
+// shape also tells which class an object belongs to.
+struct Shape {
+    explicit Shape(Class *owner) : owner(owner) {}
+    Class *owner;
+    std::vector<uint32_t> names;
+    std::vector<std::unique_ptr<Shape>> children;
+    uint32_t slot(uint32_t name) const; // or NO_SLOT
+    Shape *add(uint32_t name);          // made the first time it is asked for
+};
+
+// Lives in an OBJECT_CELL of the Heap, followed by room for inlined
+// fields. Its slots are there until it outgrows them, then in a
+// SLOTS_CELL. Slots past the fields of the shape hold None.
+struct Object {
+    Shape *shape;
+    Value *slots; // room() or a SLOTS_CELL
+    uint32_t capacity;
+    uint32_t inlined; // slots in room()
+    Value *room() {
+        return reinterpret_cast<Value *>(this + 1);
+    }
+};
+
+// Made by a CLASS instruction and never changed after but for room. The
+// members of a class are its funs and attributes, those of an enum its
+// values. A struct has no members, its fields and their defaults are what
+// its objects start with.
+struct Class {
+    Class(uint32_t name, CLASS_KINDS kind, Class *base);
+    Class(const Class &) = delete; // its shapes point back at it
+    Class &operator=(const Class &) = delete;
+    uint32_t name; // NAMES id
+    CLASS_KINDS kind;
+    Class *base;
+    std::unique_ptr<Shape> root;    // objects start with no fields
+    std::unique_ptr<Shape> members; // names of the members, by slot
+    std::vector<Value> values;      // of the members
+    Shape *initial;                 // where objects start, root or fields
+    std::vector<Value> defaults;    // of the fields
+    const Value *constructor = nullptr; // the member named like its class
+    uint32_t room = 0; // most fields an object grew to, new ones get as many
+    // A member of the class or else of its bases, nullptr if none has it
+    const Value *find(uint32_t name) const;
+};
+
+const char *kindName(CLASS_KINDS); // class, struct or enum
+
+// What an attribute site has seen, one entry per shape. A site that only
+// sees one shape (monomorphic) hits on its first entry, one that sees a
+// few (polymorphic) on one of the first CACHE_ENTRIES, and after that
+// (megamorphic) everything is looked up in the shapes.
+struct Cache {
+    struct Entry {
+        const Shape *shape;
+        Shape *next;        // after a SETATTR that adds the field
+        const Value *value; // a member, or nullptr for the field in slot
+        uint32_t slot;
+    };
+    uint32_t name; // NAMES id
+    uint32_t count = 0;
+    Entry entries[CACHE_ENTRIES];
+};
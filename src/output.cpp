@@ -0,0 +1,126 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "output.hpp"
+#include "tokens.hpp"
+
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <streambuf>
+#include <unistd.h>
+
+using std::streamsize;
+
+OutputBuffer::OutputBuffer(int fd, size_t capacity) : fd(fd) {
+    this->block.resize(capacity ? capacity : 1);
+    this->setp(this->block.data(), this->block.data() + this->block.size());
+}
+
+OutputBuffer::~OutputBuffer() {
+    this->flush();
+}
+
+bool OutputBuffer::failed() const {
+    return this->error;
+}
+
+void OutputBuffer::token(size_t index, const Token &token) {
+    // 20 digits, ": " and the newline
+    size_t need = token.formatSize() + 23;
+    if (size_t(this->epptr() - this->pptr()) < need) {
+        this->flush();
+        if (this->block.size() < need) { // one huge token, e.g. a string
+            this->block.resize(need);
+            this->setp(this->block.data(),
+                       this->block.data() + this->block.size());
+        }
+    }
+    char *out = this->pptr();
+    out = std::to_chars(out, out + 20, index).ptr;
+    *out++ = ':';
+    *out++ = ' ';
+    out = token.format(out);
+    *out++ = '\n';
+    this->pbump(int(out - this->pptr()));
+}
+
+int OutputBuffer::overflow(int c) {
+    if (!this->flush()) {
+        return traits_type::eof();
+    }
+    if (c != traits_type::eof()) {
+        *this->pptr() = char(c);
+        this->pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+streamsize OutputBuffer::xsputn(const char *bytes, streamsize count) {
+    size_t size = count;
+    if (size <= size_t(this->epptr() - this->pptr())) {
+        memcpy(this->pptr(), bytes, size);
+        this->pbump(int(size));
+        return count;
+    }
+    // bigger than what is left, so send it on its own rather than in pieces
+    if (!this->flush()) {
+        return 0;
+    }
+    if (size < this->block.size()) {
+        memcpy(this->pptr(), bytes, size);
+        this->pbump(int(size));
+        return count;
+    }
+    return this->writeAll(bytes, size) ? count : 0;
+}
+
+int OutputBuffer::sync() {
+    return this->flush() ? 0 : -1;
+}
+
+bool OutputBuffer::flush() {
+    size_t size = this->pptr() - this->pbase();
+    this->setp(this->block.data(), this->block.data() + this->block.size());
+    return this->writeAll(this->block.data(), size);
+}
+
+bool OutputBuffer::writeAll(const char *bytes, size_t size) {
+    while (size && !this->error) {
+        ssize_t wrote = write(this->fd, bytes, size);
+        if (wrote < 0 && errno == EINTR) {
+            continue;
+        }
+        if (wrote <= 0) {
+            this->error = true;
+            break;
+        }
+        bytes += wrote;
+        size -= wrote;
+    }
+    return !this->error;
+}
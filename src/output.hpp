@@ -0,0 +1,61 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "tokens.hpp"
+
+#include <cstddef>
+#include <streambuf>
+#include <vector>
+
+// Stream buffer that collects output in one large block and hands it to
+// write(2) only when the block fills up or is synced, instead of going
+// through stdio a token at a time. An ostream over it takes care of
+// headers and trees, and token() formats dump lines straight into the block.
+class OutputBuffer : public std::streambuf {
+  public:
+    explicit OutputBuffer(int fd, size_t capacity = 1 << 20);
+    OutputBuffer(const OutputBuffer &) = delete;
+    OutputBuffer &operator=(const OutputBuffer &) = delete;
+    ~OutputBuffer() override; // flushes what is left
+    // Appends "index: " then Token::toString() and a newline
+    void token(size_t index, const Token &);
+    bool failed() const; // a write failed, later output is dropped
+
+  protected:
+    int overflow(int) override;
+    std::streamsize xsputn(const char *, std::streamsize) override;
+    int sync() override;
+
+  private:
+    int fd;
+    std::vector<char> block;
+    bool error = false;
+    bool flush();
+    bool writeAll(const char *, size_t);
+};
@@ -0,0 +1,745 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "parser.hpp"
+
+#include "ast.hpp"
+#include "diagnostics.hpp"
+#include "names.hpp"
+#include "sources.hpp"
+#include "tokens.hpp"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using std::string;
+using std::string_view;
+using std::vector;
+
+Parser::Parser(vector<Token> tokens) {
+    this->ast.tokens = std::move(tokens);
+}
+
+Ast Parser::parse() {
+    this->internNames();
+    uint32_t first = this->parseStatements(false, 0);
+    this->ast.root = this->ast.add(NODES::MODULE_NODE, 0, first);
+    return std::move(this->ast);
+}
+
+// Every name gets its id up front, so nothing after the parser compares
+// text. The names are cut straight from the source and interned in one go.
+void Parser::internNames() {
+    const vector<Token> &tokens = this->ast.tokens;
+    vector<string_view> texts;
+    vector<uint32_t> at;
+    string_view source;
+    if (!tokens.empty()) {
+        source = SOURCES.source(tokens.front().file);
+    }
+    for (size_t i = 0; i < tokens.size(); i++) {
+        const Token &token = tokens[i];
+        if (token.type != TOKENS::IDENT
+            || token.keyword != KEYWORDS::NOT_KEYWORD) {
+            continue;
+        }
+        // a token from another file or window is looked up on its own
+        bool inSource = token.file == tokens.front().file
+                        && token.pos - 1 + token.length <= source.size();
+        texts.push_back(inSource ? source.substr(token.pos - 1, token.length)
+                                 : token.value());
+        at.push_back(i);
+    }
+    vector<uint32_t> ids;
+    NAMES.intern(texts, ids);
+    this->ast.names.assign(tokens.size(), NO_NAME);
+    for (size_t i = 0; i < at.size(); i++) {
+        this->ast.names[at[i]] = ids[i];
+    }
+}
+
+bool Parser::atEnd() const {
+    return this->current >= this->ast.tokens.size();
+}
+
+bool Parser::at(TOKENS type) const {
+    return !this->atEnd() && this->ast.tokens[this->current].type == type;
+}
+
+bool Parser::atTerminator() const {
+    return this->atEnd() || this->at(TOKENS::NL) || this->at(TOKENS::SEMI)
+           || this->at(TOKENS::RBRACE);
+}
+
+KEYWORDS Parser::keyword() const {
+    if (!this->at(TOKENS::IDENT)) {
+        return KEYWORDS::NOT_KEYWORD;
+    }
+    return this->ast.tokens[this->current].keyword;
+}
+
+bool Parser::accept(TOKENS type) {
+    if (this->at(type)) {
+        this->current++;
+        return true;
+    }
+    return false;
+}
+
+bool Parser::expect(TOKENS type, const char *what) {
+    if (this->accept(type)) {
+        return true;
+    }
+    this->error(string("Expected ") + what);
+    return false;
+}
+
+void Parser::skipNewlines() {
+    while (this->accept(TOKENS::NL)) {
+    }
+}
+
+void Parser::error(const string &message) {
+    const vector<Token> &tokens = this->ast.tokens;
+    if (tokens.empty()) {
+        return;
+    }
+    if (this->atEnd()) {
+        const Token &last = tokens.back();
+        this->diagnostics.report(last.file, last.pos,
+                                 message + ", got the end of the file");
+        return;
+    }
+    const Token &token = tokens[this->current];
+    string got = token.type == TOKENS::NL ? "a newline"
+                                          : "'" + string(token.value()) + "'";
+    this->diagnostics.report(token.file, token.pos, message + ", got " + got);
+}
+
+// Skips the rest of a broken statement, along with any braces in it
+void Parser::recover() {
+    int braces = 0;
+    while (!this->atEnd()) {
+        if (this->at(TOKENS::LBRACE)) {
+            braces++;
+        }
+        else if (this->at(TOKENS::RBRACE)) {
+            if (!braces) {
+                return;
+            }
+            braces--;
+        }
+        else if (!braces && (this->at(TOKENS::NL) || this->at(TOKENS::SEMI))) {
+            return;
+        }
+        this->current++;
+    }
+}
+
+// Guards every recursion, false once nesting is too deep to go on
+bool Parser::enter() {
+    if (this->depth < MAXDEPTH) {
+        return true;
+    }
+    this->error("Too deeply nested, MAXDEPTH is " + std::to_string(MAXDEPTH));
+    this->current = this->ast.tokens.size();
+    return false;
+}
+
+// Statements up to a closing brace if braced, or while they start at
+// indent or further in if that is not 0
+uint32_t Parser::parseStatements(bool braced, uint32_t indent) {
+    uint32_t first = NO_NODE;
+    uint32_t last = NO_NODE;
+    while (true) {
+        while (this->accept(TOKENS::NL) || this->accept(TOKENS::SEMI)) {
+        }
+        if (this->atEnd()) {
+            break;
+        }
+        if (this->at(TOKENS::RBRACE)) {
+            if (braced || indent) {
+                break;
+            }
+            this->error("Unexpected closing bracket");
+            this->current++;
+            continue;
+        }
+        if (indent && this->ast.tokens[this->current].lpos() < indent) {
+            break;
+        }
+        size_t reported = this->diagnostics.size();
+        uint32_t start = this->current;
+        uint32_t statement = this->parseStatement();
+        // a block already took the newline or brace that ended it
+        bool closed = false;
+        if (this->current > start) {
+            TOKENS before = this->ast.tokens[this->current - 1].type;
+            closed = before == TOKENS::RBRACE || before == TOKENS::NL;
+        }
+        if (!this->atTerminator() && !closed) {
+            if (this->diagnostics.size() == reported) {
+                this->error("Expected the end of the statement");
+            }
+            this->recover();
+        }
+        if (first == NO_NODE) {
+            first = statement;
+        }
+        else {
+            this->ast[last].next = statement;
+        }
+        last = statement;
+    }
+    return first;
+}
+
+uint32_t Parser::parseStatement() {
+    if (!this->enter()) {
+        return this->ast.add(NODES::ERROR_NODE, this->current - 1);
+    }
+    this->depth++;
+    uint32_t statement;
+    switch (this->keyword()) {
+        case KEYWORDS::IF_KEYWORD:
+            statement = this->parseIf();
+            break;
+        case KEYWORDS::WHILE_KEYWORD:
+            statement = this->parseWhile();
+            break;
+        case KEYWORDS::FUN_KEYWORD:
+            statement = this->parseFun();
+            break;
+        case KEYWORDS::CLASS_KEYWORD:
+            statement = this->parseClass();
+            break;
+        case KEYWORDS::ENUM_KEYWORD:
+            statement = this->parseFields(NODES::ENUM_NODE);
+            break;
+        case KEYWORDS::STRUCT_KEYWORD:
+            statement = this->parseFields(NODES::STRUCT_NODE);
+            break;
+        case KEYWORDS::RETURN_KEYWORD:
+            statement = this->parseReturn();
+            break;
+        default:
+            if (this->at(TOKENS::AT)) {
+                statement = this->parseDecorated();
+            }
+            else {
+                uint32_t token = this->current;
+                uint32_t value = this->parseExpression();
+                statement = this->ast.add(NODES::EXPR_NODE, token, value);
+            }
+            break;
+    }
+    this->depth--;
+    return statement;
+}
+
+// A braced block, or a colon and then either one statement on the same
+// line or the lines indented past column
+uint32_t Parser::parseBlock(uint32_t column) {
+    uint32_t token = this->current;
+    uint32_t first = NO_NODE;
+    if (this->accept(TOKENS::LBRACE)) {
+        first = this->parseStatements(true, 0);
+        this->expect(TOKENS::RBRACE, "'}'");
+    }
+    else if (this->accept(TOKENS::COLON)) {
+        if (this->at(TOKENS::NL)) {
+            first = this->parseStatements(false, column + 1);
+        }
+        else {
+            first = this->parseStatement();
+        }
+    }
+    else {
+        this->error("Expected '{' or ':'");
+    }
+    return this->ast.add(NODES::BLOCK_NODE, token, first);
+}
+
+uint32_t Parser::parseIf() {
+    uint32_t token = this->current++;
+    uint32_t column = this->ast.tokens[token].lpos();
+    uint32_t condition = this->parseExpression();
+    uint32_t then = this->parseBlock(column);
+    uint32_t otherwise = NO_NODE;
+    // else may sit on a later line than the end of the block
+    uint32_t end = this->current;
+    this->skipNewlines();
+    if (this->keyword() == KEYWORDS::ELSE_KEYWORD) {
+        uint32_t elseColumn = this->ast.tokens[this->current++].lpos();
+        if (this->keyword() == KEYWORDS::IF_KEYWORD) {
+            otherwise = this->parseIf();
+        }
+        else {
+            otherwise = this->parseBlock(elseColumn);
+        }
+    }
+    else {
+        this->current = end;
+    }
+    return this->ast.add(NODES::IF_NODE, token, condition, then, otherwise);
+}
+
+uint32_t Parser::parseWhile() {
+    uint32_t token = this->current++;
+    uint32_t column = this->ast.tokens[token].lpos();
+    uint32_t condition = this->parseExpression();
+    uint32_t body = this->parseBlock(column);
+    return this->ast.add(NODES::WHILE_NODE, token, condition, body);
+}
+
+uint32_t Parser::parseFun() {
+    uint32_t column = this->ast.tokens[this->current++].lpos();
+    uint32_t name = this->current;
+    if (!this->expect(TOKENS::IDENT, "a function name")) {
+        return this->ast.add(NODES::ERROR_NODE, name);
+    }
+    uint32_t params = NO_NODE;
+    if (this->expect(TOKENS::LPAR, "'('")) {
+        params = this->parseList(TOKENS::RPAR, &Parser::parseParam);
+    }
+    uint32_t result = NO_NODE;
+    if (this->accept(TOKENS::ARROW)) {
+        result = this->parseType();
+    }
+    uint32_t body = this->parseBlock(column);
+    return this->ast.add(NODES::FUN_NODE, name, params, result, body);
+}
+
+// name, then an optional ": type" and "= default"
+uint32_t Parser::parseParam() {
+    uint32_t name = this->current;
+    if (!this->expect(TOKENS::IDENT, "a parameter name")) {
+        return this->ast.add(NODES::ERROR_NODE, name);
+    }
+    uint32_t type = NO_NODE;
+    uint32_t value = NO_NODE;
+    if (this->accept(TOKENS::COLON)) {
+        type = this->parseType();
+    }
+    if (this->accept(TOKENS::EQL)) {
+        value = this->parseExpression();
+    }
+    return this->ast.add(NODES::PARAM_NODE, name, type, value);
+}
+
+uint32_t Parser::parseClass() {
+    uint32_t column = this->ast.tokens[this->current++].lpos();
+    uint32_t name = this->current;
+    if (!this->expect(TOKENS::IDENT, "a class name")) {
+        return this->ast.add(NODES::ERROR_NODE, name);
+    }
+    uint32_t bases = NO_NODE;
+    if (this->accept(TOKENS::LPAR)) {
+        bases = this->parseList(TOKENS::RPAR, &Parser::parseExpression);
+    }
+    uint32_t body = this->parseBlock(column);
+    return this->ast.add(NODES::CLASS_NODE, name, bases, body);
+}
+
+// enum and struct bodies: a braced list of fields, like parameters
+uint32_t Parser::parseFields(NODES kind) {
+    this->current++;
+    uint32_t name = this->current;
+    if (!this->expect(TOKENS::IDENT, "a name")
+        || !this->expect(TOKENS::LBRACE, "'{'")) {
+        return this->ast.add(NODES::ERROR_NODE, name);
+    }
+    uint32_t first = NO_NODE;
+    uint32_t last = NO_NODE;
+    bool closed = false;
+    while (true) {
+        while (this->accept(TOKENS::NL) || this->accept(TOKENS::SEMI)
+               || this->accept(TOKENS::COMMA)) {
+        }
+        if (this->atEnd() || (closed = this->accept(TOKENS::RBRACE))) {
+            break;
+        }
+        size_t reported = this->diagnostics.size();
+        uint32_t field = this->parseParam();
+        if (this->ast[field].kind == NODES::PARAM_NODE) {
+            this->ast[field].kind = NODES::FIELD_NODE;
+        }
+        if (!this->atTerminator() && !this->at(TOKENS::COMMA)) {
+            if (this->diagnostics.size() == reported) {
+                this->error("Expected the end of the field");
+            }
+            this->recover();
+        }
+        if (first == NO_NODE) {
+            first = field;
+        }
+        else {
+            this->ast[last].next = field;
+        }
+        last = field;
+    }
+    if (!closed) {
+        this->error("Expected '}'");
+    }
+    return this->ast.add(kind, name, first);
+}
+
+// decorators each on their own line, then the fun or class they wrap
+uint32_t Parser::parseDecorated() {
+    uint32_t token = this->current;
+    uint32_t first = NO_NODE;
+    uint32_t last = NO_NODE;
+    while (this->at(TOKENS::AT)) {
+        uint32_t at = this->current++;
+        uint32_t decorator = this->ast.add(NODES::DECORATOR_NODE, at,
+                                           this->parseExpression());
+        if (first == NO_NODE) {
+            first = decorator;
+        }
+        else {
+            this->ast[last].next = decorator;
+        }
+        last = decorator;
+        this->skipNewlines();
+    }
+    uint32_t target;
+    if (this->keyword() == KEYWORDS::FUN_KEYWORD) {
+        target = this->parseFun();
+    }
+    else if (this->keyword() == KEYWORDS::CLASS_KEYWORD) {
+        target = this->parseClass();
+    }
+    else {
+        this->error("Expected fun or class after a decorator");
+        target = this->ast.add(NODES::ERROR_NODE, this->current);
+    }
+    return this->ast.add(NODES::DECORATED_NODE, token, first, target);
+}
+
+uint32_t Parser::parseReturn() {
+    uint32_t token = this->current++;
+    uint32_t value = NO_NODE;
+    if (!this->atTerminator()) {
+        value = this->parseExpression();
+    }
+    return this->ast.add(NODES::RETURN_NODE, token, value);
+}
+
+// name, then optional type arguments in square brackets
+uint32_t Parser::parseType() {
+    uint32_t name = this->current;
+    if (!this->expect(TOKENS::IDENT, "a type")) {
+        return this->ast.add(NODES::ERROR_NODE, name);
+    }
+    uint32_t arguments = NO_NODE;
+    if (this->accept(TOKENS::LSQB)) {
+        arguments = this->parseList(TOKENS::RSQB, &Parser::parseType);
+    }
+    return this->ast.add(NODES::TYPE_NODE, name, arguments);
+}
+
+static bool isAssignment(TOKENS type) {
+    switch (type) {
+        case TOKENS::EQL:
+        case TOKENS::COLONEQL:
+        case TOKENS::PLSEQL:
+        case TOKENS::MINUSEQL:
+        case TOKENS::STAREQL:
+        case TOKENS::DBSTAREQL:
+        case TOKENS::SLASHEQL:
+        case TOKENS::DBSLASHEQL:
+        case TOKENS::PIPEQL:
+        case TOKENS::PERCEQL:
+        case TOKENS::DBGREATEQL:
+        case TOKENS::DBLESSEQL:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// binding power of binary operators, 0 for anything else
+static int precedence(TOKENS type) {
+    switch (type) {
+        case TOKENS::DBPIPE:
+            return 1;
+        case TOKENS::DBAMPER:
+            return 2;
+        case TOKENS::PIPE:
+            return 3;
+        case TOKENS::CARRET:
+            return 4;
+        case TOKENS::AMPER:
+            return 5;
+        case TOKENS::DBEQL:
+        case TOKENS::NTEQUL:
+        case TOKENS::TRPEQL:
+        case TOKENS::NTDBEQL:
+            return 6;
+        case TOKENS::LESS:
+        case TOKENS::LESSEQL:
+        case TOKENS::GREAT:
+        case TOKENS::GREATEQL:
+            return 7;
+        case TOKENS::DBLESS:
+        case TOKENS::DBGREAT:
+            return 8;
+        case TOKENS::PLUS:
+        case TOKENS::MINUS:
+            return 9;
+        case TOKENS::STAR:
+        case TOKENS::SLASH:
+        case TOKENS::DBSLASH:
+        case TOKENS::PERC:
+            return 10;
+        default:
+            return 0;
+    }
+}
+
+// assignments are expressions, the lowest precedence and right to left
+uint32_t Parser::parseExpression() {
+    if (!this->enter()) {
+        return this->ast.add(NODES::ERROR_NODE, this->current - 1);
+    }
+    this->depth++;
+    uint32_t node = this->parseBinary(1);
+    if (!this->atEnd() && isAssignment(this->ast.tokens[this->current].type)) {
+        uint32_t token = this->current++;
+        uint32_t value = this->parseExpression();
+        node = this->ast.add(NODES::ASSIGN_NODE, token, node, value);
+        this->ast[node].op = this->ast.tokens[token].type;
+    }
+    this->depth--;
+    return node;
+}
+
+uint32_t Parser::parseBinary(int lowest) {
+    uint32_t left = this->parseUnary();
+    while (!this->atEnd()) {
+        TOKENS op = this->ast.tokens[this->current].type;
+        int power = precedence(op);
+        if (!power || power < lowest) {
+            break;
+        }
+        uint32_t token = this->current++;
+        uint32_t right = this->parseBinary(power + 1);
+        left = this->ast.add(NODES::BINARY_NODE, token, left, right);
+        this->ast[left].op = op;
+    }
+    return left;
+}
+
+// ** binds tighter than a unary operator on its left, -a ** b is -(a ** b)
+uint32_t Parser::parseUnary() {
+    if (!this->enter()) {
+        return this->ast.add(NODES::ERROR_NODE, this->current - 1);
+    }
+    this->depth++;
+    uint32_t node;
+    if (this->at(TOKENS::MINUS) || this->at(TOKENS::PLUS)
+        || this->at(TOKENS::EXCL) || this->at(TOKENS::TILDE)) {
+        uint32_t token = this->current++;
+        node = this->ast.add(NODES::UNARY_NODE, token, this->parseUnary());
+        this->ast[node].op = this->ast.tokens[token].type;
+    }
+    else {
+        node = this->parsePostfix();
+        if (this->at(TOKENS::DBSTAR)) {
+            uint32_t token = this->current++;
+            node = this->ast.add(NODES::BINARY_NODE, token, node,
+                                 this->parseUnary());
+            this->ast[node].op = TOKENS::DBSTAR;
+        }
+    }
+    this->depth--;
+    return node;
+}
+
+uint32_t Parser::parsePostfix() {
+    uint32_t node = this->parsePrimary();
+    while (true) {
+        uint32_t token = this->current;
+        if (this->accept(TOKENS::LPAR)) {
+            uint32_t arguments =
+                this->parseList(TOKENS::RPAR, &Parser::parseExpression);
+            node = this->ast.add(NODES::CALL_NODE, token, node, arguments);
+        }
+        else if (this->accept(TOKENS::DOT)) {
+            uint32_t name = this->current;
+            if (!this->expect(TOKENS::IDENT, "an attribute name")) {
+                return this->ast.add(NODES::ERROR_NODE, name);
+            }
+            node = this->ast.add(NODES::ATTR_NODE, name, node);
+        }
+        else if (this->accept(TOKENS::LSQB)) {
+            uint32_t index = this->parseExpression();
+            this->expect(TOKENS::RSQB, "']'");
+            node = this->ast.add(NODES::INDEX_NODE, token, node, index);
+        }
+        else {
+            return node;
+        }
+    }
+}
+
+uint32_t Parser::parsePrimary() {
+    uint32_t token = this->current;
+    if (this->atEnd()) {
+        this->error("Expected an expression");
+        return this->ast.add(NODES::ERROR_NODE, token - 1);
+    }
+    const vector<Token> &tokens = this->ast.tokens;
+    switch (tokens[token].type) {
+        case TOKENS::IDENT: {
+            KEYWORDS word = this->keyword();
+            if (word == KEYWORDS::NONE_KEYWORD) {
+                this->current++;
+                return this->ast.add(NODES::NONE_NODE, token);
+            }
+            if (word != KEYWORDS::NOT_KEYWORD) {
+                break;
+            }
+            this->current++;
+            return this->ast.add(NODES::NAME_NODE, token);
+        }
+        case TOKENS::NUMBER:
+            this->current++;
+            return this->ast.add(NODES::NUMBER_NODE, token);
+        case TOKENS::STRING:
+            this->current++;
+            return this->ast.add(NODES::STRING_NODE, token);
+        case TOKENS::CHAR:
+            this->current++;
+            return this->ast.add(NODES::CHAR_NODE, token);
+        case TOKENS::FSTART:
+            this->current++;
+            return this->ast.add(NODES::FSTRING_NODE, token,
+                                 this->parseFString());
+        case TOKENS::ERROR: // already reported by the lexer
+            this->current++;
+            return this->ast.add(NODES::ERROR_NODE, token);
+        case TOKENS::LPAR: {
+            this->current++;
+            uint32_t node = this->parseExpression();
+            this->expect(TOKENS::RPAR, "')'");
+            return node;
+        }
+        case TOKENS::LSQB:
+            this->current++;
+            return this->ast.add(
+                NODES::LIST_NODE, token,
+                this->parseList(TOKENS::RSQB, &Parser::parseExpression));
+        default:
+            break;
+    }
+    this->error("Expected an expression");
+    return this->ast.add(NODES::ERROR_NODE, token);
+}
+
+// comma separated elements up to and including close, a trailing comma is
+// fine
+// The parts of an f-string after its FSTART, the lexer has already split
+// the text from the expressions in braces
+uint32_t Parser::parseFString() {
+    uint32_t first = NO_NODE;
+    uint32_t last = NO_NODE;
+    while (!this->accept(TOKENS::FEND)) {
+        uint32_t node;
+        if (this->at(TOKENS::FTEXT)) {
+            node = this->ast.add(NODES::FTEXT_NODE, this->current++);
+        }
+        else if (this->accept(TOKENS::LBRACE)) {
+            node = this->parseExpression();
+            if (!this->expect(TOKENS::RBRACE, "'}'")) {
+                // skip to the end of this f-string, past any inside it
+                for (int depth = 0; !this->atEnd(); this->current++) {
+                    if (this->at(TOKENS::FSTART)) {
+                        depth++;
+                    }
+                    else if (this->at(TOKENS::FEND) && !depth--) {
+                        this->current++;
+                        break;
+                    }
+                }
+                break;
+            }
+        }
+        else if (this->at(TOKENS::ERROR)) { // a single }, already reported
+            this->current++;
+            continue;
+        }
+        else { // the lexer reported it as unterminated
+            break;
+        }
+        if (first == NO_NODE) {
+            first = node;
+        }
+        else {
+            this->ast[last].next = node;
+        }
+        last = node;
+    }
+    return first;
+}
+
+uint32_t Parser::parseList(TOKENS close, uint32_t (Parser::*element)()) {
+    uint32_t first = NO_NODE;
+    uint32_t last = NO_NODE;
+    while (!this->accept(close)) {
+        if (this->atEnd() || this->at(TOKENS::RBRACE)) {
+            this->error(close == TOKENS::RPAR ? "Expected ')'"
+                                              : "Expected ']'");
+            break;
+        }
+        size_t reported = this->diagnostics.size();
+        uint32_t node = (this->*element)();
+        if (first == NO_NODE) {
+            first = node;
+        }
+        else {
+            this->ast[last].next = node;
+        }
+        last = node;
+        if (!this->accept(TOKENS::COMMA) && !this->at(close)) {
+            if (this->diagnostics.size() == reported) {
+                this->error("Expected ','");
+            }
+            // give up on the list rather than looping on the same token
+            while (!this->atEnd() && !this->at(close)
+                   && !this->at(TOKENS::NL) && !this->at(TOKENS::RBRACE)) {
+                this->current++;
+            }
+            this->accept(close);
+            break;
+        }
+    }
+    return first;
+}
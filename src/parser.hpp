@@ -0,0 +1,84 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "ast.hpp"
+#include "diagnostics.hpp"
+#include "tokens.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+const int MAXDEPTH = 1000;
+
+// Recursive descent over the lexer's tokens. Blocks are either braced, or
+// start with a colon and hold the statements indented past the line that
+// opened them. Syntax errors go to diagnostics and parsing picks up again
+// at the next statement.
+class Parser {
+  public:
+    explicit Parser(std::vector<Token>);
+    Ast parse(); // only once, the tokens move into the Ast
+    Diagnostics diagnostics;
+
+  private:
+    Ast ast;
+    uint32_t current = 0;
+    int depth = 0;
+    void internNames();
+    bool atEnd() const;
+    bool at(TOKENS) const;
+    bool atTerminator() const;
+    KEYWORDS keyword() const;
+    bool accept(TOKENS);
+    bool expect(TOKENS, const char *);
+    void skipNewlines();
+    void error(const std::string &);
+    void recover();
+    bool enter();
+    uint32_t parseStatements(bool, uint32_t);
+    uint32_t parseStatement();
+    uint32_t parseBlock(uint32_t);
+    uint32_t parseIf();
+    uint32_t parseWhile();
+    uint32_t parseFun();
+    uint32_t parseClass();
+    uint32_t parseFields(NODES);
+    uint32_t parseDecorated();
+    uint32_t parseReturn();
+    uint32_t parseParam();
+    uint32_t parseType();
+    uint32_t parseExpression();
+    uint32_t parseBinary(int);
+    uint32_t parseUnary();
+    uint32_t parsePostfix();
+    uint32_t parsePrimary();
+    uint32_t parseFString();
+    uint32_t parseList(TOKENS, uint32_t (Parser::*)());
+};
@@ -0,0 +1,193 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "peephole.hpp"
+
+#include "bytecode.hpp"
+
+#include <cstdint>
+#include <vector>
+
+using std::vector;
+
+static OPCODES opcode(uint32_t instruction) {
+    return OPCODES(instruction & 0xFF);
+}
+
+static bool isJump(OPCODES op) {
+    return op == OPCODES::JMP_OP || op == OPCODES::JMPIF_OP
+           || op == OPCODES::JMPIFNOT_OP;
+}
+
+static uint32_t target(const vector<uint32_t> &code, uint32_t pc) {
+    return uint32_t(int64_t(pc) + 1 + int(code[pc] >> 16) - JUMP_BIAS);
+}
+
+// false if the jump can't reach that far
+static bool retarget(uint32_t &instruction, uint32_t pc, uint32_t to) {
+    int64_t offset = int64_t(to) - int64_t(pc) - 1;
+    if (offset < -JUMP_BIAS || offset > 0xFFFF - JUMP_BIAS) {
+        return false;
+    }
+    instruction = (instruction & 0xFFFF) | uint32_t(offset + JUMP_BIAS) << 16;
+    return true;
+}
+
+static void thread(vector<uint32_t> &code) {
+    for (uint32_t pc = 0; pc < code.size(); pc++) {
+        if (!isJump(opcode(code[pc]))) {
+            continue;
+        }
+        uint32_t to = target(code, pc);
+        // a few hops are plenty, and a loop of jumps never ends
+        for (int hops = 0; hops < 8 && to < code.size()
+                           && opcode(code[to]) == OPCODES::JMP_OP
+                           && target(code, to) != to;
+             hops++) {
+            to = target(code, to);
+        }
+        retarget(code[pc], pc, to);
+    }
+}
+
+// Which instructions are kept: those reachable from the start that do
+// something
+static vector<bool> live(const vector<uint32_t> &code) {
+    vector<bool> reached(code.size(), false);
+    vector<uint32_t> work{0};
+    while (!work.empty()) {
+        uint32_t pc = work.back();
+        work.pop_back();
+        if (pc >= code.size() || reached[pc]) {
+            continue;
+        }
+        reached[pc] = true;
+        OPCODES op = opcode(code[pc]);
+        if (isJump(op)) {
+            work.push_back(target(code, pc));
+        }
+        if (op != OPCODES::JMP_OP && op != OPCODES::RETURN_OP) {
+            work.push_back(pc + 1);
+        }
+    }
+    for (uint32_t pc = 0; pc < code.size(); pc++) {
+        uint32_t i = code[pc];
+        if ((opcode(i) == OPCODES::JMP_OP && target(code, pc) == pc + 1)
+            || (opcode(i) == OPCODES::MOVE_OP
+                && (i >> 8 & 0xFF) == (i >> 16 & 0xFF))) {
+            reached[pc] = false;
+        }
+    }
+    return reached;
+}
+
+static void compact(Chunk &chunk, const vector<bool> &keep) {
+    vector<uint32_t> &code = chunk.code;
+    // where each instruction goes, or the next kept one if it is dropped
+    vector<uint32_t> moved(code.size() + 1);
+    uint32_t count = 0;
+    for (uint32_t pc = 0; pc < code.size(); pc++) {
+        moved[pc] = count;
+        count += keep[pc];
+    }
+    moved[code.size()] = count;
+    for (uint32_t pc = 0; pc < code.size(); pc++) {
+        if (!keep[pc]) {
+            continue;
+        }
+        uint32_t i = code[pc];
+        if (isJump(opcode(i))) {
+            // kept instructions only get closer, so this always fits
+            retarget(i, moved[pc], moved[target(code, pc)]);
+        }
+        code[moved[pc]] = i;
+        chunk.locations[moved[pc]] = chunk.locations[pc];
+    }
+    code.resize(count);
+    chunk.locations.resize(count);
+}
+
+// The superinstruction for a pair, or OPCODE_COUNT if there is none
+static OPCODES fuse(uint32_t first, uint32_t second) {
+    OPCODES op = opcode(first);
+    OPCODES next = opcode(second);
+    if (op == OPCODES::LOADK_OP) {
+        switch (next) {
+            case OPCODES::ADD_OP:
+                return OPCODES::KADD_OP;
+            case OPCODES::SUB_OP:
+                return OPCODES::KSUB_OP;
+            case OPCODES::MUL_OP:
+                return OPCODES::KMUL_OP;
+            case OPCODES::MOD_OP:
+                return OPCODES::KMOD_OP;
+            default:
+                return OPCODES::OPCODE_COUNT;
+        }
+    }
+    // the jump has to test what the compare wrote
+    if ((next != OPCODES::JMPIF_OP && next != OPCODES::JMPIFNOT_OP)
+        || (first >> 8 & 0xFF) != (second >> 8 & 0xFF)) {
+        return OPCODES::OPCODE_COUNT;
+    }
+    switch (op) {
+        case OPCODES::EQ_OP:
+            return OPCODES::EQJMP_OP;
+        case OPCODES::NE_OP:
+            return OPCODES::NEJMP_OP;
+        case OPCODES::SEQ_OP:
+            return OPCODES::SEQJMP_OP;
+        case OPCODES::SNE_OP:
+            return OPCODES::SNEJMP_OP;
+        case OPCODES::LT_OP:
+            return OPCODES::LTJMP_OP;
+        case OPCODES::LE_OP:
+            return OPCODES::LEJMP_OP;
+        case OPCODES::GT_OP:
+            return OPCODES::GTJMP_OP;
+        case OPCODES::GE_OP:
+            return OPCODES::GEJMP_OP;
+        default:
+            return OPCODES::OPCODE_COUNT;
+    }
+}
+
+void peephole(Chunk &chunk) {
+    vector<uint32_t> &code = chunk.code;
+    if (code.empty()) {
+        return;
+    }
+    thread(code);
+    compact(chunk, live(code));
+    for (uint32_t pc = 0; pc + 1 < code.size(); pc++) {
+        OPCODES fused = fuse(code[pc], code[pc + 1]);
+        if (fused != OPCODES::OPCODE_COUNT) {
+            code[pc] = (code[pc] & ~uint32_t{0xFF}) | fused;
+            pc++; // the second half is not the start of another pair
+        }
+    }
+}
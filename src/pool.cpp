@@ -0,0 +1,136 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "pool.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+using std::function;
+using std::lock_guard;
+using std::mutex;
+using std::unique_lock;
+
+ThreadPool::ThreadPool(unsigned threads) {
+    if (threads == 0) {
+        threads = 1;
+    }
+    for (unsigned i = 0; i < threads; i++) {
+        this->queues.push_back(std::make_unique<Queue>());
+    }
+    for (unsigned i = 0; i < threads; i++) {
+        this->workers.emplace_back(&ThreadPool::work, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> guard{this->lock};
+        this->stopping = true;
+    }
+    this->wake.notify_all();
+    for (std::thread &worker: this->workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(function<void()> task) {
+    size_t target;
+    {
+        lock_guard<mutex> guard{this->lock};
+        target = this->next++ % this->queues.size();
+        this->queued++;
+    }
+    {
+        lock_guard<mutex> guard{this->queues[target]->lock};
+        this->queues[target]->tasks.push_back(std::move(task));
+    }
+    this->wake.notify_one();
+}
+
+void ThreadPool::wait() {
+    unique_lock<mutex> guard{this->lock};
+    this->idle.wait(guard, [this] {
+        return this->queued == 0 && this->running == 0;
+    });
+}
+
+unsigned ThreadPool::size() const {
+    return this->workers.size();
+}
+
+bool ThreadPool::pop(size_t self, function<void()> &task) {
+    for (size_t i = 0; i < this->queues.size(); i++) {
+        Queue &queue = *this->queues[(self + i) % this->queues.size()];
+        lock_guard<mutex> guard{queue.lock};
+        if (queue.tasks.empty()) {
+            continue;
+        }
+        if (i == 0) { // own queue, oldest first
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        else { // steal the newest from someone else
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::work(size_t self) {
+    while (true) {
+        {
+            unique_lock<mutex> guard{this->lock};
+            this->wake.wait(guard, [this] {
+                return this->stopping || this->queued > 0;
+            });
+            if (this->stopping) {
+                return;
+            }
+            // claim a task before looking for it, so that the queues can
+            // never hold fewer tasks than there are claims on them
+            this->queued--;
+            this->running++;
+        }
+        function<void()> task;
+        while (!this->pop(self, task)) {
+            std::this_thread::yield();
+        }
+        task();
+        {
+            lock_guard<mutex> guard{this->lock};
+            this->running--;
+        }
+        this->idle.notify_all();
+    }
+}
@@ -0,0 +1,339 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "simd.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using std::vector;
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TOOTY_X86 1
+#endif
+
+static inline bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\v' || c == '\f' || c == '\r';
+}
+
+static const char *findByteScalar(const char *p, const char *end, char c) {
+    while (p != end && *p != c) {
+        p++;
+    }
+    return p;
+}
+
+static const char *findEitherScalar(const char *p, const char *end, char a,
+                                    char b) {
+    while (p != end && *p != a && *p != b) {
+        p++;
+    }
+    return p;
+}
+
+static const char *findPairScalar(const char *p, const char *end, char a,
+                                  char b) {
+    for (; p + 1 < end; p++) {
+        if (p[0] == a && p[1] == b) {
+            return p;
+        }
+    }
+    return end;
+}
+
+static const char *skipBlanksScalar(const char *p, const char *end) {
+    while (p != end && isBlank(*p)) {
+        p++;
+    }
+    return p;
+}
+
+static void indexByteScalar(const char *p, const char *end, char c,
+                            vector<uint32_t> &offsets, uint32_t base) {
+    for (const char *begin = p; p != end; p++) {
+        if (*p == c) {
+            offsets.push_back(base + (p - begin));
+        }
+    }
+}
+
+// Appends the offsets of the set bits of mask, for a chunk at offset at
+static inline void pushBits(uint32_t mask, uint32_t at,
+                            vector<uint32_t> &offsets) {
+    while (mask) {
+        offsets.push_back(at + __builtin_ctz(mask));
+        mask &= mask - 1;
+    }
+}
+
+#ifdef TOOTY_X86
+
+// the sse2 target only matters on 32-bit x86, it is baseline on x86-64
+
+__attribute__((target("sse2"))) static const char *
+findByteSSE2(const char *p, const char *end, char c) {
+    __m128i needle = _mm_set1_epi8(c);
+    for (; end - p >= 16; p += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)p);
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return findByteScalar(p, end, c);
+}
+
+__attribute__((target("sse2"))) static const char *
+findEitherSSE2(const char *p, const char *end, char a, char b) {
+    __m128i needleA = _mm_set1_epi8(a);
+    __m128i needleB = _mm_set1_epi8(b);
+    for (; end - p >= 16; p += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)p);
+        int mask = _mm_movemask_epi8(_mm_or_si128(
+            _mm_cmpeq_epi8(chunk, needleA), _mm_cmpeq_epi8(chunk, needleB)));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return findEitherScalar(p, end, a, b);
+}
+
+__attribute__((target("sse2"))) static const char *
+findPairSSE2(const char *p, const char *end, char a, char b) {
+    __m128i needleA = _mm_set1_epi8(a);
+    __m128i needleB = _mm_set1_epi8(b);
+    for (; end - p >= 17; p += 16) {
+        __m128i first = _mm_loadu_si128((const __m128i *)p);
+        __m128i second = _mm_loadu_si128((const __m128i *)(p + 1));
+        int mask = _mm_movemask_epi8(_mm_and_si128(
+            _mm_cmpeq_epi8(first, needleA), _mm_cmpeq_epi8(second, needleB)));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return findPairScalar(p, end, a, b);
+}
+
+__attribute__((target("sse2"))) static const char *
+skipBlanksSSE2(const char *p, const char *end) {
+    __m128i space = _mm_set1_epi8(' ');
+    __m128i tab = _mm_set1_epi8('\t');
+    __m128i vtab = _mm_set1_epi8('\v');
+    __m128i feed = _mm_set1_epi8('\f');
+    __m128i ret = _mm_set1_epi8('\r');
+    for (; end - p >= 16; p += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)p);
+        __m128i blank = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, space),
+                         _mm_cmpeq_epi8(chunk, tab)),
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, vtab),
+                                      _mm_cmpeq_epi8(chunk, feed)),
+                         _mm_cmpeq_epi8(chunk, ret)));
+        int mask = ~_mm_movemask_epi8(blank) & 0xFFFF;
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return skipBlanksScalar(p, end);
+}
+
+__attribute__((target("sse2"))) static void
+indexByteSSE2(const char *p, const char *end, char c,
+              vector<uint32_t> &offsets, uint32_t base) {
+    const char *begin = p;
+    __m128i needle = _mm_set1_epi8(c);
+    for (; end - p >= 16; p += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)p);
+        pushBits(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)),
+                 base + (p - begin), offsets);
+    }
+    indexByteScalar(p, end, c, offsets, base + (p - begin));
+}
+
+__attribute__((target("avx2"))) static const char *
+findByteAVX2(const char *p, const char *end, char c) {
+    __m256i needle = _mm256_set1_epi8(c);
+    for (; end - p >= 32; p += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)p);
+        unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return findByteSSE2(p, end, c);
+}
+
+__attribute__((target("avx2"))) static const char *
+findEitherAVX2(const char *p, const char *end, char a, char b) {
+    __m256i needleA = _mm256_set1_epi8(a);
+    __m256i needleB = _mm256_set1_epi8(b);
+    for (; end - p >= 32; p += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)p);
+        unsigned mask = _mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, needleA),
+                            _mm256_cmpeq_epi8(chunk, needleB)));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return findEitherSSE2(p, end, a, b);
+}
+
+__attribute__((target("avx2"))) static const char *
+findPairAVX2(const char *p, const char *end, char a, char b) {
+    __m256i needleA = _mm256_set1_epi8(a);
+    __m256i needleB = _mm256_set1_epi8(b);
+    for (; end - p >= 33; p += 32) {
+        __m256i first = _mm256_loadu_si256((const __m256i *)p);
+        __m256i second = _mm256_loadu_si256((const __m256i *)(p + 1));
+        unsigned mask = _mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(first, needleA),
+                             _mm256_cmpeq_epi8(second, needleB)));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return findPairSSE2(p, end, a, b);
+}
+
+__attribute__((target("avx2"))) static const char *
+skipBlanksAVX2(const char *p, const char *end) {
+    __m256i space = _mm256_set1_epi8(' ');
+    __m256i tab = _mm256_set1_epi8('\t');
+    __m256i vtab = _mm256_set1_epi8('\v');
+    __m256i feed = _mm256_set1_epi8('\f');
+    __m256i ret = _mm256_set1_epi8('\r');
+    for (; end - p >= 32; p += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)p);
+        __m256i blank = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, space),
+                            _mm256_cmpeq_epi8(chunk, tab)),
+            _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, vtab),
+                                            _mm256_cmpeq_epi8(chunk, feed)),
+                            _mm256_cmpeq_epi8(chunk, ret)));
+        unsigned mask = ~(unsigned)_mm256_movemask_epi8(blank);
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return skipBlanksSSE2(p, end);
+}
+
+__attribute__((target("avx2"))) static void
+indexByteAVX2(const char *p, const char *end, char c,
+              vector<uint32_t> &offsets, uint32_t base) {
+    const char *begin = p;
+    __m256i needle = _mm256_set1_epi8(c);
+    for (; end - p >= 32; p += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)p);
+        pushBits(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle)),
+                 base + (p - begin), offsets);
+    }
+    indexByteSSE2(p, end, c, offsets, base + (p - begin));
+}
+
+#endif
+
+struct Kernels {
+    const char *(*findByte)(const char *, const char *, char);
+    const char *(*findEither)(const char *, const char *, char, char);
+    const char *(*findPair)(const char *, const char *, char, char);
+    const char *(*skipBlanks)(const char *, const char *);
+    void (*indexByte)(const char *, const char *, char, vector<uint32_t> &,
+                      uint32_t);
+};
+
+static const Kernels KERNELS[] = {
+    {findByteScalar, findEitherScalar, findPairScalar, skipBlanksScalar,
+     indexByteScalar},
+#ifdef TOOTY_X86
+    {findByteSSE2, findEitherSSE2, findPairSSE2, skipBlanksSSE2,
+     indexByteSSE2},
+    {findByteAVX2, findEitherAVX2, findPairAVX2, skipBlanksAVX2,
+     indexByteAVX2},
+#endif
+};
+
+static SIMD_LEVELS supportedLevel() {
+#ifdef TOOTY_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SIMD_LEVELS::AVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return SIMD_LEVELS::SSE2;
+    }
+#endif
+    return SIMD_LEVELS::SCALAR;
+}
+
+static const SIMD_LEVELS SUPPORTED = supportedLevel();
+static SIMD_LEVELS level = SUPPORTED;
+static const Kernels *kernels = &KERNELS[level];
+
+const char *findByte(const char *begin, const char *end, char c) {
+    return kernels->findByte(begin, end, c);
+}
+
+const char *findEither(const char *begin, const char *end, char a, char b) {
+    return kernels->findEither(begin, end, a, b);
+}
+
+const char *findPair(const char *begin, const char *end, char a, char b) {
+    return kernels->findPair(begin, end, a, b);
+}
+
+const char *skipBlanks(const char *begin, const char *end) {
+    return kernels->skipBlanks(begin, end);
+}
+
+void indexByte(const char *begin, const char *end, char c,
+               vector<uint32_t> &offsets, uint32_t base) {
+    kernels->indexByte(begin, end, c, offsets, base);
+}
+
+SIMD_LEVELS simdLevel() {
+    return level;
+}
+
+void setSimdLevel(SIMD_LEVELS wanted) {
+    level = wanted < SUPPORTED ? wanted : SUPPORTED;
+    kernels = &KERNELS[level];
+}
+
+const char *simdLevelName(SIMD_LEVELS level) {
+    switch (level) {
+        case SIMD_LEVELS::AVX2:
+            return "avx2";
+        case SIMD_LEVELS::SSE2:
+            return "sse2";
+        default:
+            return "scalar";
+    }
+}
@@ -0,0 +1,61 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum SIMD_LEVELS
+{
+    SCALAR,
+    SSE2,
+    AVX2,
+};
+
+// Byte scanning kernels used by the lexer to skip over runs it does not
+// need to look at one character at a time. The widest level the CPU
+// supports is picked at startup; each returns end when nothing is found.
+
+// First occurrence of c
+const char *findByte(const char *begin, const char *end, char c);
+// First occurrence of either a or b
+const char *findEither(const char *begin, const char *end, char a, char b);
+// First position of a immediately followed by b, e.g. "*/"
+const char *findPair(const char *begin, const char *end, char a, char b);
+// First byte that is not ' ', '\t', '\v', '\f' or '\r'
+const char *skipBlanks(const char *begin, const char *end);
+// Appends base plus the offset from begin of every c, in order
+void indexByte(const char *begin, const char *end, char c,
+               std::vector<uint32_t> &offsets, uint32_t base);
+
+SIMD_LEVELS simdLevel();
+// Caps the level in use, e.g. to compare against the scalar kernels. Levels
+// the CPU does not support are ignored.
+void setSimdLevel(SIMD_LEVELS);
+const char *simdLevelName(SIMD_LEVELS);
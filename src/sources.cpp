@@ -0,0 +1,301 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "sources.hpp"
+#include "simd.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+using std::string;
+using std::string_view;
+using std::vector;
+
+SourceTable SOURCES;
+
+SourceBuffer::SourceBuffer(const string &path) {
+    int fd = path == "-" ? STDIN_FILENO : open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            this->bytes = static_cast<const char *>(map);
+            this->length = st.st_size;
+            this->mapped = true;
+            this->opened = true;
+        }
+    }
+    if (!this->opened) {
+        this->opened = this->readAll(fd);
+    }
+    if (fd != STDIN_FILENO) {
+        close(fd);
+    }
+}
+
+SourceBuffer::SourceBuffer(SourceBuffer &&other) noexcept
+    : bytes(other.bytes), length(other.length), opened(other.opened),
+      mapped(other.mapped) {
+    other.bytes = nullptr;
+    other.length = 0;
+    other.opened = false;
+    other.mapped = false;
+}
+
+SourceBuffer::~SourceBuffer() {
+    if (this->mapped) {
+        munmap(const_cast<char *>(this->bytes), this->length);
+    }
+    else {
+        free(const_cast<char *>(this->bytes));
+    }
+}
+
+bool SourceBuffer::readAll(int fd) {
+    size_t capacity = 1 << 16;
+    char *buffer = static_cast<char *>(malloc(capacity + PADDING));
+    size_t used = 0;
+    while (buffer) {
+        if (used == capacity) {
+            capacity *= 2;
+            char *grown =
+                static_cast<char *>(realloc(buffer, capacity + PADDING));
+            if (!grown) {
+                break;
+            }
+            buffer = grown;
+        }
+        ssize_t got = read(fd, buffer + used, capacity - used);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0) {
+            break;
+        }
+        if (got == 0) {
+            memset(buffer + used, 0, PADDING);
+            this->bytes = buffer;
+            this->length = used;
+            return true;
+        }
+        used += got;
+    }
+    free(buffer);
+    return false;
+}
+
+bool SourceBuffer::isOpen() const {
+    return this->opened;
+}
+
+bool SourceBuffer::isMapped() const {
+    return this->mapped;
+}
+
+const char *SourceBuffer::data() const {
+    return this->bytes;
+}
+
+size_t SourceBuffer::size() const {
+    return this->length;
+}
+
+string_view SourceBuffer::view() const {
+    return string_view{this->bytes, this->length};
+}
+
+uint32_t SourceTable::intern(const string &filename) {
+    std::unique_lock<std::shared_mutex> guard{this->lock};
+    if (!this->released.empty()) {
+        uint32_t id = this->released.back();
+        this->released.pop_back();
+        this->entries[id] = Entry{filename, string_view{}, 0, {}};
+        return id;
+    }
+    uint32_t id = this->entries.size();
+    this->entries.push_back(Entry{filename, string_view{}, 0, {}});
+    return id;
+}
+
+void SourceTable::release(uint32_t id) {
+    std::unique_lock<std::shared_mutex> guard{this->lock};
+    this->entries[id] = Entry{string{}, string_view{}, 0, {}};
+    this->released.push_back(id);
+}
+
+void SourceTable::setSource(uint32_t id, string_view source, size_t base) {
+    std::unique_lock<std::shared_mutex> guard{this->lock};
+    Entry &entry = this->entries[id];
+    entry.source = source;
+    entry.base = base;
+    vector<uint32_t> &newlines = entry.newlines;
+    if (base == 0) { // a new text rather than the next window
+        newlines.clear();
+        entry.indexed = 0;
+        entry.dropped = 0;
+        return;
+    }
+    // the last newline before the window is where its first line starts
+    size_t before = std::lower_bound(newlines.begin(), newlines.end(), base)
+                    - newlines.begin();
+    if (before > 1) {
+        newlines.erase(newlines.begin(), newlines.begin() + before - 1);
+        entry.dropped += before - 1;
+    }
+}
+
+void SourceTable::edit(uint32_t id, string_view source, size_t offset,
+                       size_t removed, size_t inserted) {
+    std::unique_lock<std::shared_mutex> guard{this->lock};
+    Entry &entry = this->entries[id];
+    entry.source = source;
+    entry.base = 0;
+    vector<uint32_t> &newlines = entry.newlines;
+    auto from = std::lower_bound(newlines.begin(), newlines.end(), offset);
+    if (entry.indexed < offset + removed) {
+        // not indexed that far, keep what comes before the edit
+        newlines.erase(from, newlines.end());
+        entry.indexed = std::min(entry.indexed, offset);
+        return;
+    }
+    auto to = std::lower_bound(from, newlines.end(), offset + removed);
+    int64_t delta = int64_t(inserted) - int64_t(removed);
+    for (auto at = to; at != newlines.end(); at++) {
+        *at = uint32_t(*at + delta);
+    }
+    vector<uint32_t> added;
+    indexByte(source.data() + offset, source.data() + offset + inserted,
+              '\n', added, offset);
+    size_t at = from - newlines.begin();
+    newlines.erase(from, to);
+    newlines.insert(newlines.begin() + at, added.begin(), added.end());
+    entry.indexed += delta;
+}
+
+const string &SourceTable::filename(uint32_t id) const {
+    std::shared_lock<std::shared_mutex> guard{this->lock};
+    return this->entries[id].filename;
+}
+
+string_view SourceTable::source(uint32_t id) const {
+    std::shared_lock<std::shared_mutex> guard{this->lock};
+    return this->entries[id].source;
+}
+
+string_view SourceTable::text(uint32_t id, size_t offset,
+                              size_t length) const {
+    std::shared_lock<std::shared_mutex> guard{this->lock};
+    const Entry &entry = this->entries[id];
+    if (offset < entry.base
+        || offset + length > entry.base + entry.source.size()) {
+        return string_view{};
+    }
+    return entry.source.substr(offset - entry.base, length);
+}
+
+void SourceTable::extend(Entry &entry) {
+    size_t from = std::max(entry.indexed, entry.base);
+    size_t to = entry.base + entry.source.size();
+    if (from < to) {
+        const char *bytes = entry.source.data() - entry.base;
+        indexByte(bytes + from, bytes + to, '\n', entry.newlines, from);
+        entry.indexed = to;
+    }
+}
+
+void SourceTable::locate(const Entry &entry, size_t offset, uint32_t &line,
+                         uint32_t &lpos) {
+    // tokens are mostly looked up in order, so try the line of the last
+    // lookup and the one after before searching
+    thread_local const Entry *lastEntry = nullptr;
+    thread_local size_t last = 0;
+    const vector<uint32_t> &newlines = entry.newlines;
+    auto holds = [&](size_t k) {
+        return k <= newlines.size() && (k == 0 || newlines[k - 1] < offset)
+               && (k == newlines.size() || offset <= newlines[k]);
+    };
+    size_t k = last;
+    if (lastEntry != &entry || !holds(k)) {
+        k = last + 1;
+        if (lastEntry != &entry || !holds(k)) {
+            k = std::lower_bound(newlines.begin(), newlines.end(), offset)
+                - newlines.begin();
+        }
+    }
+    lastEntry = &entry;
+    last = k;
+    if (k == 0 && entry.dropped) {
+        line = 0;
+        lpos = 0;
+        return;
+    }
+    line = entry.dropped + k + 1;
+    lpos = offset - (k ? newlines[k - 1] + 1 : 0) + 1;
+}
+
+void SourceTable::indexLines(uint32_t id) {
+    std::unique_lock<std::shared_mutex> guard{this->lock};
+    extend(this->entries[id]);
+}
+
+void SourceTable::position(uint32_t id, size_t offset, uint32_t &line,
+                           uint32_t &lpos) {
+    {
+        std::shared_lock<std::shared_mutex> guard{this->lock};
+        const Entry &entry = this->entries[id];
+        if (offset < entry.indexed
+            || entry.indexed >= entry.base + entry.source.size()) {
+            locate(entry, offset, line, lpos);
+            return;
+        }
+    }
+    std::unique_lock<std::shared_mutex> guard{this->lock};
+    Entry &entry = this->entries[id];
+    extend(entry);
+    locate(entry, offset, line, lpos);
+}
+
+size_t SourceTable::size() const {
+    std::shared_lock<std::shared_mutex> guard{this->lock};
+    return this->entries.size();
+}
@@ -0,0 +1,111 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Read-only view of a source file. Regular files are mmap'd so the lexer
+// works directly on the page cache; pipes, stdin ("-") and anything else
+// that cannot be mapped are read into a heap buffer with PADDING zeroed
+// bytes past the end.
+class SourceBuffer {
+  public:
+    static const size_t PADDING = 64;
+    explicit SourceBuffer(const std::string &);
+    SourceBuffer(SourceBuffer &&) noexcept;
+    SourceBuffer(const SourceBuffer &) = delete;
+    SourceBuffer &operator=(const SourceBuffer &) = delete;
+    ~SourceBuffer();
+    bool isOpen() const;
+    bool isMapped() const;
+    const char *data() const;
+    size_t size() const;
+    std::string_view view() const;
+
+  private:
+    const char *bytes = nullptr;
+    size_t length = 0;
+    bool opened = false;
+    bool mapped = false;
+    bool readAll(int);
+};
+
+// Gives each text lexed a 32-bit id for its tokens to carry, and remembers
+// the text so token values can be sliced from it. Every call to intern is a
+// new id, so two texts under the same name never share an entry.
+// Tokens only keep byte offsets, lines and columns come from an index of the
+// newlines in each file, built the first time a position is asked for.
+// Safe to use from several lexers at once.
+class SourceTable {
+  public:
+    uint32_t intern(const std::string &);
+    // Hands the id back to be reused once no token of it is looked at again
+    void release(uint32_t);
+    // The source may be a window starting at some offset into the file.
+    // The index then only keeps the newlines from the line the window
+    // starts in, so a file streamed through windows takes memory for one
+    // window's lines, and offsets before the window have no position.
+    void setSource(uint32_t, std::string_view, size_t = 0);
+    // The new text after removed bytes at offset became inserted ones. The
+    // newline index is patched rather than built again.
+    void edit(uint32_t, std::string_view, size_t offset, size_t removed,
+              size_t inserted);
+    const std::string &filename(uint32_t) const;
+    std::string_view source(uint32_t) const;
+    // Bytes [offset, offset + length) of the file, empty if not in memory
+    std::string_view text(uint32_t, size_t, size_t) const;
+    // Adds the newlines in the window to the index now, before it is
+    // replaced by the next one
+    void indexLines(uint32_t);
+    // Line and column, both from 1, of a byte offset into the file, or 0
+    // and 0 for one before the window that is no longer indexed
+    void position(uint32_t, size_t, uint32_t &line, uint32_t &lpos);
+    size_t size() const;
+
+  private:
+    struct Entry {
+        std::string filename;
+        std::string_view source;
+        size_t base;
+        std::vector<uint32_t> newlines; // offsets, up to indexed
+        size_t indexed = 0;
+        size_t dropped = 0; // newlines before newlines[0] no longer kept
+    };
+    static void extend(Entry &);
+    static void locate(const Entry &, size_t, uint32_t &, uint32_t &);
+    std::deque<Entry> entries;
+    std::vector<uint32_t> released;
+    mutable std::shared_mutex lock;
+};
+
+extern SourceTable SOURCES;
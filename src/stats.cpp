@@ -0,0 +1,286 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "stats.hpp"
+#include "tokens.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <time.h>
+#include <vector>
+
+using std::lock_guard;
+using std::memory_order_relaxed;
+using std::mutex;
+using std::ostream;
+using std::string;
+using std::vector;
+using std::chrono::duration;
+using std::chrono::steady_clock;
+
+Stats STATS;
+
+static const char *phases[] = {"read", "lex",  "parse", "compile",
+                               "run",  "emit", "file"};
+
+const char *phaseName(PHASES phase) {
+    return phases[int{phase}];
+}
+
+static double cpuTime(clockid_t clock) {
+    timespec now;
+    if (clock_gettime(clock, &now) != 0) {
+        return 0;
+    }
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+double threadCpuTime() {
+    return cpuTime(CLOCK_THREAD_CPUTIME_ID);
+}
+
+// Small ids for the trace's thread tracks, in the order threads first
+// record something, so the thread calling enable() is 0
+static unsigned threadIndex() {
+    static std::atomic<unsigned> next{0};
+    thread_local unsigned index = next++;
+    return index;
+}
+
+void Stats::enable(bool trace) {
+    threadIndex();
+    this->tracing = trace;
+    this->origin = steady_clock::now();
+    this->cpuOrigin = cpuTime(CLOCK_PROCESS_CPUTIME_ID);
+    this->on.store(true);
+}
+
+bool Stats::enabled() const {
+    return this->on.load(memory_order_relaxed);
+}
+
+void Stats::allocated(size_t size) {
+    if (!this->enabled()) {
+        return;
+    }
+    this->allocations.fetch_add(1, memory_order_relaxed);
+    this->allocatedBytes.fetch_add(size, memory_order_relaxed);
+}
+
+uint64_t Stats::allocationCount() const {
+    return this->allocations.load(memory_order_relaxed);
+}
+
+void Stats::countBytes(size_t count) {
+    if (this->enabled()) {
+        this->bytes.fetch_add(count, memory_order_relaxed);
+    }
+}
+
+void Stats::countTokens(const vector<Token> &tokens) {
+    if (!this->enabled()) {
+        return;
+    }
+    uint64_t counts[TOKENS::ERROR + 1] = {};
+    for (const Token &token: tokens) {
+        counts[token.type]++;
+    }
+    for (int i = 0; i <= TOKENS::ERROR; i++) {
+        if (counts[i]) {
+            this->kinds[i].fetch_add(counts[i], memory_order_relaxed);
+        }
+    }
+}
+
+void Stats::countToken(TOKENS type) {
+    if (this->enabled()) {
+        this->kinds[type].fetch_add(1, memory_order_relaxed);
+    }
+}
+
+void Stats::record(PHASES phase, const string &file,
+                   steady_clock::time_point start, double wall, double cpu) {
+    lock_guard<mutex> guard{this->lock};
+    if (phase != FILE_PHASE) {
+        this->walls[phase] += wall;
+        this->cpus[phase] += cpu;
+        this->counts[phase]++;
+    }
+    if (this->tracing) {
+        double since = duration<double>(start - this->origin).count();
+        this->spans.push_back({phase, file, since, wall, threadIndex()});
+    }
+}
+
+void Stats::report(ostream &out) const {
+    lock_guard<mutex> guard{this->lock};
+    double wall = duration<double>(steady_clock::now() - this->origin).count();
+    double cpu = cpuTime(CLOCK_PROCESS_CPUTIME_ID) - this->cpuOrigin;
+    char line[128];
+    out << "Tooty-lang: stats\n";
+    snprintf(line, sizeof line, "  %-8s %8s %12s %12s\n", "phase", "calls",
+             "wall ms", "cpu ms");
+    out << line;
+    for (int phase = READ_PHASE; phase < FILE_PHASE; phase++) {
+        if (!this->counts[phase]) {
+            continue;
+        }
+        snprintf(line, sizeof line, "  %-8s %8llu %12.3f %12.3f\n",
+                 phases[phase], (unsigned long long)this->counts[phase],
+                 this->walls[phase] * 1e3, this->cpus[phase] * 1e3);
+        out << line;
+    }
+    // phases on different workers overlap, so these can be less than the sum
+    snprintf(line, sizeof line, "  %-8s %8s %12.3f %12.3f\n", "total", "",
+             wall * 1e3, cpu * 1e3);
+    out << line;
+
+    uint64_t tokens = 0;
+    for (const std::atomic<uint64_t> &count: this->kinds) {
+        tokens += count.load(memory_order_relaxed);
+    }
+    uint64_t read = this->bytes.load(memory_order_relaxed);
+    double lex = this->walls[LEX_PHASE];
+    if (lex > 0) {
+        snprintf(line, sizeof line,
+                 "  lexed %llu bytes, %llu tokens: %.2f MB/s, "
+                 "%.2f Mtokens/s\n",
+                 (unsigned long long)read, (unsigned long long)tokens,
+                 read / lex / 1e6, tokens / lex / 1e6);
+        out << line;
+    }
+    uint64_t allocations = this->allocations.load(memory_order_relaxed);
+    if (allocations) {
+        snprintf(line, sizeof line, "  allocations: %llu (%llu bytes)\n",
+                 (unsigned long long)allocations,
+                 (unsigned long long)this->allocatedBytes.load(
+                     memory_order_relaxed));
+        out << line;
+    }
+    if (!tokens) {
+        out.flush();
+        return;
+    }
+    // most common kinds first
+    vector<std::pair<uint64_t, int>> histogram;
+    for (int i = 0; i <= TOKENS::ERROR; i++) {
+        if (uint64_t count = this->kinds[i].load(memory_order_relaxed)) {
+            histogram.push_back({count, i});
+        }
+    }
+    std::sort(histogram.begin(), histogram.end(),
+              [](const auto &a, const auto &b) {
+                  return a.first != b.first ? a.first > b.first
+                                            : a.second < b.second;
+              });
+    out << "  tokens:\n";
+    for (const auto &[count, kind]: histogram) {
+        snprintf(line, sizeof line, "    %-12s %10llu %6.2f%%\n",
+                 typeName(TOKENS(kind)), (unsigned long long)count,
+                 100.0 * count / tokens);
+        out << line;
+    }
+    out.flush();
+}
+
+static void writeString(ostream &out, const string &text) {
+    out << '"';
+    for (unsigned char c: text) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        }
+        else if (c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof escaped, "\\u%04x", c);
+            out << escaped;
+        }
+        else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+bool Stats::writeTrace(ostream &out) const {
+    lock_guard<mutex> guard{this->lock};
+    unsigned threads = 0;
+    for (const Span &span: this->spans) {
+        threads = std::max(threads, span.thread + 1);
+    }
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    for (unsigned thread = 0; thread < threads; thread++) {
+        string name = thread ? "worker " + std::to_string(thread) : "main";
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+            << thread << ",\"args\":{\"name\":\"" << name << "\"}},\n";
+    }
+    char times[64];
+    for (size_t i = 0; i < this->spans.size(); i++) {
+        const Span &span = this->spans[i];
+        // a file span is named after the file so it reads as a heading
+        out << "{\"name\":";
+        writeString(out, span.phase == FILE_PHASE ? span.file
+                                                  : phases[span.phase]);
+        out << ",\"cat\":\"" << (span.phase == FILE_PHASE ? "file" : "phase")
+            << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << span.thread;
+        snprintf(times, sizeof times, ",\"ts\":%.3f,\"dur\":%.3f",
+                 span.start * 1e6, span.wall * 1e6);
+        out << times << ",\"args\":{\"file\":";
+        writeString(out, span.file);
+        out << "}}" << (i + 1 < this->spans.size() ? ",\n" : "\n");
+    }
+    out << "]}\n";
+    out.flush();
+    return bool(out);
+}
+
+PhaseTimer::PhaseTimer(PHASES phase, const string &file)
+    : phase(phase), file(file), active(STATS.enabled()) {
+    if (this->active) {
+        this->start = steady_clock::now();
+        this->cpu = threadCpuTime();
+    }
+}
+
+PhaseTimer::~PhaseTimer() {
+    this->stop();
+}
+
+void PhaseTimer::stop() {
+    if (!this->active) {
+        return;
+    }
+    this->active = false;
+    double wall = duration<double>(steady_clock::now() - this->start).count();
+    STATS.record(this->phase, this->file, this->start, wall,
+                 threadCpuTime() - this->cpu);
+}
@@ -0,0 +1,121 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "tokens.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+enum PHASES
+{
+    READ_PHASE,    // opening and mapping sources, or loading a cached program
+    LEX_PHASE,     // everything a streamed file does is counted here
+    PARSE_PHASE,
+    COMPILE_PHASE, // including writing the cache
+    RUN_PHASE,
+    EMIT_PHASE,    // formatting and writing tokens or trees to stdout
+    FILE_PHASE,    // the whole of one file on a worker, only in the trace
+};
+
+const char *phaseName(PHASES);
+
+// Where the time goes in a run of tooty, for --stats and --trace. Phases are
+// timed with a PhaseTimer around them and nothing is recorded until enable()
+// is called, so a normal run pays a branch per phase. Safe to use from
+// several workers at once.
+class Stats {
+  public:
+    void enable(bool trace);
+    bool enabled() const;
+    // Called by the operator new in counting.cpp, for executables that
+    // link it
+    void allocated(size_t);
+    uint64_t allocationCount() const;
+    void countBytes(size_t);
+    void countTokens(const std::vector<Token> &);
+    void countToken(TOKENS);
+    // Wall and thread CPU time, in seconds, spent on a phase of a file
+    void record(PHASES, const std::string &,
+                std::chrono::steady_clock::time_point, double wall,
+                double cpu);
+    // Per-phase times, throughput, allocations and the token histogram
+    void report(std::ostream &) const;
+    // Chrome trace-event JSON, with one track per thread
+    bool writeTrace(std::ostream &) const;
+
+  private:
+    struct Span {
+        PHASES phase;
+        std::string file;
+        double start; // seconds since enable()
+        double wall;
+        unsigned thread;
+    };
+    std::atomic<bool> on{false};
+    bool tracing = false;
+    std::chrono::steady_clock::time_point origin;
+    double cpuOrigin = 0;
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> allocatedBytes{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> kinds[TOKENS::ERROR + 1] = {};
+    mutable std::mutex lock;
+    double walls[FILE_PHASE] = {};
+    double cpus[FILE_PHASE] = {};
+    uint64_t counts[FILE_PHASE] = {};
+    std::vector<Span> spans;
+};
+
+extern Stats STATS;
+
+// Times the enclosing scope as one phase of a file
+class PhaseTimer {
+  public:
+    PhaseTimer(PHASES, const std::string &);
+    PhaseTimer(const PhaseTimer &) = delete;
+    PhaseTimer &operator=(const PhaseTimer &) = delete;
+    ~PhaseTimer();
+    void stop(); // ends the phase before the scope does
+
+  private:
+    PHASES phase;
+    const std::string &file;
+    bool active;
+    std::chrono::steady_clock::time_point start;
+    double cpu;
+};
+
+// CPU time used so far by the calling thread, in seconds
+double threadCpuTime();
@@ -0,0 +1,109 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "stream.hpp"
+
+#include "lexer.hpp"
+#include "tokens.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+
+using std::string;
+using std::string_view;
+
+TokenStream::TokenStream(const string &filename, BACKENDS backend,
+                         size_t chunk)
+    : lexer(filename, string_view{}, backend) {
+    this->fd =
+        filename == "-" ? STDIN_FILENO : open(filename.c_str(), O_RDONLY);
+    this->chunk = chunk ? chunk : 1;
+    this->lexer.feed(string_view{}, 0, false);
+}
+
+TokenStream::~TokenStream() {
+    if (this->fd > STDIN_FILENO) {
+        close(this->fd);
+    }
+}
+
+bool TokenStream::isOpen() const {
+    return this->fd >= 0;
+}
+
+bool TokenStream::failed() const {
+    return this->error;
+}
+
+size_t TokenStream::bytesRead() const {
+    return this->base + this->used;
+}
+
+bool TokenStream::next(Token &token) {
+    while (!this->lexer.nextToken(token)) {
+        if (!this->lexer.starved() || !this->refill()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TokenStream::refill() {
+    if (this->eof || this->fd < 0) {
+        return false;
+    }
+    // drop what the lexer is done with, the rest is a partial token
+    size_t done = this->lexer.consumed() - this->base;
+    if (done) {
+        memmove(this->buffer.data(), this->buffer.data() + done,
+                this->used - done);
+        this->used -= done;
+        this->base += done;
+    }
+    if (this->buffer.size() - this->used < this->chunk) {
+        this->buffer.resize(this->used + this->chunk);
+    }
+    ssize_t got;
+    do {
+        got = read(this->fd, this->buffer.data() + this->used,
+                   this->buffer.size() - this->used);
+    } while (got < 0 && errno == EINTR);
+    if (got <= 0) {
+        this->error = got < 0;
+        this->eof = true;
+    }
+    else {
+        this->used += got;
+    }
+    this->lexer.feed(string_view{this->buffer.data(), this->used}, this->base,
+                     this->eof);
+    return true;
+}
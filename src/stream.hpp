@@ -0,0 +1,64 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "lexer.hpp"
+#include "tokens.hpp"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Pulls tokens from a file, pipe or stdin ("-") a chunk at a time. Only the
+// unlexed tail of the input is kept, so memory stays around one chunk plus
+// the longest token no matter how big the input is. Token::value(),
+// line() and lpos() are valid until the next call to next(). Inputs past
+// MAXSOURCE throw SourceTooBig.
+class TokenStream {
+  public:
+    TokenStream(const std::string &, BACKENDS = BACKENDS::DFA,
+                size_t = 1 << 16);
+    TokenStream(const TokenStream &) = delete;
+    TokenStream &operator=(const TokenStream &) = delete;
+    ~TokenStream();
+    bool isOpen() const;
+    bool failed() const; // a read failed part way through
+    size_t bytesRead() const;
+    bool next(Token &);
+    Lexer lexer;
+
+  private:
+    int fd;
+    size_t chunk;
+    std::vector<char> buffer;
+    size_t base = 0; // file offset of buffer[0]
+    size_t used = 0;
+    bool eof = false;
+    bool error = false;
+    bool refill();
+};
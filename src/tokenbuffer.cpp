@@ -0,0 +1,111 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "tokenbuffer.hpp"
+#include "sources.hpp"
+#include "tokens.hpp"
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+using std::string_view;
+
+TokenBuffer::TokenBuffer(string_view source) : source(source) {
+}
+
+void TokenBuffer::push(TOKENS kind, uint32_t start, uint32_t length) {
+    this->kindColumn.push_back(kind);
+    this->startColumn.push_back(start);
+    this->lengthColumn.push_back(length);
+}
+
+void TokenBuffer::push(const Token &token) {
+    this->file = token.file;
+    this->push(token.type, token.pos - 1, token.length);
+}
+
+size_t TokenBuffer::size() const {
+    return this->kindColumn.size();
+}
+
+bool TokenBuffer::empty() const {
+    return this->kindColumn.empty();
+}
+
+TOKENS TokenBuffer::kind(size_t i) const {
+    return this->kindColumn[i];
+}
+
+uint32_t TokenBuffer::start(size_t i) const {
+    return this->startColumn[i];
+}
+
+uint32_t TokenBuffer::length(size_t i) const {
+    return this->lengthColumn[i];
+}
+
+string_view TokenBuffer::text(size_t i) const {
+    return this->source.substr(this->startColumn[i], this->lengthColumn[i]);
+}
+
+uint32_t TokenBuffer::line(size_t i) const {
+    uint32_t line, lpos;
+    SOURCES.position(this->file, this->startColumn[i], line, lpos);
+    return line;
+}
+
+uint32_t TokenBuffer::column(size_t i) const {
+    uint32_t line, lpos;
+    SOURCES.position(this->file, this->startColumn[i], line, lpos);
+    return lpos;
+}
+
+const TOKENS *TokenBuffer::kinds() const {
+    return this->kindColumn.data();
+}
+
+size_t TokenBuffer::bytes() const {
+    return this->kindColumn.capacity() * sizeof(TOKENS)
+           + this->startColumn.capacity() * sizeof(uint32_t)
+           + this->lengthColumn.capacity() * sizeof(uint32_t);
+}
+
+TokenView::TokenView(const TokenBuffer &tokens, size_t at)
+    : tokens(tokens), kinds(tokens.kinds()), at(at), size(tokens.size()) {
+}
+
+size_t TokenView::index() const {
+    return this->at;
+}
+
+string_view TokenView::text(size_t ahead) const {
+    if (this->at + ahead >= this->size) {
+        return string_view{};
+    }
+    return this->tokens.text(this->at + ahead);
+}
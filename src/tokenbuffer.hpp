@@ -0,0 +1,97 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "tokens.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Tokens stored as columns rather than as an array of Token: the kinds a
+// parser looks at are a byte each, so one cache line covers 64 of them, and
+// offsets and lengths are only touched for the tokens whose text is used.
+// Lines and columns are not stored at all, SOURCES finds them from the
+// offset when one is asked for.
+class TokenBuffer {
+  public:
+    TokenBuffer() = default;
+    explicit TokenBuffer(std::string_view source);
+    void push(TOKENS, uint32_t start, uint32_t length);
+    void push(const Token &);
+    size_t size() const;
+    bool empty() const;
+    TOKENS kind(size_t) const;
+    uint32_t start(size_t) const; // offset in the source, from 0
+    uint32_t length(size_t) const;
+    std::string_view text(size_t) const;
+    // Both count from 1
+    uint32_t line(size_t) const;
+    uint32_t column(size_t) const;
+    const TOKENS *kinds() const;
+    size_t bytes() const; // memory used by the columns
+    std::string_view source;
+    uint32_t file = 0; // in SOURCES, taken from the Tokens pushed
+
+  private:
+    std::vector<TOKENS> kindColumn;
+    std::vector<uint32_t> startColumn;
+    std::vector<uint32_t> lengthColumn;
+};
+
+// A cursor into a TokenBuffer for a parser: peek looks ahead without
+// moving and reads past the end as NL, so lookahead needs no bounds checks.
+class TokenView {
+  public:
+    explicit TokenView(const TokenBuffer &, size_t = 0);
+    TOKENS peek(size_t ahead = 0) const;
+    void advance(size_t = 1);
+    bool done() const;
+    size_t index() const;
+    std::string_view text(size_t ahead = 0) const;
+    const TokenBuffer &tokens;
+
+  private:
+    const TOKENS *kinds;
+    size_t at;
+    size_t size;
+};
+
+inline TOKENS TokenView::peek(size_t ahead) const {
+    return this->at + ahead < this->size ? this->kinds[this->at + ahead]
+                                         : TOKENS::NL;
+}
+
+inline void TokenView::advance(size_t count) {
+    this->at = this->at + count < this->size ? this->at + count : this->size;
+}
+
+inline bool TokenView::done() const {
+    return this->at >= this->size;
+}
@@ -0,0 +1,190 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "tokenfile.hpp"
+#include "sources.hpp"
+#include "tokens.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using std::string;
+using std::string_view;
+using std::vector;
+
+namespace {
+const char MAGIC[8] = {'T', 'O', 'O', 'T', 'Y', 'T', 'K', '\0'};
+const uint32_t ENDIAN = 0x01020304; // reads differently on another machine
+
+struct Header {
+    char magic[8];
+    uint32_t format;
+    uint32_t endian;
+    uint32_t tokens;
+    uint32_t name; // bytes of the filename
+    uint64_t text; // bytes of the source
+    uint64_t size; // of the whole segment, header included
+    uint64_t reserved;
+};
+static_assert(sizeof(Header) == 48);
+
+uint64_t align(uint64_t offset, uint64_t to) {
+    return (offset + to - 1) / to * to;
+}
+
+// Where each column starts, from the start of the segment
+struct Layout {
+    uint64_t kinds, offsets, lengths, lines, lposes, name, text, end;
+    explicit Layout(const Header &header) {
+        uint64_t column = uint64_t{header.tokens} * sizeof(uint32_t);
+        this->kinds = sizeof(Header);
+        this->offsets = align(this->kinds + header.tokens, sizeof(uint32_t));
+        this->lengths = this->offsets + column;
+        this->lines = this->lengths + column;
+        this->lposes = this->lines + column;
+        this->name = this->lposes + column;
+        this->text = this->name + header.name;
+        this->end = align(this->text + header.text, 8);
+    }
+};
+} // namespace
+
+TOKENS TokenColumns::kind(uint32_t i) const {
+    return TOKENS(this->kinds[i]);
+}
+
+string_view TokenColumns::value(uint32_t i) const {
+    uint64_t end = uint64_t{this->offsets[i]} + this->lengths[i];
+    if (end > this->text.size()) {
+        return string_view{};
+    }
+    return this->text.substr(this->offsets[i], this->lengths[i]);
+}
+
+bool writeTokens(std::ostream &out, string_view filename, string_view source,
+                 const vector<Token> &tokens) {
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.format = TOKEN_FORMAT;
+    header.endian = ENDIAN;
+    header.tokens = tokens.size();
+    header.name = filename.size();
+    header.text = source.size();
+    Layout layout{header};
+    header.size = layout.end;
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    vector<uint8_t> kinds(layout.offsets - layout.kinds, 0);
+    vector<uint32_t> offsets(tokens.size());
+    vector<uint32_t> lengths(tokens.size());
+    vector<uint32_t> lines(tokens.size());
+    vector<uint32_t> lposes(tokens.size());
+    for (size_t i = 0; i < tokens.size(); i++) {
+        const Token &token = tokens[i];
+        kinds[i] = token.type;
+        offsets[i] = token.pos - 1; // positions count from 1
+        lengths[i] = token.length;
+        SOURCES.position(token.file, offsets[i], lines[i], lposes[i]);
+    }
+    out.write(reinterpret_cast<const char *>(kinds.data()), kinds.size());
+    for (const vector<uint32_t> *column:
+         {&offsets, &lengths, &lines, &lposes}) {
+        out.write(reinterpret_cast<const char *>(column->data()),
+                  column->size() * sizeof(uint32_t));
+    }
+    out.write(filename.data(), filename.size());
+    out.write(source.data(), source.size());
+    static const char ZEROS[8] = {};
+    out.write(ZEROS, layout.end - (layout.text + header.text));
+    return out.good();
+}
+
+TokenFile::TokenFile(const string &path) : file(path) {
+    if (!this->file.isOpen()) {
+        this->error = "Could not open the file - '" + path + "'";
+        return;
+    }
+    const char *bytes = this->file.data();
+    uint64_t size = this->file.size();
+    uint64_t at = 0;
+    while (at < size) {
+        Header header;
+        if (size - at < sizeof(header)) {
+            this->error = "Truncated segment header";
+            return;
+        }
+        std::memcpy(&header, bytes + at, sizeof(header));
+        if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+            this->error = "Not a token file";
+            return;
+        }
+        if (header.format != TOKEN_FORMAT || header.endian != ENDIAN) {
+            this->error = "Token file written by another version of tooty "
+                          "or on another machine";
+            return;
+        }
+        // each part has to fit what is left before the layout adds them up,
+        // or a huge length wraps around to a small end
+        if (header.name > size - at || header.text > size - at) {
+            this->error = "Truncated segment";
+            return;
+        }
+        Layout layout{header};
+        if (header.size != layout.end || layout.end > size - at) {
+            this->error = "Truncated segment";
+            return;
+        }
+        const char *segment = bytes + at;
+        TokenColumns columns;
+        columns.filename = string_view{segment + layout.name, header.name};
+        columns.text = string_view{segment + layout.text, header.text};
+        columns.size = header.tokens;
+        columns.kinds = reinterpret_cast<const uint8_t *>(segment);
+        columns.kinds += layout.kinds;
+        auto column = [&](uint64_t offset) {
+            return reinterpret_cast<const uint32_t *>(segment + offset);
+        };
+        columns.offsets = column(layout.offsets);
+        columns.lengths = column(layout.lengths);
+        columns.lines = column(layout.lines);
+        columns.lposes = column(layout.lposes);
+        this->columns.push_back(columns);
+        at += layout.end;
+    }
+    this->opened = true;
+}
+
+bool TokenFile::isOpen() const {
+    return this->opened;
+}
+
+const vector<TokenColumns> &TokenFile::segments() const {
+    return this->columns;
+}
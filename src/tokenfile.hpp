@@ -0,0 +1,78 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "sources.hpp"
+#include "tokens.hpp"
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Bumped whenever the layout of a segment changes or TOKENS is renumbered
+const uint32_t TOKEN_FORMAT = 2;
+
+// The binary token format (--emit-tokens=bin) is a run of segments, one per
+// lexed file. A segment is a fixed header, then columns of kinds (a byte
+// each), offsets, lengths, lines and lposes (32 bits each) and finally the
+// string table: the filename then the source text that offsets index.
+// Columns are aligned, so a reader can use them straight from a mapping.
+struct TokenColumns {
+    std::string_view filename;
+    std::string_view text;
+    uint32_t size; // tokens
+    const uint8_t *kinds;
+    const uint32_t *offsets; // from the start of text, pos - 1 in a Token
+    const uint32_t *lengths;
+    const uint32_t *lines;
+    const uint32_t *lposes;
+    TOKENS kind(uint32_t) const;
+    // Empty if the token is not inside text, segments are not checked
+    // token by token when they are opened
+    std::string_view value(uint32_t) const;
+};
+
+// Appends one file's tokens as a segment, false if the stream failed
+bool writeTokens(std::ostream &, std::string_view filename,
+                 std::string_view source, const std::vector<Token> &);
+
+// Maps a file in the binary token format without copying any of it
+class TokenFile {
+  public:
+    explicit TokenFile(const std::string &);
+    bool isOpen() const; // false if it can't be read or is malformed
+    const std::vector<TokenColumns> &segments() const;
+    std::string error; // why it did not open
+
+  private:
+    SourceBuffer file;
+    std::vector<TokenColumns> columns;
+    bool opened = false;
+};
@@ -28,28 +28,44 @@ SOFTWARE.
 #include "tokens.hpp"
 
 #include "lexer.hpp"
+#include "sources.hpp"
 
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
 #include <string>
+#include <string_view>
 
-using std::strcat;
 using std::string;
-using std::to_string;
+using std::string_view;
 
-Token::Token(string filename, int line, int pos, int lpos, TOKENS type,
-             string value) {
+Token::Token(uint32_t file, uint32_t pos, TOKENS type, uint32_t length) {
     this->pos = pos;
-    this->lpos = lpos;
-    this->line = line;
     this->type = type;
-    this->filename = filename;
-    if (!value.empty()) {
-        if (value == string("\n")) {
-            this->value = "\\n";
-        }
-        else {
-            this->value = value;
-        }
-    }
+    this->file = file;
+    this->length = length;
+    this->keyword = KEYWORDS::NOT_KEYWORD;
+}
+
+const string &Token::filename() const {
+    return SOURCES.filename(this->file);
+}
+
+string_view Token::value() const {
+    return SOURCES.text(this->file, this->pos - 1, this->length);
+}
+
+uint32_t Token::line() const {
+    uint32_t line, lpos;
+    SOURCES.position(this->file, this->pos - 1, line, lpos);
+    return line;
+}
+
+uint32_t Token::lpos() const {
+    uint32_t line, lpos;
+    SOURCES.position(this->file, this->pos - 1, line, lpos);
+    return lpos;
 }
 
 static const char *types[] = {
@@ -62,23 +78,65 @@ static const char *types[] = {
     "NTEQUL",     "NTDBEQL",    "CARRET",    "TILDE",   "GREAT",    "GREATEQL",
     "DBGREAT",    "DBGREATEQL", "LESS",      "LESSEQL", "DBLESS",   "DBLESSEQL",
     "PERC",       "PERCEQL",    "AT",        "ELIP",    "NL",       "COMMA",
-    "ARROW"};
+    "ARROW",      "FSTART",     "FTEXT",     "FEND",    "ERROR"};
+
+const char *typeName(TOKENS type) {
+    return types[int{type}];
+}
+
+static char *append(char *out, string_view text) {
+    memcpy(out, text.data(), text.size());
+    return out + text.size();
+}
+
+static char *append(char *out, uint32_t n) {
+    return std::to_chars(out, out + 10, n).ptr;
+}
+
+size_t Token::formatSize() const {
+    // the fixed text is 26 bytes, the three numbers up to 10 digits each and
+    // the longest type name 10, so 66 with 80 leaving room for a longer
+    // name. The value is the token's text, or "\n" or "NULL" that can be
+    // longer than it.
+    return 80 + this->filename().size() + std::max<size_t>(this->length, 4);
+}
+
+char *Token::format(char *out) const {
+    uint32_t line, lpos;
+    SOURCES.position(this->file, this->pos - 1, line, lpos);
+    out = append(out, "<Token ");
+    out = append(out, this->filename());
+    *out++ = ':';
+    out = append(out, line);
+    *out++ = ':';
+    out = append(out, lpos);
+    out = append(out, " (");
+    out = append(out, this->pos);
+    out = append(out, ") type=");
+    out = append(out, types[int{this->type}]);
+    out = append(out, " value=");
+    switch (this->type) {
+        case TOKENS::IDENT:
+        case TOKENS::NUMBER:
+        case TOKENS::STRING:
+        case TOKENS::CHAR:
+        case TOKENS::FTEXT:
+        case TOKENS::ERROR:
+            out = append(out, this->value());
+            break;
+        case TOKENS::NL:
+            out = append(out, "\\n");
+            break;
+        default:
+            out = append(out, "NULL");
+            break;
+    }
+    *out++ = '>';
+    return out;
+}
 
 string Token::toString() const {
-    string t;
-    t += "<Token ";
-    t += this->filename;
-    t += ":";
-    t += to_string(this->line);
-    t += ":";
-    t += to_string(this->lpos);
-    t += " (";
-    t += to_string(this->pos);
-    t += ") ";
-    t += "type=";
-    t += types[int{this->type}];
-    t += " value=";
-    t += this->value;
-    t += ">";
+    string t(this->formatSize(), '\0');
+    t.resize(this->format(t.data()) - t.data());
     return t;
 }
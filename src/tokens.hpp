@@ -27,23 +27,25 @@ SOFTWARE.
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <regex>
 #include <string>
-#include <unordered_map>
+#include <string_view>
 
 const std::basic_regex<char> IDENT_RE{"^[a-zA-Z_][a-zA-Z0-9_]*"};
 const std::basic_regex<char> NUMBER_RE{"^[0-9]+"};
 const std::basic_regex<char> STRING_RE{"^\"[^\"]*\""};
 const std::basic_regex<char> CHAR_RE{"^'.'"};
 const std::basic_regex<char> CMT_RE{"^#.*"};
-const std::basic_regex<char> MULTI_CMT_RE{R"mmm(^\/\*(.|\n)*\*\/)mmm"};
+const std::basic_regex<char> MULTI_CMT_RE{R"mmm(^\/\*[\s\S]*?\*\/)mmm"};
 
-const std::string SYMS = "()[]{}<>\\|/:;+-,.*=!@&%~^";
-const std::string NUMS = "0123456789";
-const std::string IDENTS =
+constexpr std::string_view SPACES = " \t\n\v\f\r";
+constexpr std::string_view NUMS = "0123456789";
+constexpr std::string_view IDENTS =
     "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_";
 
-enum TOKENS
+enum TOKENS : uint8_t
 {
     IDENT,      // abc
     NUMBER,     // 123
@@ -100,21 +102,61 @@ enum TOKENS
     NL,         // \n
     COMMA,      // ,
     ARROW,      // ->
+    FSTART,     // f"
+    FTEXT,      // text of an f-string outside its braces, {{ and }} doubled
+    FEND,       // the " closing an f-string
+    ERROR,      // anything the lexer could not make sense of
 };
 
+// Words the parser treats specially. They are still lexed as IDENT, the
+// lexer only notes which keyword an IDENT is so nothing later compares text.
+enum KEYWORDS : uint8_t
+{
+    NOT_KEYWORD,
+    IF_KEYWORD,
+    ELSE_KEYWORD,
+    WHILE_KEYWORD,
+    FUN_KEYWORD,
+    CLASS_KEYWORD,
+    RETURN_KEYWORD,
+    ENUM_KEYWORD,
+    STRUCT_KEYWORD,
+    NONE_KEYWORD,
+};
+
+// A token only points into its source: the file id indexes SOURCES, and
+// pos/length select the token text from that file's buffer. Line and
+// column are looked up from pos when asked for, the lexer never counts them.
 class Token {
   public:
-    Token(std::string, int, int, int, TOKENS, std::string);
-    int pos;
-    int line;
-    int lpos;
+    Token() = default;
+    Token(uint32_t, uint32_t, TOKENS, uint32_t);
+    uint32_t pos; // byte offset + 1
+    uint32_t length;
+    uint32_t file;
     TOKENS type;
-    std::string filename;
-    std::string value = "NULL";
+    KEYWORDS keyword; // of an IDENT, in what would be padding
+    const std::string &filename() const;
+    std::string_view value() const;
+    uint32_t line() const;
+    uint32_t lpos() const;
     std::string toString() const;
+    // Writes toString() into a buffer with room for formatSize() bytes,
+    // returning the end, for output that batches many tokens
+    char *format(char *) const;
+    size_t formatSize() const;
 };
 
-const std::unordered_map<std::string, TOKENS> SYMBOLS = {
+const char *typeName(TOKENS);
+
+struct Symbol {
+    std::string_view text;
+    TOKENS type;
+};
+
+// Every operator the lexer knows. CHAR_KINDS and SYMBOL_TRIE are generated
+// from this list at compile time, so a new operator only needs a line here.
+constexpr Symbol SYMBOLS[] = {
     {"(", TOKENS::LPAR},         {")", TOKENS::RPAR},
     {"[", TOKENS::LSQB},         {"]", TOKENS::RSQB},
     {"{", TOKENS::LBRACE},       {"}", TOKENS::RBRACE},
@@ -140,3 +182,162 @@ const std::unordered_map<std::string, TOKENS> SYMBOLS = {
     {"%", TOKENS::PERC},         {"%=", TOKENS::PERCEQL},
     {"@", TOKENS::AT},           {"...", TOKENS::ELIP},
     {",", TOKENS::COMMA},        {"->", TOKENS::ARROW}};
+
+enum CHAR_KIND : uint8_t
+{
+    OTHER_CHAR,
+    SPACE_CHAR,  // SPACES
+    NUMBER_CHAR, // NUMS
+    IDENT_CHAR,  // IDENTS
+    SYMBOL_CHAR, // first character of anything in SYMBOLS
+};
+
+struct CharKindTable {
+    CHAR_KIND kinds[256];
+    constexpr CharKindTable() : kinds() {
+        for (char c: SPACES) {
+            kinds[(unsigned char)c] = SPACE_CHAR;
+        }
+        for (char c: NUMS) {
+            kinds[(unsigned char)c] = NUMBER_CHAR;
+        }
+        for (char c: IDENTS) {
+            kinds[(unsigned char)c] = IDENT_CHAR;
+        }
+        for (const Symbol &symbol: SYMBOLS) {
+            kinds[(unsigned char)symbol.text[0]] = SYMBOL_CHAR;
+        }
+    }
+    constexpr CHAR_KIND operator[](char c) const {
+        return kinds[(unsigned char)c];
+    }
+};
+
+constexpr CharKindTable CHAR_KINDS{};
+
+// Trie over SYMBOLS. Only characters that appear in an operator get a
+// column, and node 0 is the root so a 0 child means no edge.
+struct SymbolTrie {
+    static const int MAX_NODES = 128;
+    static const int MAX_CHARS = 32;
+    uint8_t columns[256];
+    uint8_t children[MAX_NODES][MAX_CHARS];
+    TOKENS types[MAX_NODES]; // ERROR where no operator ends
+    int nodes = 1;
+    int chars = 0;
+    int longest = 0;
+    constexpr SymbolTrie() : columns(), children(), types() {
+        for (TOKENS &type: types) {
+            type = TOKENS::ERROR;
+        }
+        for (const Symbol &symbol: SYMBOLS) {
+            if (int(symbol.text.size()) > longest) {
+                longest = symbol.text.size();
+            }
+            int node = 0;
+            for (char c: symbol.text) {
+                uint8_t &column = columns[(unsigned char)c];
+                if (!column) {
+                    column = ++chars;
+                }
+                uint8_t &child = children[node][column - 1];
+                if (!child) {
+                    child = nodes++;
+                }
+                node = child;
+            }
+            types[node] = symbol.type;
+        }
+    }
+    // Longest operator at the start of [begin, end), 0 if there is none
+    constexpr uint32_t match(const char *begin, const char *end,
+                             TOKENS &type) const {
+        uint32_t matched = 0;
+        int node = 0;
+        for (const char *p = begin; p != end; p++) {
+            uint8_t column = columns[(unsigned char)*p];
+            if (!column || !(node = children[node][column - 1])) {
+                break;
+            }
+            if (types[node] != TOKENS::ERROR) {
+                matched = p - begin + 1;
+                type = types[node];
+            }
+        }
+        return matched;
+    }
+};
+
+constexpr SymbolTrie SYMBOL_TRIE{};
+
+struct Keyword {
+    std::string_view text;
+    KEYWORDS keyword;
+};
+
+constexpr Keyword KEYWORD_LIST[] = {
+    {"if", KEYWORDS::IF_KEYWORD},         {"else", KEYWORDS::ELSE_KEYWORD},
+    {"while", KEYWORDS::WHILE_KEYWORD},   {"fun", KEYWORDS::FUN_KEYWORD},
+    {"class", KEYWORDS::CLASS_KEYWORD},   {"return", KEYWORDS::RETURN_KEYWORD},
+    {"enum", KEYWORDS::ENUM_KEYWORD},     {"struct", KEYWORDS::STRUCT_KEYWORD},
+    {"None", KEYWORDS::NONE_KEYWORD}};
+
+// Perfect hash over KEYWORD_LIST from the first and last characters and the
+// length of a word. The seed is searched for at compile time, so a new
+// keyword only needs a line above; one compare then settles any identifier.
+struct KeywordTable {
+    static const uint32_t SIZE = 32;
+    static const uint32_t MAX_SEED = 1 << 12;
+    std::string_view texts[SIZE];
+    KEYWORDS keywords[SIZE];
+    uint32_t seed = 0; // 0 if no seed below MAX_SEED works
+    size_t shortest = SIZE;
+    size_t longest = 0;
+    static constexpr uint32_t hash(uint32_t seed, const char *text,
+                                   size_t length) {
+        uint32_t h = (unsigned char)text[0] * seed
+                     ^ (unsigned char)text[length - 1] << 3 ^ uint32_t(length);
+        return (h ^ h >> 5) % SIZE;
+    }
+    constexpr KeywordTable() : texts(), keywords() {
+        for (uint32_t candidate = 1; candidate < MAX_SEED; candidate++) {
+            bool taken[SIZE] = {};
+            bool perfect = true;
+            for (const Keyword &keyword: KEYWORD_LIST) {
+                uint32_t slot = hash(candidate, keyword.text.data(),
+                                     keyword.text.size());
+                perfect = perfect && !taken[slot];
+                taken[slot] = true;
+            }
+            if (perfect) {
+                this->seed = candidate;
+                break;
+            }
+        }
+        for (const Keyword &keyword: KEYWORD_LIST) {
+            uint32_t slot =
+                hash(this->seed, keyword.text.data(), keyword.text.size());
+            this->texts[slot] = keyword.text;
+            this->keywords[slot] = keyword.keyword;
+            if (keyword.text.size() < this->shortest) {
+                this->shortest = keyword.text.size();
+            }
+            if (keyword.text.size() > this->longest) {
+                this->longest = keyword.text.size();
+            }
+        }
+    }
+    constexpr KEYWORDS match(const char *text, size_t length) const {
+        if (length < this->shortest || length > this->longest) {
+            return KEYWORDS::NOT_KEYWORD;
+        }
+        uint32_t slot = hash(this->seed, text, length);
+        return this->texts[slot] == std::string_view{text, length}
+                   ? this->keywords[slot]
+                   : KEYWORDS::NOT_KEYWORD;
+    }
+};
+
+constexpr KeywordTable KEYWORD_TABLE{};
+static_assert(KEYWORD_TABLE.seed, "no perfect hash for KEYWORD_LIST, "
+                                  "raise KeywordTable::SIZE");
@@ -0,0 +1,1209 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "vm.hpp"
+
+#include "bytecode.hpp"
+#include "exceptions.hpp"
+#include "heap.hpp"
+#include "jit.hpp"
+#include "names.hpp"
+#include "object.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using std::string;
+using std::string_view;
+using std::vector;
+
+#if defined(__GNUC__) && !defined(TOOTY_NO_COMPUTED_GOTO)
+#define TOOTY_COMPUTED_GOTO 1
+#else
+#define TOOTY_COMPUTED_GOTO 0
+#endif
+
+bool threadedDispatch() {
+    return TOOTY_COMPUTED_GOTO;
+}
+
+// Thrown by the helpers, execute() adds the location and rethrows it as a
+// RuntimeError
+struct Failure {
+    string message;
+};
+
+static Value print(VM &vm, const Value *args, int count) {
+    string line;
+    for (int i = 0; i < count; i++) {
+        if (i) {
+            line += ' ';
+        }
+        line += valueString(args[i], vm.program);
+    }
+    line += '\n';
+    vm.out << line;
+    return noneValue();
+}
+
+static const Native NATIVES[] = {{"print", print}};
+
+static const char *typeName(const Value &value) {
+    switch (value.type) {
+        case VALUE_TYPES::NONE_VALUE:
+        case VALUE_TYPES::UNDEFINED_VALUE:
+            return "None";
+        case VALUE_TYPES::BOOL_VALUE:
+            return "bool";
+        case VALUE_TYPES::INT_VALUE:
+            return "int";
+        case VALUE_TYPES::FLOAT_VALUE:
+            return "float";
+        case VALUE_TYPES::STRING_VALUE:
+            return "str";
+        case VALUE_TYPES::OBJECT_VALUE:
+            return "object";
+        case VALUE_TYPES::CLASS_VALUE:
+            return "class";
+        default:
+            return "fun";
+    }
+}
+
+// How errors about attributes name what they looked in
+static string describe(const Value &value) {
+    if (value.type == VALUE_TYPES::OBJECT_VALUE) {
+        const Class &klass = *value.object->shape->owner;
+        return "'" + string(NAMES.name(klass.name)) + "' object";
+    }
+    if (value.type == VALUE_TYPES::CLASS_VALUE) {
+        const Class &klass = *value.klass;
+        return string(kindName(klass.kind)) + " '"
+               + string(NAMES.name(klass.name)) + "'";
+    }
+    return string("'") + typeName(value) + "'";
+}
+
+static inline bool addInt(int64_t x, int64_t y, int64_t &result) {
+#if defined(__GNUC__)
+    return !__builtin_add_overflow(x, y, &result);
+#else
+    if ((y > 0 && x > INT64_MAX - y) || (y < 0 && x < INT64_MIN - y)) {
+        return false;
+    }
+    result = x + y;
+    return true;
+#endif
+}
+
+static inline bool subInt(int64_t x, int64_t y, int64_t &result) {
+#if defined(__GNUC__)
+    return !__builtin_sub_overflow(x, y, &result);
+#else
+    if ((y < 0 && x > INT64_MAX + y) || (y > 0 && x < INT64_MIN + y)) {
+        return false;
+    }
+    result = x - y;
+    return true;
+#endif
+}
+
+static inline bool mulInt(int64_t x, int64_t y, int64_t &result) {
+#if defined(__GNUC__)
+    return !__builtin_mul_overflow(x, y, &result);
+#else
+    result = int64_t(uint64_t(x) * uint64_t(y));
+    return x == 0 || ((x != -1 || y != INT64_MIN) && result / x == y);
+#endif
+}
+
+static bool isNumber(const Value &value) {
+    return value.type == VALUE_TYPES::INT_VALUE
+           || value.type == VALUE_TYPES::FLOAT_VALUE;
+}
+
+static double toFloat(const Value &value) {
+    return value.type == VALUE_TYPES::INT_VALUE ? double(value.i) : value.f;
+}
+
+static bool equal(const Value &x, const Value &y, bool strict) {
+    if (x.type != y.type) {
+        if (strict || !isNumber(x) || !isNumber(y)) {
+            return false;
+        }
+        return toFloat(x) == toFloat(y);
+    }
+    switch (x.type) {
+        case VALUE_TYPES::BOOL_VALUE:
+            return x.b == y.b;
+        case VALUE_TYPES::INT_VALUE:
+            return x.i == y.i;
+        case VALUE_TYPES::FLOAT_VALUE:
+            return x.f == y.f;
+        case VALUE_TYPES::STRING_VALUE:
+            return *x.s == *y.s;
+        case VALUE_TYPES::FUN_VALUE:
+        case VALUE_TYPES::NATIVE_VALUE:
+            return x.fun == y.fun;
+        case VALUE_TYPES::OBJECT_VALUE:
+            return x.object == y.object;
+        case VALUE_TYPES::CLASS_VALUE:
+            return x.klass == y.klass;
+        default:
+            return true;
+    }
+}
+
+static const char *symbol(OPCODES op) {
+    switch (op) {
+        case OPCODES::ADD_OP:
+            return "+";
+        case OPCODES::SUB_OP:
+            return "-";
+        case OPCODES::MUL_OP:
+            return "*";
+        case OPCODES::DIV_OP:
+            return "/";
+        case OPCODES::IDIV_OP:
+            return "//";
+        case OPCODES::MOD_OP:
+            return "%";
+        case OPCODES::POW_OP:
+            return "**";
+        case OPCODES::SHL_OP:
+            return "<<";
+        case OPCODES::SHR_OP:
+            return ">>";
+        case OPCODES::BAND_OP:
+            return "&";
+        case OPCODES::BOR_OP:
+            return "|";
+        case OPCODES::BXOR_OP:
+            return "^";
+        case OPCODES::LT_OP:
+            return "<";
+        case OPCODES::LE_OP:
+            return "<=";
+        case OPCODES::GT_OP:
+            return ">";
+        case OPCODES::GE_OP:
+            return ">=";
+        case OPCODES::NEG_OP:
+            return "unary -";
+        case OPCODES::POS_OP:
+            return "unary +";
+        default:
+            return "~";
+    }
+}
+
+static Failure unsupported(OPCODES op, const Value &x, const Value &y) {
+    return Failure{string("Unsupported operand types for ") + symbol(op)
+                   + ": '" + typeName(x) + "' and '" + typeName(y) + "'"};
+}
+
+static double floatArithmetic(OPCODES op, double x, double y) {
+    switch (op) {
+        case OPCODES::ADD_OP:
+            return x + y;
+        case OPCODES::SUB_OP:
+            return x - y;
+        case OPCODES::MUL_OP:
+            return x * y;
+        case OPCODES::POW_OP:
+            return std::pow(x, y);
+        default:
+            break;
+    }
+    if (y == 0) {
+        throw Failure{"Division by zero"};
+    }
+    switch (op) {
+        case OPCODES::DIV_OP:
+            return x / y;
+        case OPCODES::IDIV_OP:
+            return std::floor(x / y);
+        default: { // MOD_OP
+            double r = std::fmod(x, y);
+            if (r != 0 && (r < 0) != (y < 0)) {
+                r += y;
+            }
+            return r;
+        }
+    }
+}
+
+// Everything past the int fast paths in execute() but joining strings:
+// overflow into floats, mixed numbers, comparisons and type errors
+static Value operate(OPCODES op, const Value &x, const Value &y) {
+    switch (op) {
+        case OPCODES::EQ_OP:
+            return boolValue(equal(x, y, false));
+        case OPCODES::NE_OP:
+            return boolValue(!equal(x, y, false));
+        case OPCODES::SEQ_OP:
+            return boolValue(equal(x, y, true));
+        case OPCODES::SNE_OP:
+            return boolValue(!equal(x, y, true));
+        case OPCODES::LT_OP:
+        case OPCODES::LE_OP:
+        case OPCODES::GT_OP:
+        case OPCODES::GE_OP: {
+            int order;
+            if (isNumber(x) && isNumber(y)) {
+                if (x.type == VALUE_TYPES::INT_VALUE
+                    && y.type == VALUE_TYPES::INT_VALUE) {
+                    order = x.i < y.i ? -1 : x.i > y.i;
+                }
+                else {
+                    double a = toFloat(x);
+                    double b = toFloat(y);
+                    if (a != a || b != b) { // NaN is never in order
+                        return boolValue(false);
+                    }
+                    order = a < b ? -1 : a > b;
+                }
+            }
+            else if (x.type == VALUE_TYPES::STRING_VALUE
+                     && y.type == VALUE_TYPES::STRING_VALUE) {
+                order = x.s->compare(*y.s);
+            }
+            else {
+                throw unsupported(op, x, y);
+            }
+            bool result = op == OPCODES::LT_OP   ? order < 0
+                          : op == OPCODES::LE_OP ? order <= 0
+                          : op == OPCODES::GT_OP ? order > 0
+                                                 : order >= 0;
+            return boolValue(result);
+        }
+        case OPCODES::SHL_OP:
+        case OPCODES::SHR_OP:
+        case OPCODES::BAND_OP:
+        case OPCODES::BOR_OP:
+        case OPCODES::BXOR_OP: {
+            if (x.type != VALUE_TYPES::INT_VALUE
+                || y.type != VALUE_TYPES::INT_VALUE) {
+                throw unsupported(op, x, y);
+            }
+            if (op == OPCODES::BAND_OP) {
+                return intValue(x.i & y.i);
+            }
+            if (op == OPCODES::BOR_OP) {
+                return intValue(x.i | y.i);
+            }
+            if (op == OPCODES::BXOR_OP) {
+                return intValue(x.i ^ y.i);
+            }
+            if (y.i < 0) {
+                throw Failure{"Negative shift count"};
+            }
+            if (op == OPCODES::SHL_OP) {
+                if (y.i < 64) {
+                    int64_t r = int64_t(uint64_t(x.i) << y.i);
+                    if (r >> y.i == x.i) {
+                        return intValue(r);
+                    }
+                }
+                else if (x.i == 0) {
+                    return intValue(0);
+                }
+                // too big for an int, as with + and *
+                return floatValue(
+                    std::ldexp(double(x.i), int(std::min<int64_t>(y.i, 4096))));
+            }
+            return intValue(y.i >= 64 ? (x.i < 0 ? -1 : 0) : x.i >> y.i);
+        }
+        default:
+            break;
+    }
+    if (!isNumber(x) || !isNumber(y)) {
+        throw unsupported(op, x, y);
+    }
+    if (x.type == VALUE_TYPES::FLOAT_VALUE
+        || y.type == VALUE_TYPES::FLOAT_VALUE || op == OPCODES::DIV_OP) {
+        return floatValue(floatArithmetic(op, toFloat(x), toFloat(y)));
+    }
+    int64_t a = x.i;
+    int64_t b = y.i;
+    int64_t r;
+    switch (op) {
+        case OPCODES::ADD_OP:
+            if (addInt(a, b, r)) {
+                return intValue(r);
+            }
+            break;
+        case OPCODES::SUB_OP:
+            if (subInt(a, b, r)) {
+                return intValue(r);
+            }
+            break;
+        case OPCODES::MUL_OP:
+            if (mulInt(a, b, r)) {
+                return intValue(r);
+            }
+            break;
+        case OPCODES::IDIV_OP:
+        case OPCODES::MOD_OP:
+            if (b == 0) {
+                throw Failure{"Division by zero"};
+            }
+            if (b == -1) { // INT64_MIN / -1 does not fit
+                if (op == OPCODES::MOD_OP) {
+                    return intValue(0);
+                }
+                if (subInt(0, a, r)) {
+                    return intValue(r);
+                }
+                break;
+            }
+            r = a % b;
+            if (op == OPCODES::MOD_OP) {
+                return intValue(r != 0 && (r < 0) != (b < 0) ? r + b : r);
+            }
+            return intValue(a / b - (r != 0 && (r < 0) != (b < 0)));
+        case OPCODES::POW_OP: {
+            if (b < 0) {
+                break;
+            }
+            // square and multiply, falling back to floats on overflow
+            int64_t result = 1;
+            int64_t square = a;
+            bool fits = true;
+            for (int64_t e = b; e && fits; e >>= 1) {
+                if (e & 1) {
+                    fits = mulInt(result, square, result);
+                }
+                if (e > 1 && fits) {
+                    fits = mulInt(square, square, square);
+                }
+            }
+            if (fits) {
+                return intValue(result);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    return floatValue(floatArithmetic(op, double(a), double(b)));
+}
+
+Value VM::arithmetic(OPCODES op, const Value &x, const Value &y) {
+    if (op == OPCODES::ADD_OP && x.type == VALUE_TYPES::STRING_VALUE
+        && y.type == VALUE_TYPES::STRING_VALUE) {
+        string_view *joined = this->makeString(x.s->size() + y.s->size());
+        // x and y are registers, so still right if that collected
+        char *bytes = const_cast<char *>(joined->data());
+        std::memcpy(bytes, x.s->data(), x.s->size());
+        std::memcpy(bytes + x.s->size(), y.s->data(), y.s->size());
+        Value value;
+        value.type = VALUE_TYPES::STRING_VALUE;
+        value.s = joined;
+        return value;
+    }
+    return operate(op, x, y);
+}
+
+// A FORMAT instruction: the parts of an f-string, already split by the
+// lexer and evaluated into registers, so only their text is left to join
+Value VM::format(const Value *parts, uint32_t count) {
+    string text;
+    for (uint32_t i = 0; i < count; i++) {
+        if (parts[i].type == VALUE_TYPES::STRING_VALUE) {
+            text += *parts[i].s;
+        }
+        else {
+            text += valueString(parts[i], this->program);
+        }
+    }
+    Value value;
+    value.type = VALUE_TYPES::STRING_VALUE;
+    value.s = this->newString(text);
+    return value;
+}
+
+static Value unary(OPCODES op, const Value &x) {
+    switch (op) {
+        case OPCODES::NOT_OP:
+            return boolValue(!truthy(x));
+        case OPCODES::NEG_OP:
+            if (x.type == VALUE_TYPES::INT_VALUE) {
+                int64_t r;
+                return subInt(0, x.i, r) ? intValue(r)
+                                         : floatValue(-double(x.i));
+            }
+            if (x.type == VALUE_TYPES::FLOAT_VALUE) {
+                return floatValue(-x.f);
+            }
+            break;
+        case OPCODES::POS_OP:
+            if (isNumber(x)) {
+                return x;
+            }
+            break;
+        default: // BNOT_OP
+            if (x.type == VALUE_TYPES::INT_VALUE) {
+                return intValue(~x.i);
+            }
+            break;
+    }
+    throw Failure{string("Unsupported operand type for ") + symbol(op) + ": '"
+                  + typeName(x) + "'"};
+}
+
+bool fold(OPCODES op, const Value &x, const Value &y, Value &result) {
+    if (op == OPCODES::ADD_OP && x.type == VALUE_TYPES::STRING_VALUE
+        && y.type == VALUE_TYPES::STRING_VALUE) {
+        return false;
+    }
+    try {
+        result = operate(op, x, y);
+        return true;
+    }
+    catch (const Failure &) {
+        return false;
+    }
+}
+
+bool fold(OPCODES op, const Value &x, Value &result) {
+    try {
+        result = unary(op, x);
+        return true;
+    }
+    catch (const Failure &) {
+        return false;
+    }
+}
+
+VM::VM(const Program &program, std::ostream &out, const HeapOptions &options)
+    : program(program), out(out), heap(options, [this] { this->roots(); }) {
+    Value undefined;
+    undefined.type = VALUE_TYPES::UNDEFINED_VALUE;
+    undefined.i = 0;
+    for (string_view name: program.globals) {
+        Value value = undefined;
+        for (size_t i = 0; i < sizeof(NATIVES) / sizeof(*NATIVES); i++) {
+            if (name == NATIVES[i].name) {
+                value.type = VALUE_TYPES::NATIVE_VALUE;
+                value.fun = i;
+            }
+        }
+        this->globals.push_back(value);
+    }
+    vector<string_view> names;
+    for (uint32_t name: program.sites) {
+        names.push_back(*program.constants[name].s);
+    }
+    vector<uint32_t> ids;
+    NAMES.intern(names, ids);
+    this->caches.resize(ids.size());
+    for (size_t i = 0; i < ids.size(); i++) {
+        this->caches[i].name = ids[i];
+    }
+}
+
+VM::~VM() = default;
+
+size_t VM::jitted() const {
+    return this->jit ? this->jit->compiled() : 0;
+}
+
+void VM::roots() {
+    for (Value &value: this->stack) {
+        this->heap.visit(value);
+    }
+    for (Value &value: this->globals) {
+        this->heap.visit(value);
+    }
+    for (Class &klass: this->classes) {
+        for (Value &value: klass.values) {
+            this->heap.visit(value);
+        }
+        for (Value &value: klass.defaults) {
+            this->heap.visit(value);
+        }
+    }
+}
+
+void *VM::allocate(CELL_KINDS kind, size_t bytes) {
+    void *payload = this->heap.allocate(kind, bytes);
+    if (!payload) {
+        throw Failure{"Out of memory, the heap holds at most "
+                      + std::to_string(this->heap.limit() >> 20) + " MB"};
+    }
+    return payload;
+}
+
+string_view *VM::makeString(size_t size) {
+    void *payload = this->allocate(CELL_KINDS::STRING_CELL,
+                                   sizeof(string_view) + size);
+    string_view *view = static_cast<string_view *>(payload);
+    return new (view) string_view(reinterpret_cast<char *>(view + 1), size);
+}
+
+const string_view *VM::newString(string_view text) {
+    string_view *view = this->makeString(text.size());
+    std::memcpy(const_cast<char *>(view->data()), text.data(), text.size());
+    return view;
+}
+
+// A CLASS instruction: the name, the base or None, then count pairs of a
+// member's name and its value
+Value VM::define(const Value *registers, uint32_t count, CLASS_KINDS kind) {
+    uint32_t name = NAMES.intern(*registers[0].s);
+    const Value &parent = registers[1];
+    Class *base = nullptr;
+    if (parent.type == VALUE_TYPES::CLASS_VALUE
+        && parent.klass->kind == CLASS_KINDS::CLASS_KIND) {
+        base = parent.klass;
+    }
+    else if (parent.type != VALUE_TYPES::NONE_VALUE) {
+        throw Failure{"The base of '" + string(NAMES.name(name))
+                      + "' is not a class"};
+    }
+    this->classes.emplace_back(name, kind, base);
+    Class &klass = this->classes.back();
+    for (uint32_t j = 0; j < count; j++) {
+        uint32_t member = NAMES.intern(*registers[2 + 2 * j].s);
+        const Value &value = registers[3 + 2 * j];
+        if (kind == CLASS_KINDS::STRUCT_KIND) {
+            klass.initial = klass.initial->add(member);
+            klass.defaults.push_back(value);
+        }
+        else {
+            klass.members->names.push_back(member);
+            klass.values.push_back(value);
+        }
+    }
+    if (kind == CLASS_KINDS::CLASS_KIND) {
+        for (const Class *c = &klass; c && !klass.constructor; c = c->base) {
+            uint32_t slot = c->members->slot(c->name);
+            if (slot != NO_SLOT) {
+                klass.constructor = &c->values[slot];
+            }
+        }
+    }
+    Value value;
+    value.type = VALUE_TYPES::CLASS_VALUE;
+    value.klass = &klass;
+    return value;
+}
+
+// A new object of a class, before its constructor runs. A struct's
+// fields are the arguments, then the defaults of the ones left out.
+Value VM::construct(Class *klass, const Value *args, uint32_t count) {
+    string name{NAMES.name(klass->name)};
+    if (klass->kind == CLASS_KINDS::ENUM_KIND) {
+        throw Failure{"enum '" + name + "' is not callable"};
+    }
+    if (klass->kind == CLASS_KINDS::CLASS_KIND && !klass->constructor
+        && count > 0) {
+        throw Failure{name + "() takes no arguments, got "
+                      + std::to_string(count)};
+    }
+    if (count > klass->defaults.size()
+        && klass->kind == CLASS_KINDS::STRUCT_KIND) {
+        throw Failure{name + "() takes at most "
+                      + std::to_string(klass->defaults.size())
+                      + " arguments, got " + std::to_string(count)};
+    }
+    // room for as many fields as the most any object of the class got
+    uint32_t fields = klass->defaults.size();
+    uint32_t inlined = std::max(fields, klass->room);
+    void *payload = this->allocate(CELL_KINDS::OBJECT_CELL,
+                                   sizeof(Object) + inlined * sizeof(Value));
+    Object *object = new (payload) Object{klass->initial, nullptr, inlined,
+                                          inlined};
+    object->slots = object->room();
+    std::copy(klass->defaults.begin(), klass->defaults.end(), object->slots);
+    std::fill(object->slots + fields, object->slots + inlined, noneValue());
+    if (klass->kind == CLASS_KINDS::STRUCT_KIND) {
+        std::copy(args, args + count, object->slots);
+    }
+    Value value;
+    value.type = VALUE_TYPES::OBJECT_VALUE;
+    value.object = object;
+    return value;
+}
+
+// GETATTR: tries the shapes the site has seen, then looks it up
+Value VM::attribute(const Value &object, Cache &cache) {
+    const Shape *shape = nullptr;
+    if (object.type == VALUE_TYPES::OBJECT_VALUE) {
+        shape = object.object->shape;
+    }
+    else if (object.type == VALUE_TYPES::CLASS_VALUE) {
+        shape = object.klass->members.get();
+    }
+    for (uint32_t j = 0; j < cache.count; j++) {
+        const Cache::Entry &entry = cache.entries[j];
+        if (entry.shape == shape) {
+            return entry.value ? *entry.value
+                               : object.object->slots[entry.slot];
+        }
+    }
+    return this->lookup(object, cache);
+}
+
+// A field of an object, or else a member of its class, and then of a
+// class itself. Caches where it was found while the site has room.
+Value VM::lookup(const Value &object, Cache &cache) {
+    Cache::Entry entry{nullptr, nullptr, nullptr, NO_SLOT};
+    if (object.type == VALUE_TYPES::OBJECT_VALUE) {
+        entry.shape = object.object->shape;
+        entry.slot = entry.shape->slot(cache.name);
+        if (entry.slot == NO_SLOT) {
+            entry.value = entry.shape->owner->find(cache.name);
+        }
+    }
+    else if (object.type == VALUE_TYPES::CLASS_VALUE) {
+        entry.shape = object.klass->members.get();
+        entry.value = object.klass->find(cache.name);
+    }
+    if (entry.slot == NO_SLOT && !entry.value) {
+        throw Failure{describe(object) + " has no attribute '"
+                      + string(NAMES.name(cache.name)) + "'"};
+    }
+    if (cache.count < CACHE_ENTRIES) {
+        cache.entries[cache.count++] = entry;
+    }
+    return entry.value ? *entry.value : object.object->slots[entry.slot];
+}
+
+// SETATTR: tries the shapes the site has seen, then looks it up
+void VM::assign(const Value &object, Cache &cache, const Value &value) {
+    if (object.type == VALUE_TYPES::OBJECT_VALUE) {
+        Object &o = *object.object;
+        for (uint32_t j = 0; j < cache.count; j++) {
+            const Cache::Entry &entry = cache.entries[j];
+            if (entry.shape == o.shape) {
+                if (entry.next) {
+                    this->append(object, entry.next, value);
+                }
+                else {
+                    o.slots[entry.slot] = value;
+                    this->heap.barrier(&o.slots[entry.slot]);
+                }
+                return;
+            }
+        }
+    }
+    this->store(object, cache, value);
+}
+
+// Writes a field, adding it if the object does not have it yet, which
+// moves the object to the next shape. Classes cannot be changed.
+void VM::store(const Value &object, Cache &cache, const Value &value) {
+    if (object.type != VALUE_TYPES::OBJECT_VALUE) {
+        throw Failure{"Cannot set attributes of " + describe(object)};
+    }
+    Object &o = *object.object;
+    Cache::Entry entry{o.shape, nullptr, nullptr, o.shape->slot(cache.name)};
+    if (entry.slot == NO_SLOT) {
+        entry.slot = o.shape->names.size();
+        entry.next = o.shape->add(cache.name);
+    }
+    if (cache.count < CACHE_ENTRIES) {
+        cache.entries[cache.count++] = entry;
+    }
+    if (entry.next) {
+        this->append(object, entry.next, value);
+    }
+    else {
+        o.slots[entry.slot] = value;
+        this->heap.barrier(&o.slots[entry.slot]);
+    }
+}
+
+// Adds a field in the slot after the last one, moving the slots to a
+// SLOTS_CELL twice as big when they are full
+void VM::append(const Value &object, Shape *next, const Value &value) {
+    uint32_t count = object.object->shape->names.size();
+    if (count == object.object->capacity) {
+        uint32_t capacity = std::max(2 * count, uint32_t(4));
+        void *payload = this->allocate(CELL_KINDS::SLOTS_CELL,
+                                       capacity * sizeof(Value));
+        // object and value are registers, so moved along if that collected
+        Object &o = *object.object;
+        Value *slots = static_cast<Value *>(payload);
+        std::copy(o.slots, o.slots + count, slots);
+        std::fill(slots + count, slots + capacity, noneValue());
+        o.slots = slots;
+        o.capacity = capacity;
+        this->heap.barrier(&o.slots);
+    }
+    Object &o = *object.object;
+    o.slots[count] = value;
+    this->heap.barrier(&o.slots[count]);
+    o.shape = next;
+    next->owner->room = std::max(next->owner->room, count + 1);
+}
+
+Value VM::run(DISPATCH_MODES mode, JIT_MODES jit) {
+    this->frames.clear();
+    this->frames.reserve(64);
+    this->executed = 0;
+    this->jit.reset();
+    if (jit != JIT_MODES::OFF_JIT && Jit::supported()
+        && mode != DISPATCH_MODES::COUNTING_DISPATCH) {
+        this->jit = std::make_unique<Jit>(this->program, jit);
+    }
+    if (mode == DISPATCH_MODES::THREADED_DISPATCH && threadedDispatch()) {
+        return this->execute<DISPATCH_MODES::THREADED_DISPATCH>();
+    }
+    if (mode == DISPATCH_MODES::COUNTING_DISPATCH) {
+        return this->execute<DISPATCH_MODES::COUNTING_DISPATCH>();
+    }
+    return this->execute<DISPATCH_MODES::SWITCH_DISPATCH>();
+}
+
+#define A (i >> 8 & 0xFF)
+#define B (i >> 16 & 0xFF)
+#define C (i >> 24)
+#define BX (i >> 16)
+#define SBX (int(i >> 16) - JUMP_BIAS)
+
+#if TOOTY_COMPUTED_GOTO
+#define CASE(op)                                                               \
+    case OPCODES::op:                                                          \
+        op##_LABEL
+#define NEXT                                                                   \
+    if (THREADED) {                                                            \
+        i = *pc++;                                                             \
+        goto *LABELS[i & 0xFF];                                                \
+    }                                                                          \
+    break
+#else
+#define CASE(op) case OPCODES::op
+#define NEXT break
+#endif
+
+// int on int fast path, anything else goes through arithmetic()
+#define ARITHMETIC(op, check)                                                  \
+    {                                                                          \
+        const Value &x = R[B];                                                 \
+        const Value &y = R[C];                                                 \
+        int64_t r;                                                             \
+        if (x.type == VALUE_TYPES::INT_VALUE                                   \
+            && y.type == VALUE_TYPES::INT_VALUE && check(x.i, y.i, r)) {       \
+            R[A] = intValue(r);                                                \
+        }                                                                      \
+        else {                                                                 \
+            R[A] = this->arithmetic(OPCODES::op, x, y);                        \
+        }                                                                      \
+        NEXT;                                                                  \
+    }
+
+#define COMPARE(op, cmp)                                                       \
+    {                                                                          \
+        const Value &x = R[B];                                                 \
+        const Value &y = R[C];                                                 \
+        if (x.type == VALUE_TYPES::INT_VALUE                                   \
+            && y.type == VALUE_TYPES::INT_VALUE) {                             \
+            R[A] = boolValue(x.i cmp y.i);                                     \
+        }                                                                      \
+        else {                                                                 \
+            R[A] = this->arithmetic(OPCODES::op, x, y);                        \
+        }                                                                      \
+        NEXT;                                                                  \
+    }
+
+// a compare and the JMPIF or JMPIFNOT after it, which decides which way
+// the result jumps
+#define COMPARE_JUMP(op, cmp)                                                  \
+    {                                                                          \
+        const Value &x = R[B];                                                 \
+        const Value &y = R[C];                                                 \
+        bool result;                                                           \
+        if (x.type == VALUE_TYPES::INT_VALUE                                   \
+            && y.type == VALUE_TYPES::INT_VALUE) {                             \
+            result = x.i cmp y.i;                                              \
+        }                                                                      \
+        else {                                                                 \
+            result = truthy(this->arithmetic(OPCODES::op, x, y));              \
+        }                                                                      \
+        R[A] = boolValue(result);                                              \
+        uint32_t jump = *pc++;                                                 \
+        if (result == ((jump & 0xFF) == OPCODES::JMPIF_OP)) {                  \
+            pc += int(jump >> 16) - JUMP_BIAS;                                 \
+            LOOP(int(jump >> 16) - JUMP_BIAS);                                 \
+        }                                                                      \
+        NEXT;                                                                  \
+    }
+
+// LOADK, then carries on with the instruction after it as i
+#define LOAD_CONSTANT                                                          \
+    R[A] = K[BX];                                                              \
+    i = *pc++
+
+#define MODULO                                                                 \
+    {                                                                          \
+        const Value &x = R[B];                                                 \
+        const Value &y = R[C];                                                 \
+        if (x.type == VALUE_TYPES::INT_VALUE                                   \
+            && y.type == VALUE_TYPES::INT_VALUE && y.i > 0) {                  \
+            int64_t r = x.i % y.i;                                             \
+            R[A] = intValue(r < 0 ? r + y.i : r);                              \
+        }                                                                      \
+        else {                                                                 \
+            R[A] = this->arithmetic(OPCODES::MOD_OP, x, y);                    \
+        }                                                                      \
+        NEXT;                                                                  \
+    }
+
+// Carries on in native code if the current fun has any, up to the
+// instruction it leaves to the interpreter
+#define NATIVE                                                                 \
+    if (this->jit && this->jit->ready(function - functions.data())) {          \
+        pc = function->code                                                    \
+             + this->jit->run(function - functions.data(),                     \
+                              pc - function->code, R, *this);                  \
+    }
+
+// A jump back is a time round a loop, which counts towards compiling the
+// fun, and once it is compiled goes on in native code
+#define LOOP(offset)                                                           \
+    if ((offset) < 0 && this->jit                                              \
+        && this->jit->hot(function - functions.data())) {                      \
+        NATIVE;                                                                \
+    }
+
+#define SLOW(op)                                                               \
+    R[A] = this->arithmetic(OPCODES::op, R[B], R[C]);                          \
+    NEXT
+
+// One loop for every dispatch mode. With THREADED every handler fetches
+// the next instruction and jumps to its label itself, so each handler gets
+// its own indirect branch instead of all sharing the switch's.
+template <DISPATCH_MODES MODE> Value VM::execute() {
+    [[maybe_unused]] const bool THREADED =
+        MODE == DISPATCH_MODES::THREADED_DISPATCH;
+#if TOOTY_COMPUTED_GOTO
+    static const void *const LABELS[] = {
+        &&MOVE_OP_LABEL,     &&LOADK_OP_LABEL,   &&LOADNONE_OP_LABEL,
+        &&GETGLOBAL_OP_LABEL, &&SETGLOBAL_OP_LABEL, &&ADD_OP_LABEL,
+        &&SUB_OP_LABEL,      &&MUL_OP_LABEL,     &&DIV_OP_LABEL,
+        &&IDIV_OP_LABEL,     &&MOD_OP_LABEL,     &&POW_OP_LABEL,
+        &&SHL_OP_LABEL,      &&SHR_OP_LABEL,     &&BAND_OP_LABEL,
+        &&BOR_OP_LABEL,      &&BXOR_OP_LABEL,    &&EQ_OP_LABEL,
+        &&NE_OP_LABEL,       &&SEQ_OP_LABEL,     &&SNE_OP_LABEL,
+        &&LT_OP_LABEL,       &&LE_OP_LABEL,      &&GT_OP_LABEL,
+        &&GE_OP_LABEL,       &&NEG_OP_LABEL,     &&POS_OP_LABEL,
+        &&NOT_OP_LABEL,      &&BNOT_OP_LABEL,    &&JMP_OP_LABEL,
+        &&JMPIF_OP_LABEL,    &&JMPIFNOT_OP_LABEL, &&CALL_OP_LABEL,
+        &&RETURN_OP_LABEL,   &&CLASS_OP_LABEL,   &&GETATTR_OP_LABEL,
+        &&SETATTR_OP_LABEL,  &&GETMETHOD_OP_LABEL, &&EXTRA_OP_LABEL,
+        &&FORMAT_OP_LABEL,   &&EQJMP_OP_LABEL,   &&NEJMP_OP_LABEL,
+        &&SEQJMP_OP_LABEL,   &&SNEJMP_OP_LABEL,  &&LTJMP_OP_LABEL,
+        &&LEJMP_OP_LABEL,    &&GTJMP_OP_LABEL,   &&GEJMP_OP_LABEL,
+        &&KADD_OP_LABEL,     &&KSUB_OP_LABEL,    &&KMUL_OP_LABEL,
+        &&KMOD_OP_LABEL};
+    static_assert(sizeof(LABELS) / sizeof(*LABELS) == OPCODE_COUNT,
+                  "a label for every opcode");
+#endif
+    const vector<Function> &functions = this->program.functions;
+    const Value *K = this->program.constants.data();
+    const Function *function = &functions[0];
+    const uint32_t *pc = function->code;
+    size_t base = 0;
+    if (this->stack.size() < function->registers) {
+        this->stack.resize(function->registers);
+    }
+    std::fill(this->stack.begin(), this->stack.begin() + function->registers,
+              noneValue());
+    Value *R = this->stack.data();
+    uint32_t i;
+    if (this->jit && this->jit->hot(0)) {
+        NATIVE;
+    }
+    try {
+        while (true) {
+            i = *pc++;
+            if (MODE == DISPATCH_MODES::COUNTING_DISPATCH) {
+                this->executed++;
+            }
+            switch (OPCODES(i & 0xFF)) {
+                CASE(MOVE_OP):
+                    R[A] = R[B];
+                    NEXT;
+                CASE(LOADK_OP):
+                    R[A] = K[BX];
+                    NEXT;
+                CASE(LOADNONE_OP):
+                    R[A] = noneValue();
+                    NEXT;
+                CASE(GETGLOBAL_OP): {
+                    const Value &value = this->globals[BX];
+                    if (value.type == VALUE_TYPES::UNDEFINED_VALUE) {
+                        string name{this->program.globals[BX]};
+                        throw Failure{"Name '" + name + "' is not defined"};
+                    }
+                    R[A] = value;
+                    NEXT;
+                }
+                CASE(SETGLOBAL_OP):
+                    this->globals[BX] = R[A];
+                    NEXT;
+                CASE(ADD_OP):
+                    ARITHMETIC(ADD_OP, addInt);
+                CASE(SUB_OP):
+                    ARITHMETIC(SUB_OP, subInt);
+                CASE(MUL_OP):
+                    ARITHMETIC(MUL_OP, mulInt);
+                CASE(DIV_OP):
+                    SLOW(DIV_OP);
+                CASE(IDIV_OP):
+                    SLOW(IDIV_OP);
+                CASE(MOD_OP):
+                    MODULO;
+                CASE(POW_OP):
+                    SLOW(POW_OP);
+                CASE(SHL_OP):
+                    SLOW(SHL_OP);
+                CASE(SHR_OP):
+                    SLOW(SHR_OP);
+                CASE(BAND_OP):
+                    SLOW(BAND_OP);
+                CASE(BOR_OP):
+                    SLOW(BOR_OP);
+                CASE(BXOR_OP):
+                    SLOW(BXOR_OP);
+                CASE(EQ_OP):
+                    COMPARE(EQ_OP, ==);
+                CASE(NE_OP):
+                    COMPARE(NE_OP, !=);
+                CASE(SEQ_OP):
+                    COMPARE(SEQ_OP, ==);
+                CASE(SNE_OP):
+                    COMPARE(SNE_OP, !=);
+                CASE(LT_OP):
+                    COMPARE(LT_OP, <);
+                CASE(LE_OP):
+                    COMPARE(LE_OP, <=);
+                CASE(GT_OP):
+                    COMPARE(GT_OP, >);
+                CASE(GE_OP):
+                    COMPARE(GE_OP, >=);
+                CASE(NEG_OP):
+                    R[A] = unary(OPCODES::NEG_OP, R[B]);
+                    NEXT;
+                CASE(POS_OP):
+                    R[A] = unary(OPCODES::POS_OP, R[B]);
+                    NEXT;
+                CASE(NOT_OP):
+                    R[A] = boolValue(!truthy(R[B]));
+                    NEXT;
+                CASE(BNOT_OP):
+                    R[A] = unary(OPCODES::BNOT_OP, R[B]);
+                    NEXT;
+                CASE(JMP_OP):
+                    pc += SBX;
+                    LOOP(SBX);
+                    NEXT;
+                CASE(JMPIF_OP):
+                    if (truthy(R[A])) {
+                        pc += SBX;
+                        LOOP(SBX);
+                    }
+                    NEXT;
+                CASE(JMPIFNOT_OP):
+                    if (!truthy(R[A])) {
+                        pc += SBX;
+                        LOOP(SBX);
+                    }
+                    NEXT;
+                CASE(CALL_OP): {
+                    Value callee = R[A];
+                    uint32_t count = B;
+                    bool construct = false;
+                    if (C && R[A + 1].type != VALUE_TYPES::OBJECT_VALUE) {
+                        // only objects are passed to their methods, a fun
+                        // of a class or enum is called as it is
+                        std::copy(R + A + 2, R + A + 1 + count, R + A + 1);
+                        count--;
+                    }
+                    if (callee.type == VALUE_TYPES::NATIVE_VALUE) {
+                        R[A] = NATIVES[callee.fun].function(*this, R + A + 1,
+                                                            count);
+                        NATIVE;
+                        NEXT;
+                    }
+                    if (callee.type == VALUE_TYPES::CLASS_VALUE) {
+                        Class *klass = callee.klass;
+                        R[A] = this->construct(klass, R + A + 1, count);
+                        if (!klass->constructor) {
+                            NATIVE;
+                            NEXT;
+                        }
+                        // which gets the object in front of the arguments
+                        callee = *klass->constructor;
+                        construct = true;
+                        count++;
+                    }
+                    if (callee.type != VALUE_TYPES::FUN_VALUE) {
+                        throw Failure{string("'") + typeName(callee)
+                                      + "' is not callable"};
+                    }
+                    const Function &called = functions[callee.fun];
+                    uint32_t required = called.params - called.defaultCount;
+                    if (count < required || count > called.params) {
+                        string takes = std::to_string(called.params);
+                        if (required != called.params) {
+                            takes = std::to_string(required) + " to " + takes;
+                        }
+                        throw Failure{string(called.name) + "() takes " + takes
+                                      + " arguments, got "
+                                      + std::to_string(count)};
+                    }
+                    if (this->frames.size() >= MAXFRAMES) {
+                        throw Failure{"Too much recursion, MAXFRAMES is "
+                                      + std::to_string(MAXFRAMES)};
+                    }
+                    size_t start = base + A + 1;
+                    if (start + called.registers > this->stack.size()) {
+                        this->stack.resize(
+                            std::max(this->stack.size() * 2,
+                                     start + called.registers));
+                    }
+                    // the arguments are already in place
+                    Value *args = this->stack.data() + start;
+                    if (construct) {
+                        std::copy_backward(args, args + count - 1,
+                                           args + count);
+                        args[0] = args[-1];
+                    }
+                    for (uint32_t j = count; j < called.params; j++) {
+                        args[j] = K[called.defaults[j - required]];
+                    }
+                    for (uint32_t j = called.params; j < called.registers;
+                         j++) {
+                        args[j] = noneValue();
+                    }
+                    this->frames.push_back(
+                        Frame{function, pc, base, construct});
+                    function = &called;
+                    pc = called.code;
+                    base = start;
+                    R = args;
+                    if (this->jit && this->jit->hot(callee.fun)) {
+                        NATIVE;
+                    }
+                    NEXT;
+                }
+                CASE(RETURN_OP): {
+                    Value result = R[A];
+                    if (this->frames.empty()) {
+                        return result;
+                    }
+                    const Frame &frame = this->frames.back();
+                    // the callee sat one register past where the result goes
+                    if (!frame.construct) {
+                        this->stack[base - 1] = result;
+                    }
+                    function = frame.function;
+                    pc = frame.pc;
+                    base = frame.base;
+                    this->frames.pop_back();
+                    R = this->stack.data() + base;
+                    NATIVE;
+                    NEXT;
+                }
+                CASE(CLASS_OP):
+                    R[A] = this->define(R + A, B, CLASS_KINDS(C));
+                    NEXT;
+                CASE(GETATTR_OP):
+                    R[A] = this->attribute(R[B], this->caches[*pc++ >> 8]);
+                    NEXT;
+                CASE(SETATTR_OP):
+                    this->assign(R[A], this->caches[*pc++ >> 8], R[B]);
+                    NEXT;
+                CASE(GETMETHOD_OP): {
+                    const Value object = R[B];
+                    R[A] = this->attribute(object, this->caches[*pc++ >> 8]);
+                    R[A + 1] = object;
+                    NEXT;
+                }
+                CASE(EXTRA_OP): // read by the instruction before it
+                    NEXT;
+                CASE(FORMAT_OP):
+                    R[A] = this->format(R + B, C);
+                    NEXT;
+                CASE(EQJMP_OP):
+                    COMPARE_JUMP(EQ_OP, ==);
+                CASE(NEJMP_OP):
+                    COMPARE_JUMP(NE_OP, !=);
+                CASE(SEQJMP_OP):
+                    COMPARE_JUMP(SEQ_OP, ==);
+                CASE(SNEJMP_OP):
+                    COMPARE_JUMP(SNE_OP, !=);
+                CASE(LTJMP_OP):
+                    COMPARE_JUMP(LT_OP, <);
+                CASE(LEJMP_OP):
+                    COMPARE_JUMP(LE_OP, <=);
+                CASE(GTJMP_OP):
+                    COMPARE_JUMP(GT_OP, >);
+                CASE(GEJMP_OP):
+                    COMPARE_JUMP(GE_OP, >=);
+                CASE(KADD_OP):
+                    LOAD_CONSTANT;
+                    ARITHMETIC(ADD_OP, addInt);
+                CASE(KSUB_OP):
+                    LOAD_CONSTANT;
+                    ARITHMETIC(SUB_OP, subInt);
+                CASE(KMUL_OP):
+                    LOAD_CONSTANT;
+                    ARITHMETIC(MUL_OP, mulInt);
+                CASE(KMOD_OP):
+                    LOAD_CONSTANT;
+                    MODULO;
+                case OPCODES::OPCODE_COUNT:
+                    break;
+            }
+        }
+    }
+    catch (const Failure &failure) {
+        const Location &location =
+            function->locations[pc - function->code - 1];
+        throw RuntimeError(this->program.filename, location.line,
+                           location.lpos, failure.message);
+    }
+}
+
+template Value VM::execute<DISPATCH_MODES::SWITCH_DISPATCH>();
+template Value VM::execute<DISPATCH_MODES::THREADED_DISPATCH>();
+template Value VM::execute<DISPATCH_MODES::COUNTING_DISPATCH>();
@@ -0,0 +1,116 @@
+/*
+SPDX-License-Identifier: MIT
+Tooty-lang - A compiled and iterpreted language written in C++
+
+MIT License
+
+Copyright (c) 2021-present Oliver Wilkes
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "bytecode.hpp"
+#include "heap.hpp"
+#include "jit.hpp"
+#include "object.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+const int MAXFRAMES = 10000;
+
+enum DISPATCH_MODES
+{
+    SWITCH_DISPATCH,   // one switch at the top of the loop, portable
+    THREADED_DISPATCH, // every instruction jumps straight to the next one
+    COUNTING_DISPATCH, // the switch, counting instructions in VM::executed
+};
+
+// whether THREADED_DISPATCH was compiled in, runs fall back to the switch
+// without it
+bool threadedDispatch();
+
+// Constant folding for the compiler, with the same results as running the
+// op. False if it would fail or needs a VM, such as joining strings, which
+// leaves it to run time.
+bool fold(OPCODES, const Value &, const Value &, Value &);
+bool fold(OPCODES, const Value &, Value &);
+
+class VM;
+
+struct Native {
+    const char *name;
+    Value (*function)(VM &, const Value *, int);
+};
+
+// Runs a Program from the top of the file. Runtime errors throw
+// RuntimeError with where in the file they happened.
+class VM {
+  public:
+    explicit VM(const Program &, std::ostream & = std::cout,
+                const HeapOptions & = HeapOptions{});
+    ~VM();
+    // The JIT is left out when counting instructions
+    Value run(DISPATCH_MODES = DISPATCH_MODES::THREADED_DISPATCH,
+              JIT_MODES = JIT_MODES::OFF_JIT);
+    const Program &program;
+    std::ostream &out; // where print writes
+    // A copy in the heap, of text from anywhere but the heap, which a
+    // collection may move
+    const std::string_view *newString(std::string_view);
+    Heap heap; // strings and objects made while running
+    uint64_t executed = 0; // instructions, with COUNTING_DISPATCH
+    size_t jitted() const; // funs the last run compiled to native code
+
+  private:
+    friend class Jit;
+    struct Frame {
+        const Function *function;
+        const uint32_t *pc; // where to carry on
+        size_t base;
+        bool construct; // the call made an object, which it gives back
+    };
+    std::vector<Value> globals;
+    std::vector<Value> stack;
+    std::vector<Frame> frames;
+    std::deque<Class> classes; // not collected, the caches point at them
+    std::vector<Cache> caches; // one per attribute site
+    std::unique_ptr<Jit> jit;  // null unless the run uses it
+    template <DISPATCH_MODES> Value execute();
+    void roots(); // hands everything outside the heap to Heap::visit
+    void *allocate(CELL_KINDS, size_t);
+    std::string_view *makeString(size_t); // bytes for the caller to fill
+    Value arithmetic(OPCODES, const Value &, const Value &);
+    Value format(const Value *, uint32_t);
+    Value define(const Value *, uint32_t, CLASS_KINDS);
+    Value construct(Class *, const Value *, uint32_t);
+    Value attribute(const Value &, Cache &);
+    Value lookup(const Value &, Cache &);
+    void assign(const Value &, Cache &, const Value &);
+    void store(const Value &, Cache &, const Value &);
+    void append(const Value &, Shape *, const Value &);
+};
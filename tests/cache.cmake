@@ -0,0 +1,60 @@
+# A compiled program in __tootycache__ is used while it matches its source
+# and compiled again, then replaced, when it is stale or corrupt
+#
+#   cmake -DTOOTY=path/to/tooty -DWORK=dir -P cache.cmake
+
+set(dir ${WORK}/cache_test)
+file(REMOVE_RECURSE ${dir})
+file(WRITE ${dir}/a.tooty "print(\"one\")\n")
+file(WRITE ${dir}/b.tooty "print(\"two\")\n")
+set(cache ${dir}/__tootycache__/a.tooty.ttc)
+
+# Runs a.tooty and checks what it prints and whether it was compiled, which
+# --stats shows as a lex phase
+function(expect_run step expected compiled)
+    execute_process(COMMAND ${TOOTY} run --stats ${ARGN} ${dir}/a.tooty
+        RESULT_VARIABLE status OUTPUT_VARIABLE out ERROR_VARIABLE err)
+    if(NOT status EQUAL 0 OR NOT out STREQUAL "${expected}\n")
+        message(FATAL_ERROR "${step}: exited with ${status}: ${out}${err}")
+    endif()
+    if(err MATCHES "\n  lex ")
+        set(lexed TRUE)
+    else()
+        set(lexed FALSE)
+    endif()
+    if(NOT lexed STREQUAL compiled)
+        message(FATAL_ERROR "${step}: compiled is ${lexed}, not ${compiled}")
+    endif()
+    if(NOT EXISTS ${cache})
+        message(FATAL_ERROR "${step}: left no cache")
+    endif()
+endfunction()
+
+expect_run("first run" one TRUE)
+expect_run("cached" one FALSE)
+expect_run("another level" one TRUE -O0)
+expect_run("cached at that level" one FALSE -O0)
+expect_run("back to the first level" one TRUE)
+
+# the same length, so only the hash tells them apart
+file(WRITE ${dir}/a.tooty "print(\"new\")\n")
+expect_run("edited source" new TRUE)
+expect_run("cached after the edit" new FALSE)
+
+execute_process(COMMAND ${TOOTY} run ${dir}/b.tooty OUTPUT_QUIET)
+file(COPY ${dir}/__tootycache__/b.tooty.ttc
+     DESTINATION ${dir}/__tootycache__/other)
+file(RENAME ${dir}/__tootycache__/other/b.tooty.ttc ${cache})
+expect_run("cache of another file" new TRUE)
+expect_run("replaced" new FALSE)
+
+file(APPEND ${cache} "trailing bytes")
+expect_run("cache longer than its tables" new TRUE)
+expect_run("replaced after the bytes" new FALSE)
+
+file(WRITE ${cache} "not an image")
+expect_run("cache that is not an image" new TRUE)
+
+file(WRITE ${cache} "")
+expect_run("empty cache" new TRUE)
+expect_run("replaced after emptying" new FALSE)
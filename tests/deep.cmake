@@ -0,0 +1,40 @@
+# A chain of 2^17 additions, and one of 2^13 under MAXNESTING. The parser
+# builds it without recursing, but the tree nests a level per operator, so
+# every later pass over it has to cope with a depth no hand-written file
+# reaches.
+#
+#   cmake -DTOOTY=path/to/tooty -DWORK=dir -P deep.cmake
+
+set(chain "1")
+foreach(i RANGE 1 17)
+    set(chain "${chain} + ${chain}")
+    if(i EQUAL 13)
+        set(shallower "${chain}")
+    endif()
+endforeach()
+file(WRITE ${WORK}/deep.tooty "x = ${chain}\n")
+file(WRITE ${WORK}/shallower.tooty "print(${shallower})\n")
+
+execute_process(COMMAND ${TOOTY} --ast ${WORK}/deep.tooty
+    RESULT_VARIABLE status OUTPUT_FILE ${WORK}/deep.ast ERROR_VARIABLE err)
+if(NOT status EQUAL 0)
+    message(FATAL_ERROR "--ast exited with ${status}: ${err}")
+endif()
+# MODULE, EXPR and ASSIGN, then 131071 BINARY and the last NUMBER
+file(STRINGS ${WORK}/deep.ast deepest REGEX "^ *\\[131074\\] NUMBER 1$")
+if(NOT deepest)
+    message(FATAL_ERROR "--ast did not print the deepest node")
+endif()
+
+# too deep to compile, which has to be a diagnostic and not a crash
+execute_process(COMMAND ${TOOTY} run --no-cache ${WORK}/deep.tooty
+    RESULT_VARIABLE status OUTPUT_VARIABLE out ERROR_VARIABLE err)
+if(NOT status EQUAL 1 OR NOT err MATCHES "Too deeply nested to compile")
+    message(FATAL_ERROR "run exited with ${status}: ${err}")
+endif()
+
+execute_process(COMMAND ${TOOTY} run --no-cache ${WORK}/shallower.tooty
+    RESULT_VARIABLE status OUTPUT_VARIABLE out ERROR_VARIABLE err)
+if(NOT status EQUAL 0 OR NOT out STREQUAL "8192\n")
+    message(FATAL_ERROR "run exited with ${status}: ${out}${err}")
+endif()
@@ -0,0 +1,22 @@
+# Runs PROGRAM in each mode that has to print the same thing and compares
+# that with the .out file next to it
+#
+#   cmake -DTOOTY=path/to/tooty -DPROGRAM=path/to/x.tooty -P expect.cmake
+
+get_filename_component(dir ${PROGRAM} DIRECTORY)
+get_filename_component(name ${PROGRAM} NAME_WE)
+file(READ ${dir}/${name}.out expected)
+
+foreach(mode "-O0" "-O2" "--dispatch=switch" "--jit=always"
+             "--nursery=64 --heap=8")
+    separate_arguments(flags UNIX_COMMAND "${mode}")
+    execute_process(COMMAND ${TOOTY} run --no-cache ${flags} ${PROGRAM}
+        RESULT_VARIABLE status OUTPUT_VARIABLE out ERROR_VARIABLE err)
+    if(NOT status EQUAL 0)
+        message(FATAL_ERROR "${name} ${mode} exited with ${status}: ${err}")
+    endif()
+    if(NOT out STREQUAL expected)
+        message(FATAL_ERROR "${name} ${mode} prints\n${out}instead of\n"
+            "${expected}")
+    endif()
+endforeach()
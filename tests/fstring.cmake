@@ -0,0 +1,62 @@
+# The tokens the lexer splits f-strings into, with both backends, and what
+# running the edge cases gives. Tokens are written TYPE=value, as the dump
+# prints them.
+#
+#   cmake -DTOOTY=path/to/tooty -DWORK=dir -P fstring.cmake
+
+function(expect_tokens name source)
+    string(REPLACE ";" " " expected "${ARGN}")
+    file(WRITE ${WORK}/${name}.tooty "${source}")
+    foreach(lexer regex dfa)
+        execute_process(COMMAND ${TOOTY} --lexer=${lexer} ${WORK}/${name}.tooty
+            RESULT_VARIABLE status OUTPUT_VARIABLE out ERROR_VARIABLE err)
+        if(NOT status EQUAL 0)
+            message(FATAL_ERROR "${name}: exited with ${status}: ${err}")
+        endif()
+        string(REGEX MATCHALL "type=[A-Z]+ value=[^>]*" tokens "${out}")
+        string(REGEX REPLACE "type=([A-Z]+) value=" "\\1=" tokens "${tokens}")
+        string(REPLACE ";" " " tokens "${tokens}")
+        if(NOT tokens STREQUAL expected)
+            message(FATAL_ERROR "${name} with --lexer=${lexer} gives\n"
+                "  ${tokens}\ninstead of\n  ${expected}")
+        endif()
+    endforeach()
+endfunction()
+
+function(expect_run name status_wanted out_wanted err_wanted)
+    execute_process(COMMAND ${TOOTY} run --no-cache ${WORK}/${name}.tooty
+        RESULT_VARIABLE status OUTPUT_VARIABLE out ERROR_VARIABLE err)
+    if(NOT status EQUAL status_wanted OR NOT out STREQUAL out_wanted
+       OR NOT err MATCHES "${err_wanted}")
+        message(FATAL_ERROR "running ${name} exited with ${status}: "
+            "${out}${err}")
+    endif()
+endfunction()
+
+expect_tokens(ftext [[f"a{x}b"]]
+    FSTART=NULL FTEXT=a LBRACE=NULL IDENT=x RBRACE=NULL FTEXT=b FEND=NULL)
+
+# doubled braces stay in the text, the compiler halves them
+expect_tokens(fbraces "print(f\"{{x}}|{1}}}\")\n"
+    IDENT=print LPAR=NULL FSTART=NULL [[FTEXT={{x}}|]] LBRACE=NULL
+    NUMBER=1 RBRACE=NULL [[FTEXT=}}]] FEND=NULL RPAR=NULL [[NL=\n]])
+expect_run(fbraces 0 "{x}|1}\n" "^$")
+
+# a newline inside the braces is ignored as inside ( and the parser finds
+# the brace missing
+expect_tokens(funclosed "print(f\"a{x\n"
+    IDENT=print LPAR=NULL FSTART=NULL FTEXT=a LBRACE=NULL IDENT=x)
+expect_run(funclosed 1 "" "Expected '}', got the end of the file")
+
+expect_tokens(fnested [[f"a{f"b{x}"}c"]]
+    FSTART=NULL FTEXT=a LBRACE=NULL FSTART=NULL FTEXT=b LBRACE=NULL IDENT=x
+    RBRACE=NULL FEND=NULL RBRACE=NULL FTEXT=c FEND=NULL)
+
+# a backslash does not keep the quote from ending either kind of literal,
+# and is only worked out by the compiler
+expect_tokens(sbackslash "\"q\\\"x\n" [[STRING="q\"]] IDENT=x [[NL=\n]])
+expect_tokens(fbackslash "f\"q\\\"x\n"
+    FSTART=NULL [[FTEXT=q\]] FEND=NULL IDENT=x [[NL=\n]])
+file(WRITE ${WORK}/fescapes.tooty
+    "x = 1\nprint(f\"\\t{x}\\{{\\\\\", \"\\t\\\\\")\n")
+expect_run(fescapes 0 "\t1\\{\\ \t\\\n" "^$")